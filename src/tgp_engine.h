@@ -0,0 +1,3474 @@
+//---------------------------------------------------------------------------
+//  Traceless Genetic Programming - the engine shared by tgp_parity.cpp and tgp_multi_class.cpp
+//  (c) Mihai Oltean mihai.oltean@gmail.com
+//  github.com/mihaioltean/genetic-programming
+//  MIT License
+
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+//  The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//---------------------------------------------------------------------------
+
+//  header only: a problem includes this file and describes
+//     - the type of its values (one value per fitness case, or packed bits),
+//     - its functions, as a list of operator types (t_operator_list),
+//     - how the errors of a program are counted (a fitness policy),
+//     - the problem itself, a policy struct given to the GP loop (see evolve): its data, how an offspring
+//       is evaluated, what is printed, and what happens between the generations.
+//  the engine generates a loop for each operator and each instruction set, with the operator inlined,
+//  so a new problem or a new function set costs nothing at runtime. a tool keeps only its problem and main.
+
+#ifndef TGP_ENGINE_H
+#define TGP_ENGINE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define TGP_X86_SIMD 1
+#define TGP_AVX512 1
+#define TGP_TARGET_AVX2 __attribute__((target("avx2")))
+#define TGP_TARGET_AVX512 __attribute__((target("avx512f")))
+#elif defined(_MSC_VER) && defined(_M_X64)
+#include <immintrin.h>
+#include <intrin.h>
+#define TGP_X86_SIMD 1
+#define TGP_AVX512 (_MSC_VER >= 1910) // AVX-512 intrinsics are available from Visual C++ 2017
+#define TGP_TARGET_AVX2
+#define TGP_TARGET_AVX512
+#else
+#define TGP_X86_SIMD 0
+#define TGP_AVX512 0
+#endif
+
+// an operator written once for values and SIMD vectors (a template) is forced inline into the loop of each
+// instruction set: only there are the instructions of its vectors enabled
+#if defined(_MSC_VER)
+#define TGP_ALWAYS_INLINE __forceinline
+#elif defined(__GNUC__) || defined(__clang__)
+#define TGP_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define TGP_ALWAYS_INLINE inline
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <malloc.h>
+#endif
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+#define CacheLineSize 64
+#define HugePageSize (2 * 1024 * 1024)
+//---------------------------------------------------------------------------
+inline int popcount64(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(x);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    return (int)__popcnt64(x);
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int)((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+//---------------------------------------------------------------------------
+inline int popcount32(unsigned int x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcount(x);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    return (int)__popcnt(x);
+#else
+    x = x - ((x >> 1) & 0x55555555U);
+    x = (x & 0x33333333U) + ((x >> 2) & 0x33333333U);
+    x = (x + (x >> 4)) & 0x0F0F0F0FU;
+    return (int)((x * 0x01010101U) >> 24);
+#endif
+}
+//---------------------------------------------------------------------------
+inline void* allocate_aligned(size_t size)
+// cache line aligned memory; large blocks are aligned to (and, on Linux, backed by) huge pages.
+// like new, it does not return NULL: the program stops if there is not enough memory
+{
+    size_t alignment = size >= HugePageSize ? HugePageSize : CacheLineSize;
+    if (!size)
+        size = CacheLineSize;
+    void *p = NULL;
+#if defined(_MSC_VER)
+    p = _aligned_malloc(size, alignment);
+#else
+    if (posix_memalign(&p, alignment, size))
+        p = NULL;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (p && size >= HugePageSize)
+        madvise(p, size, MADV_HUGEPAGE);
+#endif
+#endif
+    if (!p){
+        printf("Not enough memory for %llu bytes!\n", (unsigned long long)size);
+        exit(1);
+    }
+    return p;
+}
+//---------------------------------------------------------------------------
+inline void free_aligned(void *p)
+{
+#if defined(_MSC_VER)
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+//---------------------------------------------------------------------------
+// counter-based random numbers
+// each chromosome of each generation has its own stream, identified by (generation, index in population);
+// the numbers of a stream depend only on the seed and on the stream, so the result of a run does not
+// depend on the number of threads or on the order in which the chromosomes are built
+//---------------------------------------------------------------------------
+struct t_random{
+    uint64_t key;
+    uint64_t counter;
+};
+//---------------------------------------------------------------------------
+inline uint64_t mix64(uint64_t x)
+// splitmix64 finalizer
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+//---------------------------------------------------------------------------
+inline void init_random(t_random &r, unsigned int seed, int generation, int index)
+{
+    r.key = mix64(mix64(seed) ^ (((uint64_t)generation << 32) | (uint32_t)index));
+    r.counter = 0;
+}
+//---------------------------------------------------------------------------
+inline uint64_t next_random(t_random &r)
+{
+    return mix64(r.key + 0x9E3779B97F4A7C15ULL * ++r.counter);
+}
+//---------------------------------------------------------------------------
+inline int random_int(t_random &r, int n)
+// uniform in 0 .. n - 1
+{
+    return (int)(next_random(r) % (uint64_t)n);
+}
+//---------------------------------------------------------------------------
+inline double random_double(t_random &r)
+// uniform in [0, 1)
+{
+    return (next_random(r) >> 11) * (1.0 / 9007199254740992.0);
+}
+//---------------------------------------------------------------------------
+// thread pool
+// parallel_for splits the tasks in one contiguous range per thread; a thread which finishes its range
+// steals the remaining tasks of the other threads
+//---------------------------------------------------------------------------
+typedef void (*t_task_function)(int task, void *context);
+
+struct t_task_range{
+    std::atomic<int> next;   // next task to be taken, by the owner or by a thief
+    int end;
+    char padding[CacheLineSize - sizeof(std::atomic<int>) - sizeof(int)]; // one range per cache line
+};
+
+struct t_thread_pool{
+    int num_threads;         // including the thread calling parallel_for
+    std::thread *threads;
+    t_task_range *ranges;
+
+    t_task_function task;
+    void *context;
+
+    std::mutex mutex;
+    std::condition_variable work_available, work_done;
+    int job;                 // incremented for each parallel_for
+    int num_working;
+    bool stop;
+};
+//---------------------------------------------------------------------------
+inline void run_tasks(t_thread_pool &tp, int thread)
+{
+    for (int i = 0; i < tp.num_threads; i++){
+        t_task_range &range = tp.ranges[(thread + i) % tp.num_threads]; // own range first, then steal
+        int task;
+        while ((task = range.next.fetch_add(1)) < range.end)
+            tp.task(task, tp.context);
+    }
+}
+//---------------------------------------------------------------------------
+inline void worker_thread(t_thread_pool *tp, int thread)
+{
+    int last_job = 0;
+    for (;;){
+        {
+            std::unique_lock<std::mutex> lock(tp->mutex);
+            while (!tp->stop && tp->job == last_job)
+                tp->work_available.wait(lock);
+            if (tp->stop)
+                return;
+            last_job = tp->job;
+        }
+        run_tasks(*tp, thread);
+        std::lock_guard<std::mutex> lock(tp->mutex);
+        if (--tp->num_working == 0)
+            tp->work_done.notify_one();
+    }
+}
+//---------------------------------------------------------------------------
+inline void start_thread_pool(t_thread_pool &tp, int num_threads)
+{
+    tp.num_threads = num_threads > 1 ? num_threads : 1;
+    tp.ranges = new t_task_range[tp.num_threads];
+    tp.job = 0;
+    tp.num_working = 0;
+    tp.stop = false;
+    tp.threads = new std::thread[tp.num_threads - 1];
+    for (int t = 1; t < tp.num_threads; t++)
+        tp.threads[t - 1] = std::thread(worker_thread, &tp, t);
+}
+//---------------------------------------------------------------------------
+inline void stop_thread_pool(t_thread_pool &tp)
+{
+    {
+        std::lock_guard<std::mutex> lock(tp.mutex);
+        tp.stop = true;
+    }
+    tp.work_available.notify_all();
+    for (int t = 1; t < tp.num_threads; t++)
+        tp.threads[t - 1].join();
+    delete[] tp.threads;
+    delete[] tp.ranges;
+}
+//---------------------------------------------------------------------------
+inline void parallel_for(t_thread_pool &tp, int first, int last, t_task_function task, void *context)
+// runs task(i, context) for i in first .. last - 1 and waits until all are done
+{
+    if (tp.num_threads == 1){
+        for (int i = first; i < last; i++)
+            task(i, context);
+        return;
+    }
+    tp.task = task;
+    tp.context = context;
+    for (int t = 0; t < tp.num_threads; t++){
+        tp.ranges[t].next = first + (int)((long long)(last - first) * t / tp.num_threads);
+        tp.ranges[t].end = first + (int)((long long)(last - first) * (t + 1) / tp.num_threads);
+    }
+    {
+        std::lock_guard<std::mutex> lock(tp.mutex);
+        tp.num_working = tp.num_threads - 1;
+        tp.job++;
+    }
+    tp.work_available.notify_all();
+    run_tasks(tp, 0);
+    std::unique_lock<std::mutex> lock(tp.mutex);
+    while (tp.num_working)
+        tp.work_done.wait(lock);
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+int get_stride(int num_values)
+// number of values rounded up to a whole number of cache lines
+{
+    int per_line = CacheLineSize / sizeof(t_value);
+    return (num_values + per_line - 1) / per_line * per_line;
+}
+//---------------------------------------------------------------------------
+// values are stored in reference counted buffers: clones of a parent, the elite and the insertions
+// of a simple program share the buffer instead of copying it.
+// a buffer is written only when nobody else uses it.
+// all buffers are allocated once, in a single aligned arena; the variables of the training data
+// are registered as external buffers, so a simple program points directly to its column.
+// a chromosome is any struct with the members t_value *value and int buffer (-1 if none).
+//---------------------------------------------------------------------------
+template <typename t_value>
+struct t_value_pool{
+    int num_values;         // number of values in a buffer
+    int stride;             // distance between 2 buffers of the arena (num_values rounded up to a cache line)
+    int num_buffers;        // buffers in the arena
+    int num_external_buffers;
+    t_value *arena;
+    t_value **buffer;
+    std::atomic<int> *ref_count;  // how many chromosomes (or variables) use each buffer
+    int *free_buffers;      // stack with the unused buffers
+    int num_free_buffers;
+    std::mutex free_buffers_mutex; // offspring are built by several threads
+};
+//---------------------------------------------------------------------------
+template <typename t_value>
+void allocate_value_pool(t_value_pool<t_value> &pool, int num_buffers, int max_external_buffers, int num_values)
+{
+    pool.num_values = num_values;
+    pool.stride = get_stride<t_value>(num_values);
+    pool.num_buffers = num_buffers;
+    pool.num_external_buffers = 0;
+    pool.arena = (t_value*)allocate_aligned((size_t)num_buffers * pool.stride * sizeof(t_value));
+    pool.buffer = new t_value*[num_buffers + max_external_buffers];
+    pool.ref_count = new std::atomic<int>[num_buffers + max_external_buffers];
+    pool.free_buffers = new int[num_buffers];
+    for (int i = 0; i < num_buffers; i++){
+        pool.buffer[i] = pool.arena + (size_t)i * pool.stride;
+        pool.ref_count[i] = 0;
+        pool.free_buffers[i] = num_buffers - 1 - i;
+    }
+    pool.num_free_buffers = num_buffers;
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void delete_value_pool(t_value_pool<t_value> &pool)
+{
+    free_aligned(pool.arena);
+    delete[] pool.buffer;
+    delete[] pool.ref_count;
+    delete[] pool.free_buffers;
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+int add_external_buffer(t_value_pool<t_value> &pool, t_value *values)
+// values are owned by the caller; the pool keeps a reference, so the buffer is never reused
+{
+    int b = pool.num_buffers + pool.num_external_buffers++;
+    pool.buffer[b] = values;
+    pool.ref_count[b] = 1;
+    return b;
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+int acquire_buffer(t_value_pool<t_value> &pool)
+// the caller sizes the pool for the most buffers used at once (2 populations per island, or in place 1 population
+// and 3 buffers per thread, plus the migrants in the queues); running out means that this bound is wrong, and the
+// program stops rather than giving a buffer which is still used
+{
+    std::lock_guard<std::mutex> lock(pool.free_buffers_mutex);
+    if (!pool.num_free_buffers){
+        printf("All the %d buffers of values are used!\n", pool.num_buffers);
+        exit(1);
+    }
+    int b = pool.free_buffers[--pool.num_free_buffers];
+    pool.ref_count[b] = 1;
+    return b;
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void release_buffer(t_value_pool<t_value> &pool, int b)
+{
+    if (--pool.ref_count[b] == 0){
+        std::lock_guard<std::mutex> lock(pool.free_buffers_mutex);
+        pool.free_buffers[pool.num_free_buffers++] = b;
+    }
+}
+//---------------------------------------------------------------------------
+template <typename t_chromosome, typename t_value>
+void share_buffer(t_chromosome &c, t_value_pool<t_value> &pool, int b)
+// c will use the values from buffer b
+{
+    pool.ref_count[b]++;
+    if (c.buffer >= 0)
+        release_buffer(pool, c.buffer);
+    c.buffer = b;
+    c.value = pool.buffer[b];
+}
+//---------------------------------------------------------------------------
+template <typename t_chromosome, typename t_value>
+void make_writable(t_chromosome &c, t_value_pool<t_value> &pool)
+// gives c a buffer used by nobody else; its content is undefined and must be overwritten
+// (a buffer used only by c cannot be shared concurrently: the other threads share only the buffers of parents)
+{
+    if (c.buffer >= 0 && pool.ref_count[c.buffer] == 1)
+        return;
+    if (c.buffer >= 0)
+        release_buffer(pool, c.buffer);
+    c.buffer = acquire_buffer(pool);
+    c.value = pool.buffer[c.buffer];
+}
+//---------------------------------------------------------------------------
+// semantic hashing
+// a program is identified by the hash of its values (the hash_values kernel), so programs built
+// differently but with the same values are recognized. the semantic cache remembers, for an operator applied to 2 parents (known by
+// their hashes), the hash and the fitness of the result: when the same parents meet again, the fitness
+// is not computed, and if the result is one of the parents (its values are compared), its buffer is shared.
+// the cache is lockless and may lose entries; a hit gives the same values and fitness as a miss (unless different
+// values have the same hash, which mix_word makes unlikely), so the run does not depend on the cache or on the number of threads.
+//---------------------------------------------------------------------------
+#define HashMultiplier 0x9E3779B97F4A7C15ull      // position of a word
+#define MixMultiplier1 0xFF51AFD7ED558CCDull      // the products of mix_hash
+#define MixMultiplier2 0xC4CEB9FE1A85EC53ull
+
+inline uint64_t mix_hash(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= MixMultiplier1;
+    x ^= x >> 33;
+    x *= MixMultiplier2;
+    x ^= x >> 33;
+    return x;
+}
+//---------------------------------------------------------------------------
+inline uint64_t semantic_key(int op, uint64_t a, uint64_t b, bool commutative)
+// the result of op applied to values with the hashes a and b
+{
+    if (commutative && a > b)
+        std::swap(a, b);
+    return mix_hash(a + mix_hash(b + (uint64_t)(op + 1) * HashMultiplier));
+}
+//---------------------------------------------------------------------------
+struct t_semantic_entry{
+    // the 3 fields are written one after the other; check tells whether they belong together
+    std::atomic<uint64_t> check;   // key ^ hash ^ fitness
+    std::atomic<uint64_t> hash;
+    std::atomic<int> fitness;
+};
+
+struct t_semantic_cache{
+    t_semantic_entry *entry;
+    uint64_t mask;                 // number of entries - 1 (a power of 2)
+};
+//---------------------------------------------------------------------------
+inline uint64_t semantic_check(uint64_t key, uint64_t hash, int fitness)
+{
+    return key ^ hash ^ ((uint64_t)(uint32_t)fitness * HashMultiplier);
+}
+//---------------------------------------------------------------------------
+inline void clear_semantic_cache(t_semantic_cache &cache)
+{
+    for (uint64_t i = 0; i <= cache.mask; i++){
+        cache.entry[i].check.store(0, std::memory_order_relaxed);
+        cache.entry[i].hash.store(0, std::memory_order_relaxed);
+        cache.entry[i].fitness.store(0, std::memory_order_relaxed);
+    }
+}
+//---------------------------------------------------------------------------
+inline void allocate_semantic_cache(t_semantic_cache &cache, int min_entries)
+{
+    uint64_t size = 1024;
+    while (size < (uint64_t)min_entries)
+        size *= 2;
+    cache.entry = new t_semantic_entry[size];
+    cache.mask = size - 1;
+    clear_semantic_cache(cache);
+}
+//---------------------------------------------------------------------------
+inline void delete_semantic_cache(t_semantic_cache &cache)
+{
+    delete[] cache.entry;
+}
+//---------------------------------------------------------------------------
+inline bool find_semantic(t_semantic_cache &cache, uint64_t key, uint64_t &hash, int &fitness)
+{
+    t_semantic_entry &e = cache.entry[key & cache.mask];
+    uint64_t check = e.check.load(std::memory_order_relaxed);
+    hash = e.hash.load(std::memory_order_relaxed);
+    fitness = e.fitness.load(std::memory_order_relaxed);
+    return hash && check == semantic_check(key, hash, fitness);
+}
+//---------------------------------------------------------------------------
+inline void store_semantic(t_semantic_cache &cache, uint64_t key, uint64_t hash, int fitness)
+// the entry is replaced: recent programs are more likely to be met again
+{
+    t_semantic_entry &e = cache.entry[key & cache.mask];
+    e.check.store(semantic_check(key, hash, fitness), std::memory_order_relaxed);
+    e.hash.store(hash, std::memory_order_relaxed);
+    e.fitness.store(fitness, std::memory_order_relaxed);
+}
+//---------------------------------------------------------------------------
+struct t_hash_set{
+    // the hashes of a population, to find duplicates; built before a generation, then only read
+    uint64_t *slot;                // 0 = empty
+    int *index;                    // the individual with the hash of the slot
+    uint64_t mask;
+};
+//---------------------------------------------------------------------------
+inline void allocate_hash_set(t_hash_set &set, int max_hashes)
+{
+    uint64_t size = 16;
+    while (size < 2 * (uint64_t)max_hashes)
+        size *= 2;
+    set.slot = new uint64_t[size];
+    set.index = new int[size];
+    set.mask = size - 1;
+}
+//---------------------------------------------------------------------------
+inline void delete_hash_set(t_hash_set &set)
+{
+    delete[] set.slot;
+    delete[] set.index;
+}
+//---------------------------------------------------------------------------
+inline void clear_hash_set(t_hash_set &set)
+{
+    memset(set.slot, 0, (set.mask + 1) * sizeof(uint64_t));
+}
+//---------------------------------------------------------------------------
+inline void insert_hash(t_hash_set &set, uint64_t hash, int index)
+// the first individual with a hash is kept
+{
+    uint64_t i = hash & set.mask;
+    while (set.slot[i] && set.slot[i] != hash)
+        i = (i + 1) & set.mask;
+    if (!set.slot[i]){
+        set.slot[i] = hash;
+        set.index[i] = index;
+    }
+}
+//---------------------------------------------------------------------------
+inline int find_hash(const t_hash_set &set, uint64_t hash)
+// the individual with this hash, -1 if there is none; the caller compares the values, since different values may have the same hash
+{
+    for (uint64_t i = hash & set.mask; set.slot[i]; i = (i + 1) & set.mask)
+        if (set.slot[i] == hash)
+            return set.index[i];
+    return -1;
+}
+//---------------------------------------------------------------------------
+// selection
+//---------------------------------------------------------------------------
+inline uint64_t rank_key(int fitness, int index)
+// orders individuals by fitness, then by index; the best individual has the smallest key
+{
+    return ((uint64_t)(uint32_t)fitness << 32) | (uint32_t)index;
+}
+//---------------------------------------------------------------------------
+inline void update_best(std::atomic<uint64_t> &best_key, std::atomic<int> &worst_fitness, int fitness, int index)
+// called concurrently for each new individual; the result does not depend on the order of the calls
+{
+    uint64_t key = rank_key(fitness, index);
+    uint64_t current = best_key.load(std::memory_order_relaxed);
+    while (key < current && !best_key.compare_exchange_weak(current, key))
+        ;
+    int worst = worst_fitness.load(std::memory_order_relaxed);
+    while (fitness > worst && !worst_fitness.compare_exchange_weak(worst, fitness))
+        ;
+}
+//---------------------------------------------------------------------------
+struct t_rank_compare{
+    const int *fitness;
+    bool operator()(int a, int b) const { return rank_key(fitness[a], a) < rank_key(fitness[b], b); }
+};
+//---------------------------------------------------------------------------
+struct t_reverse_rank_compare{
+    const int *fitness;
+    bool operator()(int a, int b) const { return rank_key(fitness[a], a) > rank_key(fitness[b], b); }
+};
+//---------------------------------------------------------------------------
+inline int tournament_selection(const int *fitness, int pop_size, int tournament_size, t_random &rnd)
+{
+    int r, p;
+    p = random_int(rnd, pop_size);
+    for (int i = 1; i < tournament_size; i++) {
+        r = random_int(rnd, pop_size);
+        p = fitness[r] < fitness[p] ? r : p;
+    }
+    return p;
+}
+//---------------------------------------------------------------------------
+// in place steady state
+// a single population: each step builds one offspring and writes it over the loser of a tournament, so
+// the improvements can be selected at once and no second population is stored. the steps of a generation
+// run concurrently: a slot is locked only while it is read (a parent, whose buffer is shared, not copied)
+// or replaced, never while an offspring is built. the locks are spinlocks of one byte per slot.
+// the loser is never the best individual, so the best one, tracked with update_best, stays valid during
+// the whole generation
+//---------------------------------------------------------------------------
+struct t_slot_locks{
+    std::atomic<char> *locked;
+};
+//---------------------------------------------------------------------------
+inline void allocate_slot_locks(t_slot_locks &s, int num_slots)
+{
+    s.locked = new std::atomic<char>[num_slots];
+    for (int i = 0; i < num_slots; i++)
+        s.locked[i] = 0;
+}
+//---------------------------------------------------------------------------
+inline void delete_slot_locks(t_slot_locks &s)
+{
+    delete[] s.locked;
+}
+//---------------------------------------------------------------------------
+inline void lock_slot(t_slot_locks &s, int i)
+{
+    while (s.locked[i].exchange(1, std::memory_order_acquire))
+        std::this_thread::yield();
+}
+//---------------------------------------------------------------------------
+inline void unlock_slot(t_slot_locks &s, int i)
+{
+    s.locked[i].store(0, std::memory_order_release);
+}
+//---------------------------------------------------------------------------
+inline void lock_slots(t_slot_locks &s, int i, int j)
+// in the order of the indices, so 2 steps never wait for each other; i may be j
+{
+    lock_slot(s, i < j ? i : j);
+    if (i != j)
+        lock_slot(s, i < j ? j : i);
+}
+//---------------------------------------------------------------------------
+inline void unlock_slots(t_slot_locks &s, int i, int j)
+{
+    unlock_slot(s, i);
+    if (i != j)
+        unlock_slot(s, j);
+}
+//---------------------------------------------------------------------------
+inline int tournament_loser(const int *fitness, int i, int j, int best)
+// the worse of slots i and j (both locked), which is not the best one; -1 if both are the best
+{
+    if (i == best)
+        return j == best ? -1 : j;
+    if (j == best)
+        return i;
+    return rank_key(fitness[i], i) > rank_key(fitness[j], j) ? i : j;
+}
+//---------------------------------------------------------------------------
+// multiobjective ranking
+// the objectives are integers, all minimized. front 0 holds the points which no other point dominates,
+// front 1 those dominated only by front 0, and so on. the fronts are computed by the divide and conquer
+// algorithm of Jensen, generalized to equal values (Fortin, Grenier and Parizeau), in O(N log^(M-1) N)
+// for N points and M objectives instead of O(M N^2) for comparing all pairs:
+//   identical points are ranked once; the others are sorted lexicographically, so a point can only be
+//   dominated by points before it. a set is split at the median of its last objective k: the low part
+//   is ranked, the high part is updated from it on the objectives before k only, then it is ranked.
+//   with 2 objectives left, a sweep in lexicographic order finds, for each point, the highest front
+//   among the points before it which are not above it on the second objective, with a Fenwick tree.
+// the lists of points are arrays of indices in lexicographic order; a list is never modified, the parts
+// of a split are new lists
+//---------------------------------------------------------------------------
+#define FrontDirectComparisons 1024 // smaller problems compare all pairs
+
+struct t_front_sort{
+    const int *point;        // the distinct points, in lexicographic order, num_objectives values each
+    int num_objectives;
+    int *front;              // front of each distinct point: a lower bound until the point is ranked
+    int *values;             // work memory for the medians and the sweeps, one per distinct point
+    int *tree;               // Fenwick tree of the sweeps (maximal front of a prefix of the values)
+};
+//---------------------------------------------------------------------------
+inline int objective(const t_front_sort &s, int p, int k)
+{
+    return s.point[(size_t)p * s.num_objectives + k];
+}
+//---------------------------------------------------------------------------
+inline bool not_above(const t_front_sort &s, int p, int q, int k)
+// p is not above q on objectives 0 .. k
+{
+    for (int j = 0; j <= k; j++)
+        if (objective(s, p, j) > objective(s, q, j))
+            return false;
+    return true;
+}
+//---------------------------------------------------------------------------
+inline void raise_front(t_front_sort &s, int q, int p)
+// q is dominated by p
+{
+    if (s.front[q] <= s.front[p])
+        s.front[q] = s.front[p] + 1;
+}
+//---------------------------------------------------------------------------
+inline int compress_values(t_front_sort &s, const int *a, int na, const int *b, int nb, int k)
+// the distinct values of objective k in the 2 lists, sorted, in s.values; returns their number
+{
+    int n = 0;
+    for (int i = 0; i < na; i++)
+        s.values[n++] = objective(s, a[i], k);
+    for (int i = 0; i < nb; i++)
+        s.values[n++] = objective(s, b[i], k);
+    std::sort(s.values, s.values + n);
+    return (int)(std::unique(s.values, s.values + n) - s.values);
+}
+//---------------------------------------------------------------------------
+inline void sweep_insert(t_front_sort &s, int num_values, int value, int front)
+{
+    for (int i = (int)(std::lower_bound(s.values, s.values + num_values, value) - s.values) + 1; i <= num_values; i += i & -i)
+        if (s.tree[i] < front)
+            s.tree[i] = front;
+}
+//---------------------------------------------------------------------------
+inline int sweep_query(const t_front_sort &s, int num_values, int value)
+// the highest front of the inserted points whose value is at most value (-1 if none)
+{
+    int front = -1;
+    for (int i = (int)(std::upper_bound(s.values, s.values + num_values, value) - s.values); i > 0; i -= i & -i)
+        if (s.tree[i] > front)
+            front = s.tree[i];
+    return front;
+}
+//---------------------------------------------------------------------------
+inline void sweep_a(t_front_sort &s, const int *list, int n)
+// ranks the points of list on objectives 0 and 1
+{
+    int num_values = compress_values(s, list, n, NULL, 0, 1);
+    for (int i = 1; i <= num_values; i++)
+        s.tree[i] = -1;
+    for (int i = 0; i < n; i++){
+        int q = list[i];
+        int front = sweep_query(s, num_values, objective(s, q, 1));
+        if (s.front[q] <= front)
+            s.front[q] = front + 1;
+        sweep_insert(s, num_values, objective(s, q, 1), s.front[q]);
+    }
+}
+//---------------------------------------------------------------------------
+inline void sweep_b(t_front_sort &s, const int *low, int nl, const int *high, int nh)
+// updates the points of high from those of low, on objectives 0 and 1
+{
+    int num_values = compress_values(s, low, nl, high, nh, 1);
+    for (int i = 1; i <= num_values; i++)
+        s.tree[i] = -1;
+    int l = 0;
+    for (int i = 0; i < nh; i++){
+        int q = high[i];
+        for (; l < nl && objective(s, low[l], 0) <= objective(s, q, 0); l++)
+            sweep_insert(s, num_values, objective(s, low[l], 1), s.front[low[l]]);
+        int front = sweep_query(s, num_values, objective(s, q, 1));
+        if (s.front[q] <= front)
+            s.front[q] = front + 1;
+    }
+}
+//---------------------------------------------------------------------------
+inline bool split_equal_low(t_front_sort &s, const int *a, int na, const int *b, int nb, int k, int &median)
+// the median of objective k in the 2 lists; returns true if the values equal to it go to the low parts,
+// which is the most balanced split
+{
+    int n = 0;
+    for (int i = 0; i < na; i++)
+        s.values[n++] = objective(s, a[i], k);
+    for (int i = 0; i < nb; i++)
+        s.values[n++] = objective(s, b[i], k);
+    std::nth_element(s.values, s.values + n / 2, s.values + n);
+    median = s.values[n / 2];
+    int num_below = 0, num_equal = 0;
+    for (int i = 0; i < n; i++){
+        num_below += s.values[i] < median;
+        num_equal += s.values[i] == median;
+    }
+    int num_above = n - num_below - num_equal;
+    return abs(num_below + num_equal - num_above) <= abs(num_below - num_equal - num_above);
+}
+//---------------------------------------------------------------------------
+inline void split_list(const t_front_sort &s, const int *list, int n, int k, int median, bool equal_low, int *&low, int &nl, int *&high, int &nh)
+{
+    low = new int[n + 1];
+    high = new int[n + 1];
+    nl = nh = 0;
+    for (int i = 0; i < n; i++){
+        int v = objective(s, list[i], k);
+        if (v < median || (v == median && equal_low))
+            low[nl++] = list[i];
+        else
+            high[nh++] = list[i];
+    }
+}
+//---------------------------------------------------------------------------
+inline void front_helper_b(t_front_sort &s, const int *low, int nl, const int *high, int nh, int k)
+// updates the fronts of the points of high from the ranked points of low, knowing that the points of low
+// are not above those of high on the objectives after k
+{
+    if (!nl || !nh)
+        return;
+    if (nl == 1 || nh == 1 || (int64_t)nl * nh <= FrontDirectComparisons){
+        for (int i = 0; i < nh; i++)
+            for (int j = 0; j < nl; j++)
+                if (not_above(s, low[j], high[i], k))
+                    raise_front(s, high[i], low[j]);
+        return;
+    }
+    if (k == 1){
+        sweep_b(s, low, nl, high, nh);
+        return;
+    }
+    int max_low = INT_MIN, min_high = INT_MAX, min_low = INT_MAX, max_high = INT_MIN;
+    for (int i = 0; i < nl; i++){
+        max_low = std::max(max_low, objective(s, low[i], k));
+        min_low = std::min(min_low, objective(s, low[i], k));
+    }
+    for (int i = 0; i < nh; i++){
+        max_high = std::max(max_high, objective(s, high[i], k));
+        min_high = std::min(min_high, objective(s, high[i], k));
+    }
+    if (max_low <= min_high)
+        front_helper_b(s, low, nl, high, nh, k - 1);
+    else if (min_low <= max_high){
+        int median;
+        bool equal_low = split_equal_low(s, low, nl, high, nh, k, median);
+        int *low1, *low2, *high1, *high2, nl1, nl2, nh1, nh2;
+        split_list(s, low, nl, k, median, equal_low, low1, nl1, low2, nl2);
+        split_list(s, high, nh, k, median, equal_low, high1, nh1, high2, nh2);
+        front_helper_b(s, low1, nl1, high1, nh1, k);
+        front_helper_b(s, low1, nl1, high2, nh2, k - 1);
+        front_helper_b(s, low2, nl2, high2, nh2, k);
+        delete[] low1;
+        delete[] low2;
+        delete[] high1;
+        delete[] high2;
+    }
+}
+//---------------------------------------------------------------------------
+inline void front_helper_a(t_front_sort &s, const int *list, int n, int k)
+// ranks the points of list, which are equal on the objectives after k
+{
+    if (n < 2)
+        return;
+    if ((int64_t)n * (n - 1) / 2 <= FrontDirectComparisons){
+        // in lexicographic order, so the fronts before a point are final when it is reached
+        for (int i = 1; i < n; i++)
+            for (int j = 0; j < i; j++)
+                if (not_above(s, list[j], list[i], k))
+                    raise_front(s, list[i], list[j]);
+        return;
+    }
+    if (k == 1){
+        sweep_a(s, list, n);
+        return;
+    }
+    int min_value = INT_MAX, max_value = INT_MIN;
+    for (int i = 0; i < n; i++){
+        min_value = std::min(min_value, objective(s, list[i], k));
+        max_value = std::max(max_value, objective(s, list[i], k));
+    }
+    if (min_value == max_value){
+        front_helper_a(s, list, n, k - 1);
+        return;
+    }
+    int median;
+    bool equal_low = split_equal_low(s, list, n, NULL, 0, k, median);
+    int *low, *high, nl, nh;
+    split_list(s, list, n, k, median, equal_low, low, nl, high, nh);
+    front_helper_a(s, low, nl, k);
+    front_helper_b(s, low, nl, high, nh, k - 1);
+    front_helper_a(s, high, nh, k);
+    delete[] low;
+    delete[] high;
+}
+//---------------------------------------------------------------------------
+struct t_lexicographic_compare{
+    const int *objectives;
+    int num_objectives;
+    bool operator()(int a, int b) const
+    {
+        const int *x = objectives + (size_t)a * num_objectives, *y = objectives + (size_t)b * num_objectives;
+        for (int k = 0; k < num_objectives; k++)
+            if (x[k] != y[k])
+                return x[k] < y[k];
+        return a < b;
+    }
+};
+//---------------------------------------------------------------------------
+inline int non_dominated_sort(const int *objectives, int num_points, int num_objectives, int *front)
+// objectives: num_objectives values for each point; front receives the front of each point.
+// returns the number of fronts
+{
+    if (num_points <= 0)
+        return 0;
+    int *order = new int[num_points];
+    for (int i = 0; i < num_points; i++)
+        order[i] = i;
+    t_lexicographic_compare compare = { objectives, num_objectives };
+    std::sort(order, order + num_points, compare);
+    // the distinct points, in lexicographic order; distinct[i] = the distinct point of point i
+    int *point = new int[(size_t)num_points * num_objectives];
+    int *distinct = new int[num_points];
+    int num_distinct = 0;
+    for (int i = 0; i < num_points; i++){
+        const int *x = objectives + (size_t)order[i] * num_objectives;
+        if (!num_distinct || memcmp(x, point + (size_t)(num_distinct - 1) * num_objectives, num_objectives * sizeof(int))){
+            memcpy(point + (size_t)num_distinct * num_objectives, x, num_objectives * sizeof(int));
+            num_distinct++;
+        }
+        distinct[order[i]] = num_distinct - 1;
+    }
+
+    t_front_sort s;
+    s.point = point;
+    s.num_objectives = num_objectives;
+    s.front = new int[num_distinct];
+    s.values = new int[num_distinct];
+    s.tree = new int[num_distinct + 1];
+    for (int i = 0; i < num_distinct; i++){
+        s.front[i] = num_objectives == 1 ? i : 0; // with a single objective, each value is a front
+        order[i] = i;
+    }
+    if (num_objectives > 1)
+        front_helper_a(s, order, num_distinct, num_objectives - 1);
+    int num_fronts = 0;
+    for (int i = 0; i < num_points; i++){
+        front[i] = s.front[distinct[i]];
+        num_fronts = std::max(num_fronts, front[i] + 1);
+    }
+    delete[] s.front;
+    delete[] s.values;
+    delete[] s.tree;
+    delete[] point;
+    delete[] distinct;
+    delete[] order;
+    return num_fronts;
+}
+//---------------------------------------------------------------------------
+struct t_front_compare{
+    const int *front;
+    const int *objectives;   // NULL: points of the same front are ordered by index
+    int num_objectives, k;   // else by objective k
+    bool operator()(int a, int b) const
+    {
+        if (front[a] != front[b])
+            return front[a] < front[b];
+        if (objectives){
+            int x = objectives[(size_t)a * num_objectives + k], y = objectives[(size_t)b * num_objectives + k];
+            if (x != y)
+                return x < y;
+        }
+        return a < b;
+    }
+};
+//---------------------------------------------------------------------------
+inline void crowding_distance(const int *objectives, const int *front, int num_points, int num_objectives, double *distance)
+// in its front, the distance of a point is the sum over the objectives of the distance between its
+// 2 neighbours, relative to the range of the front; the extreme points have an infinite distance
+{
+    int *order = new int[num_points];
+    for (int i = 0; i < num_points; i++){
+        order[i] = i;
+        distance[i] = 0;
+    }
+    for (int k = 0; k < num_objectives; k++){
+        t_front_compare compare = { front, objectives, num_objectives, k };
+        std::sort(order, order + num_points, compare);
+        for (int first = 0, last; first < num_points; first = last){
+            for (last = first + 1; last < num_points && front[order[last]] == front[order[first]]; last++)
+                ;
+            double low = objectives[(size_t)order[first] * num_objectives + k];
+            double range = objectives[(size_t)order[last - 1] * num_objectives + k] - low;
+            distance[order[first]] = distance[order[last - 1]] = HUGE_VAL;
+            if (range > 0)
+                for (int i = first + 1; i < last - 1; i++)
+                    distance[order[i]] += (objectives[(size_t)order[i + 1] * num_objectives + k] -
+                                           objectives[(size_t)order[i - 1] * num_objectives + k]) / range;
+        }
+    }
+    delete[] order;
+}
+//---------------------------------------------------------------------------
+struct t_crowded_compare{
+    // lower front first, then larger crowding distance, then lower index
+    const int *front;
+    const double *distance;
+    bool operator()(int a, int b) const
+    {
+        if (front[a] != front[b])
+            return front[a] < front[b];
+        if (distance[a] != distance[b])
+            return distance[a] > distance[b];
+        return a < b;
+    }
+};
+//---------------------------------------------------------------------------
+// migration between islands
+//---------------------------------------------------------------------------
+#define MaxIslands 256           // an island is a thread, with a queue to each other island
+
+template <typename t_migrant>
+struct t_migration_queue{
+    // lock-free queue between 2 islands: one island writes, the other one reads
+    t_migrant *migrants;
+    unsigned int capacity;
+    std::atomic<unsigned int> head;    // next migrant to be read
+    char padding[CacheLineSize - sizeof(std::atomic<unsigned int>)]; // reader and writer use different cache lines
+    std::atomic<unsigned int> tail;    // next free place
+};
+//---------------------------------------------------------------------------
+template <typename t_migrant>
+bool push_migrant(t_migration_queue<t_migrant> &q, const t_migrant &m)
+// returns false if the queue is full
+{
+    unsigned int tail = q.tail.load(std::memory_order_relaxed);
+    if (tail - q.head.load(std::memory_order_acquire) == q.capacity)
+        return false;
+    q.migrants[tail % q.capacity] = m;
+    q.tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+//---------------------------------------------------------------------------
+template <typename t_migrant>
+bool pop_migrant(t_migration_queue<t_migrant> &q, t_migrant &m)
+// returns false if the queue is empty
+{
+    unsigned int head = q.head.load(std::memory_order_relaxed);
+    if (head == q.tail.load(std::memory_order_acquire))
+        return false;
+    m = q.migrants[head % q.capacity];
+    q.head.store(head + 1, std::memory_order_release);
+    return true;
+}
+//---------------------------------------------------------------------------
+// computational kernels
+// a function set is a list of operator types. each operator has a static apply function for a single
+// value and one for the SIMD vectors of each instruction set (see t_avx2 and t_avx512), for example:
+//
+//    struct t_and{
+//        static uint64_t apply(uint64_t a, uint64_t b) { return a & b; }
+//        TGP_TARGET_AVX2 static t_avx2_uint64 apply(t_avx2_uint64 a, t_avx2_uint64 b) { ... }
+//    };
+//    typedef t_operator_list<t_and, t_or, t_nand, t_nor> t_boolean_operators;
+//
+// the engine makes a loop for each operator and each instruction set, with apply inlined in it;
+// the operator of an offspring is looked up once in a table, never for each value.
+// a fitness policy gives the type of the targets (t_target) and a count_errors function for each
+// instruction set, which counts the data whose value is not decoded to the target.
+// the widest instruction set supported by the CPU is selected at runtime. all versions must perform the
+// same operations in the same order, so that they give bit-identical results.
+//---------------------------------------------------------------------------
+template <typename... t_operators>
+struct t_operator_list{
+    enum { size = sizeof...(t_operators) };
+};
+
+#define MaxOperators 16
+//---------------------------------------------------------------------------
+template <typename t_value, typename t_target>
+struct t_kernels{
+    typedef void (*t_operator_kernel)(const t_value *a, const t_value *b, t_value *result, int n);
+    typedef int (*t_fitness_kernel)(const t_value *value, const t_target *target, int n, int num_classes);
+    typedef uint64_t (*t_hash_kernel)(const void *words, size_t num_words, size_t position);
+
+    const char *name;
+    int num_operators;
+    t_operator_kernel apply_operator[MaxOperators];  // apply_operator[op]: result[i] = a[i] op b[i]
+    t_fitness_kernel count_errors;                    // number of incorrectly classified data
+    t_hash_kernel hash_words;                         // sum of the mixed words of values (see hash_values)
+};
+//---------------------------------------------------------------------------
+template <bool condition>
+struct t_available{};   // selects an overload at compile time
+//---------------------------------------------------------------------------
+#if TGP_X86_SIMD
+// SIMD vectors of each type of values
+// the integer vectors are wrapped in structs, so that the operators can be overloaded on them
+//---------------------------------------------------------------------------
+struct t_avx2_int16{ __m256i v; };
+struct t_avx2_uint64{ __m256i v; };
+
+template <typename t_value>
+struct t_avx2{
+    static const bool available = false;
+};
+
+template <>
+struct t_avx2<double>{
+    static const bool available = true;
+    enum { width = 4 };
+    TGP_TARGET_AVX2 static __m256d load(const double *p) { return _mm256_loadu_pd(p); }
+    TGP_TARGET_AVX2 static void store(double *p, __m256d x) { _mm256_storeu_pd(p, x); }
+};
+
+template <>
+struct t_avx2<float>{
+    static const bool available = true;
+    enum { width = 8 };
+    TGP_TARGET_AVX2 static __m256 load(const float *p) { return _mm256_loadu_ps(p); }
+    TGP_TARGET_AVX2 static void store(float *p, __m256 x) { _mm256_storeu_ps(p, x); }
+};
+
+template <>
+struct t_avx2<int16_t>{
+    static const bool available = true;
+    enum { width = 16 };
+    TGP_TARGET_AVX2 static t_avx2_int16 load(const int16_t *p) { t_avx2_int16 x = { _mm256_loadu_si256((const __m256i*)p) }; return x; }
+    TGP_TARGET_AVX2 static void store(int16_t *p, t_avx2_int16 x) { _mm256_storeu_si256((__m256i*)p, x.v); }
+};
+
+template <>
+struct t_avx2<uint64_t>{
+    static const bool available = true;
+    enum { width = 4 };
+    TGP_TARGET_AVX2 static t_avx2_uint64 load(const uint64_t *p) { t_avx2_uint64 x = { _mm256_loadu_si256((const __m256i*)p) }; return x; }
+    TGP_TARGET_AVX2 static void store(uint64_t *p, t_avx2_uint64 x) { _mm256_storeu_si256((__m256i*)p, x.v); }
+};
+//---------------------------------------------------------------------------
+#if TGP_AVX512
+struct t_avx512_uint64{ __m512i v; };
+
+template <typename t_value>
+struct t_avx512{
+    static const bool available = false;  // 16 bit integers would need AVX-512BW
+};
+
+template <>
+struct t_avx512<double>{
+    static const bool available = true;
+    enum { width = 8 };
+    TGP_TARGET_AVX512 static __m512d load(const double *p) { return _mm512_loadu_pd(p); }
+    TGP_TARGET_AVX512 static void store(double *p, __m512d x) { _mm512_storeu_pd(p, x); }
+};
+
+template <>
+struct t_avx512<float>{
+    static const bool available = true;
+    enum { width = 16 };
+    TGP_TARGET_AVX512 static __m512 load(const float *p) { return _mm512_loadu_ps(p); }
+    TGP_TARGET_AVX512 static void store(float *p, __m512 x) { _mm512_storeu_ps(p, x); }
+};
+
+template <>
+struct t_avx512<uint64_t>{
+    static const bool available = true;
+    enum { width = 8 };
+    TGP_TARGET_AVX512 static t_avx512_uint64 load(const uint64_t *p) { t_avx512_uint64 x = { _mm512_loadu_si512((const void*)p) }; return x; }
+    TGP_TARGET_AVX512 static void store(uint64_t *p, t_avx512_uint64 x) { _mm512_storeu_si512((void*)p, x.v); }
+};
+#endif
+//---------------------------------------------------------------------------
+inline bool cpu_supports_avx2(void)
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool os_saves_ymm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6);
+    __cpuidex(info, 7, 0);
+    return os_saves_ymm && (info[1] & (1 << 5));
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+//---------------------------------------------------------------------------
+inline bool cpu_supports_avx512(void)
+{
+#if !TGP_AVX512
+    return false;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool os_saves_zmm = (info[2] & (1 << 27)) && ((_xgetbv(0) & 0xE6) == 0xE6);
+    __cpuidex(info, 7, 0);
+    return os_saves_zmm && (info[1] & (1 << 16));
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512f");
+#endif
+}
+#endif
+//---------------------------------------------------------------------------
+// the loop of an operator, for each instruction set
+// the SIMD loops handle 2 independent vectors per iteration, so that their latencies overlap;
+// result may be a or b: each value is read before it is overwritten
+//---------------------------------------------------------------------------
+template <typename t_operator, typename t_value>
+void apply_operator_scalar(const t_value *a, const t_value *b, t_value *result, int n)
+{
+    for (int i = 0; i < n; i++)
+        result[i] = t_operator::apply(a[i], b[i]);
+}
+//---------------------------------------------------------------------------
+#if TGP_X86_SIMD
+template <typename t_operator, typename t_value>
+TGP_TARGET_AVX2 void apply_operator_avx2(const t_value *a, const t_value *b, t_value *result, int n)
+{
+    typedef t_avx2<t_value> t_simd;
+    const int width = t_simd::width;
+    int i = 0;
+    for (; i + 2 * width <= n; i += 2 * width){
+        t_simd::store(result + i, t_operator::apply(t_simd::load(a + i), t_simd::load(b + i)));
+        t_simd::store(result + i + width, t_operator::apply(t_simd::load(a + i + width), t_simd::load(b + i + width)));
+    }
+    for (; i + width <= n; i += width)
+        t_simd::store(result + i, t_operator::apply(t_simd::load(a + i), t_simd::load(b + i)));
+    for (; i < n; i++)
+        result[i] = t_operator::apply(a[i], b[i]);
+}
+#endif
+//---------------------------------------------------------------------------
+#if TGP_AVX512
+template <typename t_operator, typename t_value>
+TGP_TARGET_AVX512 void apply_operator_avx512(const t_value *a, const t_value *b, t_value *result, int n)
+{
+    typedef t_avx512<t_value> t_simd;
+    const int width = t_simd::width;
+    int i = 0;
+    for (; i + 2 * width <= n; i += 2 * width){
+        t_simd::store(result + i, t_operator::apply(t_simd::load(a + i), t_simd::load(b + i)));
+        t_simd::store(result + i + width, t_operator::apply(t_simd::load(a + i + width), t_simd::load(b + i + width)));
+    }
+    for (; i + width <= n; i += width)
+        t_simd::store(result + i, t_operator::apply(t_simd::load(a + i), t_simd::load(b + i)));
+    for (; i < n; i++)
+        result[i] = t_operator::apply(a[i], b[i]);
+}
+#endif
+//---------------------------------------------------------------------------
+// the hash of values, for each instruction set
+// each 64 bit word, plus a multiple of its position, goes through mix_hash (multiply, xorshift, multiply), and
+// the results are added, so the SIMD loops compute the same hash as the scalar one, and a hash can be computed
+// block by block (see hash_values below). the mixing is not linear: a change of the same bit in several words
+// (the signs of negated values, for instance) does not cancel in the sum. the 64 bit products are made of 32 bit ones,
+// which AVX2 has
+//---------------------------------------------------------------------------
+inline uint64_t mix_word(uint64_t w, uint64_t position)
+{
+    return mix_hash(w + position * HashMultiplier);
+}
+//---------------------------------------------------------------------------
+inline uint64_t hash_words_scalar(const void *words, size_t num_words, size_t position)
+// sum of the mixed words; position is the index of the first one in the values
+{
+    const unsigned char *bytes = (const unsigned char*)words;
+    uint64_t h = 0;
+    for (size_t i = 0; i < num_words; i++){
+        uint64_t w;
+        memcpy(&w, bytes + 8 * i, 8);
+        h += mix_word(w, position + i);
+    }
+    return h;
+}
+//---------------------------------------------------------------------------
+#if TGP_X86_SIMD
+TGP_TARGET_AVX2 TGP_ALWAYS_INLINE __m256i multiply_avx2(__m256i x, uint64_t m)
+// the low 64 bits of the products of the lanes by m
+{
+    const __m256i m_low = _mm256_set1_epi64x(m & 0xFFFFFFFF), m_high = _mm256_set1_epi64x(m >> 32);
+    __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(x, m_high), _mm256_mul_epu32(_mm256_srli_epi64(x, 32), m_low));
+    return _mm256_add_epi64(_mm256_mul_epu32(x, m_low), _mm256_slli_epi64(cross, 32));
+}
+//---------------------------------------------------------------------------
+TGP_TARGET_AVX2 TGP_ALWAYS_INLINE __m256i mix_hash_avx2(__m256i x)
+// mix_hash of each lane
+{
+    x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 33));
+    x = multiply_avx2(x, MixMultiplier1);
+    x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 33));
+    x = multiply_avx2(x, MixMultiplier2);
+    return _mm256_xor_si256(x, _mm256_srli_epi64(x, 33));
+}
+//---------------------------------------------------------------------------
+TGP_TARGET_AVX2 inline uint64_t hash_words_avx2(const void *words, size_t num_words, size_t position)
+{
+    const unsigned char *bytes = (const unsigned char*)words;
+    const __m256i step = _mm256_set1_epi64x(4 * HashMultiplier);
+    uint64_t p = position * HashMultiplier;
+    __m256i sum = _mm256_setzero_si256();
+    __m256i positions = _mm256_set_epi64x(p + 3 * HashMultiplier, p + 2 * HashMultiplier, p + HashMultiplier, p);
+    size_t i = 0;
+    for (; i + 4 <= num_words; i += 4){
+        __m256i x = _mm256_add_epi64(_mm256_loadu_si256((const __m256i*)(bytes + 8 * i)), positions);
+        sum = _mm256_add_epi64(sum, mix_hash_avx2(x));
+        positions = _mm256_add_epi64(positions, step);
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, sum);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + hash_words_scalar(bytes + 8 * i, num_words - i, position + i);
+}
+#endif
+//---------------------------------------------------------------------------
+#if TGP_AVX512
+// the masked forms of the shifts and products avoid false warnings of GCC
+TGP_TARGET_AVX512 TGP_ALWAYS_INLINE __m512i multiply_avx512(__m512i x, uint64_t m)
+{
+    const __mmask8 all = 0xFF;
+    const __m512i m_low = _mm512_set1_epi64(m & 0xFFFFFFFF), m_high = _mm512_set1_epi64(m >> 32);
+    __m512i cross = _mm512_add_epi64(_mm512_maskz_mul_epu32(all, x, m_high), _mm512_maskz_mul_epu32(all, _mm512_maskz_srli_epi64(all, x, 32), m_low));
+    return _mm512_add_epi64(_mm512_maskz_mul_epu32(all, x, m_low), _mm512_maskz_slli_epi64(all, cross, 32));
+}
+//---------------------------------------------------------------------------
+TGP_TARGET_AVX512 TGP_ALWAYS_INLINE __m512i mix_hash_avx512(__m512i x)
+{
+    const __mmask8 all = 0xFF;
+    x = _mm512_xor_si512(x, _mm512_maskz_srli_epi64(all, x, 33));
+    x = multiply_avx512(x, MixMultiplier1);
+    x = _mm512_xor_si512(x, _mm512_maskz_srli_epi64(all, x, 33));
+    x = multiply_avx512(x, MixMultiplier2);
+    return _mm512_xor_si512(x, _mm512_maskz_srli_epi64(all, x, 33));
+}
+//---------------------------------------------------------------------------
+TGP_TARGET_AVX512 inline uint64_t hash_words_avx512(const void *words, size_t num_words, size_t position)
+{
+    const unsigned char *bytes = (const unsigned char*)words;
+    const __m512i step = _mm512_set1_epi64(8 * HashMultiplier);
+    uint64_t p = position * HashMultiplier;
+    __m512i sum = _mm512_setzero_si512();
+    __m512i positions = _mm512_set_epi64(p + 7 * HashMultiplier, p + 6 * HashMultiplier, p + 5 * HashMultiplier, p + 4 * HashMultiplier,
+                                         p + 3 * HashMultiplier, p + 2 * HashMultiplier, p + HashMultiplier, p);
+    size_t i = 0;
+    for (; i + 8 <= num_words; i += 8){
+        __m512i x = _mm512_add_epi64(_mm512_loadu_si512((const void*)(bytes + 8 * i)), positions);
+        sum = _mm512_add_epi64(sum, mix_hash_avx512(x));
+        positions = _mm512_add_epi64(positions, step);
+    }
+    uint64_t lanes[8];
+    _mm512_storeu_si512((void*)lanes, sum);
+    uint64_t h = 0;
+    for (int lane = 0; lane < 8; lane++)
+        h += lanes[lane];
+    return h + hash_words_scalar(bytes + 8 * i, num_words - i, position + i);
+}
+#endif
+//---------------------------------------------------------------------------
+template <typename t_value, typename t_target>
+void set_kernels(t_kernels<t_value, t_target> &k, const char *name, const typename t_kernels<t_value, t_target>::t_operator_kernel *apply_operator,
+                 int num_operators, typename t_kernels<t_value, t_target>::t_fitness_kernel count_errors,
+                 typename t_kernels<t_value, t_target>::t_hash_kernel hash_words)
+{
+    k.name = name;
+    k.num_operators = num_operators;
+    for (int op = 0; op < num_operators; op++)
+        k.apply_operator[op] = apply_operator[op];
+    k.count_errors = count_errors;
+    k.hash_words = hash_words;
+}
+//---------------------------------------------------------------------------
+template <typename t_fitness, typename t_value, typename... t_operators>
+void set_scalar_kernels(t_kernels<t_value, typename t_fitness::t_target> &k, t_operator_list<t_operators...>)
+{
+    typename t_kernels<t_value, typename t_fitness::t_target>::t_operator_kernel apply_operator[] = { apply_operator_scalar<t_operators, t_value>... };
+    set_kernels(k, "scalar", apply_operator, sizeof...(t_operators), t_fitness::count_errors_scalar, hash_words_scalar);
+}
+//---------------------------------------------------------------------------
+#if TGP_X86_SIMD
+template <typename t_fitness, typename t_value, typename... t_operators>
+bool set_avx2_kernels(t_kernels<t_value, typename t_fitness::t_target> &k, t_operator_list<t_operators...>, t_available<true>)
+{
+    typename t_kernels<t_value, typename t_fitness::t_target>::t_operator_kernel apply_operator[] = { apply_operator_avx2<t_operators, t_value>... };
+    set_kernels(k, "avx2", apply_operator, sizeof...(t_operators), t_fitness::count_errors_avx2, hash_words_avx2);
+    return true;
+}
+//---------------------------------------------------------------------------
+template <typename t_fitness, typename t_value, typename t_operators>
+bool set_avx2_kernels(t_kernels<t_value, typename t_fitness::t_target> &, t_operators, t_available<false>)
+{
+    return false;
+}
+#endif
+//---------------------------------------------------------------------------
+#if TGP_AVX512
+template <typename t_fitness, typename t_value, typename... t_operators>
+bool set_avx512_kernels(t_kernels<t_value, typename t_fitness::t_target> &k, t_operator_list<t_operators...>, t_available<true>)
+{
+    typename t_kernels<t_value, typename t_fitness::t_target>::t_operator_kernel apply_operator[] = { apply_operator_avx512<t_operators, t_value>... };
+    set_kernels(k, "avx512", apply_operator, sizeof...(t_operators), t_fitness::count_errors_avx512, hash_words_avx512);
+    return true;
+}
+//---------------------------------------------------------------------------
+template <typename t_fitness, typename t_value, typename t_operators>
+bool set_avx512_kernels(t_kernels<t_value, typename t_fitness::t_target> &, t_operators, t_available<false>)
+{
+    return false;
+}
+#endif
+//---------------------------------------------------------------------------
+template <typename t_operators, typename t_fitness, typename t_value>
+t_kernels<t_value, typename t_fitness::t_target> select_kernels(void)
+// picks the widest instruction set supported by the CPU
+// the TGP_SIMD environment variable (scalar, avx2 or avx512) can restrict the choice
+{
+    static_assert(t_operators::size <= MaxOperators, "too many operators");
+    const char *requested = getenv("TGP_SIMD");
+    t_kernels<t_value, typename t_fitness::t_target> k;
+    set_scalar_kernels<t_fitness>(k, t_operators());
+    if (requested && !strcmp(requested, "scalar"))
+        return k;
+#if TGP_X86_SIMD
+#if TGP_AVX512
+    if ((!requested || !strcmp(requested, "avx512")) && cpu_supports_avx512() &&
+        set_avx512_kernels<t_fitness>(k, t_operators(), t_available<t_avx512<t_value>::available>()))
+        return k;
+#endif
+    if (cpu_supports_avx2())
+        set_avx2_kernels<t_fitness>(k, t_operators(), t_available<t_avx2<t_value>::available>());
+#endif
+    return k;
+}
+//---------------------------------------------------------------------------
+inline uint64_t finish_hash(uint64_t sum, const void *values, size_t size, uint64_t last_mask)
+// sum: the mixed words of values but the last one, which is added here (with its meaningful bits only:
+// after the last fitness case, they may be garbage); the hash is never 0
+{
+    size_t num_words = (size + 7) / 8;
+    if (num_words){
+        uint64_t w = 0;
+        memcpy(&w, (const unsigned char*)values + 8 * (num_words - 1), size - 8 * (num_words - 1));
+        sum += mix_word(w & last_mask, num_words - 1);
+    }
+    uint64_t h = mix_hash(sum + size);
+    return h ? h : 1;
+}
+//---------------------------------------------------------------------------
+template <typename t_value, typename t_target>
+uint64_t hash_values(const t_kernels<t_value, t_target> &k, const void *values, size_t size, uint64_t last_mask = ~(uint64_t)0)
+// hash of size bytes of values
+{
+    size_t num_words = (size + 7) / 8;
+    return finish_hash(num_words ? k.hash_words(values, num_words - 1, 0) : 0, values, size, last_mask);
+}
+//---------------------------------------------------------------------------
+inline bool same_values(const void *a, const void *b, size_t size, uint64_t last_mask = ~(uint64_t)0)
+// whether size bytes of values are the same, with the meaningful bits of the last word only (see finish_hash);
+// a hash tells that values are different, not that they are the same
+{
+    size_t num_words = (size + 7) / 8;
+    if (!num_words)
+        return true;
+    size_t head = 8 * (num_words - 1);
+    if (memcmp(a, b, head))
+        return false;
+    uint64_t wa = 0, wb = 0;
+    memcpy(&wa, (const unsigned char*)a + head, size - head);
+    memcpy(&wb, (const unsigned char*)b + head, size - head);
+    return !((wa ^ wb) & last_mask);
+}
+//---------------------------------------------------------------------------
+template <typename t_number>
+bool check_hash_words(uint64_t (*hash_words)(const void*, size_t, size_t), t_random &r)
+// see check_value_hash
+{
+    const int MaxValues = 40;
+    t_number values[MaxValues], changed[MaxValues];
+    for (int n = 1; n <= MaxValues; n++){
+        size_t size = n * sizeof(t_number), num_words = (size + 7) / 8;
+        for (int i = 0; i < n; i++)
+            values[i] = (t_number)(random_double(r) * 200 - 100);
+        uint64_t h = finish_hash(hash_words(values, num_words - 1, 0), values, size, ~(uint64_t)0);
+        if (h != finish_hash(hash_words_scalar(values, num_words - 1, 0), values, size, ~(uint64_t)0))
+            return false;
+        for (int i = 0; i < n; i++)
+            changed[i] = -values[i];
+        if (h == finish_hash(hash_words(changed, num_words - 1, 0), changed, size, ~(uint64_t)0))
+            return false;
+        for (int i = 0; i < n; i++)
+            for (int j = i + 1; j < n; j++){
+                memcpy(changed, values, size);
+                changed[i] = -changed[i];
+                changed[j] = -changed[j];
+                if (h == finish_hash(hash_words(changed, num_words - 1, 0), changed, size, ~(uint64_t)0))
+                    return false;
+            }
+    }
+    return true;
+}
+//---------------------------------------------------------------------------
+inline bool check_value_hash(void)
+// for each instruction set of the CPU: values and their negations, and values with the signs of 2 of them changed,
+// must have different hashes (a sum of words mixed linearly confused them), and the loop must give the hashes of the scalar one
+{
+    t_random r;
+    init_random(r, 1, 0, 0);
+    bool ok = check_hash_words<double>(hash_words_scalar, r) && check_hash_words<float>(hash_words_scalar, r);
+#if TGP_X86_SIMD
+    if (cpu_supports_avx2())
+        ok = ok && check_hash_words<double>(hash_words_avx2, r) && check_hash_words<float>(hash_words_avx2, r);
+#if TGP_AVX512
+    if (cpu_supports_avx512())
+        ok = ok && check_hash_words<double>(hash_words_avx512, r) && check_hash_words<float>(hash_words_avx512, r);
+#endif
+#endif
+    return ok;
+}
+//---------------------------------------------------------------------------
+// command line
+//---------------------------------------------------------------------------
+inline bool parse_int_option(const char *name, const char *text, int min, int max, int &value)
+// value is text if it is a whole integer in min .. max, else an error is printed
+{
+    char *end;
+    errno = 0;
+    long v = strtol(text, &end, 10);
+    if (end == text || *end || errno || v < min || v > max){
+        if (max == INT_MAX)
+            printf("%s must be an integer of at least %d (not %s)\n", name, min, text);
+        else
+            printf("%s must be an integer between %d and %d (not %s)\n", name, min, max, text);
+        return false;
+    }
+    value = (int)v;
+    return true;
+}
+//---------------------------------------------------------------------------
+// data files
+// a file is mapped in memory when the system can do it, otherwise it is read
+//---------------------------------------------------------------------------
+struct t_mapped_file{
+    const char *data;
+    size_t size;
+#if defined(_WIN32)
+    HANDLE file, mapping;
+#endif
+    bool mapped;        // false if the file was read in memory
+};
+//---------------------------------------------------------------------------
+inline bool map_file(const char *filename, t_mapped_file &mf)
+{
+    mf.data = NULL;
+    mf.size = 0;
+    mf.mapped = false;
+#if defined(_WIN32)
+    mf.file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (mf.file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    GetFileSizeEx(mf.file, &size);
+    mf.size = (size_t)size.QuadPart;
+    if (!mf.size){
+        CloseHandle(mf.file);
+        return true;
+    }
+    mf.mapping = CreateFileMappingA(mf.file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mf.mapping){
+        mf.data = (const char*)MapViewOfFile(mf.mapping, FILE_MAP_READ, 0, 0, 0);
+        if (mf.data){
+            mf.mapped = true;
+            return true;
+        }
+        CloseHandle(mf.mapping);
+    }
+    CloseHandle(mf.file);
+    return false;
+#elif defined(__unix__) || defined(__APPLE__)
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st)){
+        close(fd);
+        return false;
+    }
+    mf.size = (size_t)st.st_size;
+    if (mf.size){
+        void *p = mmap(NULL, mf.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED){
+            madvise(p, mf.size, MADV_SEQUENTIAL);
+            mf.data = (const char*)p;
+            mf.mapped = true;
+        }
+    }
+    close(fd);
+    return mf.data || !mf.size;
+#else
+    FILE *f = fopen(filename, "rb");
+    if (!f)
+        return false;
+    fseek(f, 0, SEEK_END);
+    mf.size = (size_t)ftell(f);
+    rewind(f);
+    char *buf = new char[mf.size + 1];
+    mf.size = fread(buf, 1, mf.size, f);
+    fclose(f);
+    mf.data = buf;
+    return true;
+#endif
+}
+//---------------------------------------------------------------------------
+inline void unmap_file(t_mapped_file &mf)
+{
+#if defined(_WIN32)
+    if (mf.mapped){
+        UnmapViewOfFile(mf.data);
+        CloseHandle(mf.mapping);
+        CloseHandle(mf.file);
+    }
+#elif defined(__unix__) || defined(__APPLE__)
+    if (mf.mapped)
+        munmap((void*)mf.data, mf.size);
+#else
+    delete[] mf.data;
+#endif
+    mf.data = NULL;
+}
+//---------------------------------------------------------------------------
+// binary data format
+// a header followed by the columns of the variables and the target, each one aligned to a cache line.
+// opening such a file only maps it: the data point inside the mapping, nothing is parsed or copied.
+// the tools write it from a text file with -convert
+//---------------------------------------------------------------------------
+#define BinaryDataMagic "TGPDATA"
+#define BinaryDataVersion 1
+#define BinaryDataByteOrder 0x01020304
+#define ElementDouble 1          // variables are doubles, classes are 32 bit integers
+#define ElementBit 2             // variables and target are bits, packed in 64 bit words (see tgp_parity.cpp)
+
+struct t_binary_data_header{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;         // BinaryDataByteOrder, as written by the machine which made the file
+    uint32_t element_type;
+    uint32_t num_variables;
+    uint64_t num_data;
+    uint32_t num_classes;
+    uint32_t reserved;
+    uint64_t column_stride;      // bytes from a column to the next one
+    uint64_t data_offset;        // offset of the first column
+    uint64_t target_offset;      // offset of the column of classes
+};
+//---------------------------------------------------------------------------
+inline bool is_binary_data_file(const char *filename)
+{
+    FILE *f = fopen(filename, "rb");
+    if (!f)
+        return false;
+    char magic[8];
+    bool result = fread(magic, 1, 8, f) == 8 && !memcmp(magic, BinaryDataMagic, 8);
+    fclose(f);
+    return result;
+}
+//---------------------------------------------------------------------------
+inline bool write_padding(FILE *f, size_t size)
+{
+    char zeros[CacheLineSize];
+    memset(zeros, 0, sizeof(zeros));
+    for (; size > sizeof(zeros); size -= sizeof(zeros))
+        if (fwrite(zeros, sizeof(zeros), 1, f) != 1)
+            return false;
+    return !size || fwrite(zeros, size, 1, f) == 1;
+}
+//---------------------------------------------------------------------------
+template <typename t_variable, typename t_target>
+bool write_binary_data(const char *filename, uint32_t element_type, t_variable **data, t_target *target, int num_data, int num_variables, int num_classes)
+// the columns and the target as stored in memory: num_data elements, or with ElementBit num_data bits packed in words
+{
+    FILE *f = fopen(filename, "wb");
+    if (!f)
+        return false;
+
+    size_t num_elements = element_type == ElementBit ? ((size_t)num_data + 63) / 64 : (size_t)num_data;
+    t_binary_data_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BinaryDataMagic, 8);
+    header.version = BinaryDataVersion;
+    header.byte_order = BinaryDataByteOrder;
+    header.element_type = element_type;
+    header.num_variables = num_variables;
+    header.num_data = num_data;
+    header.num_classes = num_classes;
+    header.column_stride = (uint64_t)get_stride<t_variable>((int)num_elements) * sizeof(t_variable);
+    header.data_offset = CacheLineSize;
+    header.target_offset = header.data_offset + header.column_stride * num_variables;
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    ok = ok && write_padding(f, (size_t)header.data_offset - sizeof(header));
+    for (int j = 0; j < num_variables && ok; j++){
+        ok = fwrite(data[j], sizeof(t_variable), num_elements, f) == num_elements;
+        ok = ok && write_padding(f, (size_t)header.column_stride - num_elements * sizeof(t_variable));
+    }
+    ok = ok && fwrite(target, sizeof(t_target), num_elements, f) == num_elements;
+    ok = fclose(f) == 0 && ok;
+    return ok;
+}
+//---------------------------------------------------------------------------
+template <typename t_variable, typename t_target>
+bool open_binary_data(const char *filename, uint32_t element_type, t_mapped_file &mf, t_variable **&data, t_target *&target,
+                      int &num_data, int &num_variables, int &num_classes)
+// data and target point inside the mapped file, which is read-only; close with close_binary_data.
+// the header must describe columns aligned to their elements and inside the file; the sizes are
+// compared by divisions, so a damaged header cannot make them overflow
+{
+    if (!map_file(filename, mf))
+        return false;
+    t_binary_data_header header;
+    memset(&header, 0, sizeof(header));
+    if (mf.size >= sizeof(header))
+        memcpy(&header, mf.data, sizeof(header));
+    uint64_t file_size = mf.size;
+    // the meaningful bytes of a column of variables and of the target
+    uint64_t column_size = element_type == ElementBit ? (header.num_data + 63) / 64 * sizeof(uint64_t) : header.num_data * sizeof(t_variable);
+    uint64_t target_size = element_type == ElementBit ? column_size : header.num_data * sizeof(t_target);
+    bool valid = mf.size >= sizeof(header) && !memcmp(header.magic, BinaryDataMagic, 8) && header.version == BinaryDataVersion &&
+        header.byte_order == BinaryDataByteOrder && header.element_type == element_type &&
+        header.num_data >= 1 && header.num_data <= INT_MAX && header.num_variables >= 1 && header.num_variables <= INT_MAX && header.num_classes >= 1 &&
+        header.data_offset % sizeof(t_variable) == 0 && header.column_stride % sizeof(t_variable) == 0 && header.target_offset % sizeof(t_target) == 0 &&
+        header.column_stride >= column_size && header.data_offset >= sizeof(header) && header.data_offset <= file_size &&
+        header.column_stride <= (file_size - header.data_offset) / header.num_variables &&
+        header.target_offset >= header.data_offset + header.column_stride * header.num_variables &&
+        header.target_offset <= file_size && target_size <= file_size - header.target_offset;
+    if (!valid){
+        printf("%s is not a valid binary data file!\n", filename);
+        unmap_file(mf);
+        return false;
+    }
+    num_data = (int)header.num_data;
+    num_variables = (int)header.num_variables;
+    num_classes = (int)header.num_classes;
+    data = new t_variable*[num_variables + 1];
+    for (int j = 0; j < num_variables; j++)
+        data[j] = (t_variable*)(mf.data + header.data_offset + header.column_stride * j);
+    target = (t_target*)(mf.data + header.target_offset);
+    return true;
+}
+//---------------------------------------------------------------------------
+template <typename t_variable>
+void close_binary_data(t_mapped_file &mf, t_variable **&data)
+{
+    delete[] data;
+    data = NULL;
+    unmap_file(mf);
+}
+//---------------------------------------------------------------------------
+// telemetry
+// each island sends one record per generation: the evaluations per second, the time spent in each phase
+// of the offspring, the distribution of the fitness, the success of each operator and, optionally,
+// hardware counters. the records are written by a background thread, in JSON lines, or in CSV if the
+// file name ends with .csv, so the islands only copy a record in a buffer.
+// phases are timed with the time stamp counter of the CPU when there is one (a few cycles), otherwise
+// with the steady clock; the ticks are converted to seconds with the steady clock.
+// hardware counters (Linux only, perf_event_open) count the thread of the island, not its helper threads.
+//---------------------------------------------------------------------------
+#define MaxPhases 8
+#define NumHardwareCounters 3    // cycles, instructions, cache misses
+#define TelemetryBufferSize 1024 // records in each of the 2 buffers
+
+inline uint64_t read_ticks(void)
+{
+#if TGP_X86_SIMD
+    return __rdtsc();
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+//---------------------------------------------------------------------------
+struct t_phase_clock{
+    // adds the ticks since the last call to a phase; does nothing if ticks is NULL
+    uint64_t *ticks;
+    uint64_t last;
+};
+//---------------------------------------------------------------------------
+inline void start_phases(t_phase_clock &clock, uint64_t *ticks)
+{
+    clock.ticks = ticks;
+    clock.last = ticks ? read_ticks() : 0;
+}
+//---------------------------------------------------------------------------
+inline void end_phase(t_phase_clock &clock, int phase)
+{
+    if (clock.ticks){
+        uint64_t now = read_ticks();
+        clock.ticks[phase] += now - clock.last;
+        clock.last = now;
+    }
+}
+//---------------------------------------------------------------------------
+struct t_offspring_telemetry{
+    // filled by the thread which builds an offspring
+    uint64_t ticks[MaxPhases];
+    int op;                      // operator applied, or -1
+    bool evaluated;              // its fitness was computed
+    bool improved;               // better than both parents
+};
+
+struct t_telemetry_record{
+    int island, generation;
+    double time;                 // seconds since the start of the run, at the end of the generation
+    double seconds;              // duration of the generation
+    int num_evaluations;
+    double phase_seconds[MaxPhases];
+    int best_fitness, median_fitness, worst_fitness;
+    double mean_fitness;
+    int applied[MaxOperators], improved[MaxOperators];
+    bool has_counters;
+    uint64_t counters[NumHardwareCounters];
+};
+
+struct t_telemetry{
+    FILE *f;
+    bool csv;
+    int num_phases;
+    const char *const *phase_names;
+    int num_operators;
+    const char *const *operator_names;
+    bool hardware_counters;      // requested
+
+    std::chrono::steady_clock::time_point start_time;
+    uint64_t start_ticks;
+
+    // double buffering: the islands fill one buffer while the writer formats the other one
+    t_telemetry_record *filling, *writing;
+    int num_filling;
+    std::mutex mutex;
+    std::condition_variable records_available, space_available;
+    bool stop;
+    std::thread writer;
+};
+
+struct t_hardware_counters{
+    int fd[NumHardwareCounters]; // -1 if not available
+};
+
+struct t_island_telemetry{
+    t_telemetry *telemetry;
+    t_offspring_telemetry *offspring;  // one per individual of the population
+    int pop_size;
+    int *sorted_fitness;         // work array for the median
+    uint64_t island_ticks[MaxPhases];  // phases run by the island itself (migration, ...)
+    std::chrono::steady_clock::time_point generation_start;
+    t_hardware_counters counters;
+    uint64_t last_counters[NumHardwareCounters];
+    t_telemetry_record record;
+};
+//---------------------------------------------------------------------------
+inline bool open_hardware_counters(t_hardware_counters &hc)
+// counts the calling thread, in user mode; returns false if the system does not allow it
+{
+    bool ok = true;
+    for (int i = 0; i < NumHardwareCounters; i++){
+        hc.fd[i] = -1;
+#if defined(__linux__)
+        static const uint64_t configs[NumHardwareCounters] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES };
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = configs[i];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        hc.fd[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+        ok = ok && hc.fd[i] >= 0;
+    }
+    return ok;
+}
+//---------------------------------------------------------------------------
+inline void read_hardware_counters(t_hardware_counters &hc, uint64_t *values)
+{
+    for (int i = 0; i < NumHardwareCounters; i++){
+        values[i] = 0;
+#if defined(__linux__)
+        if (hc.fd[i] >= 0 && read(hc.fd[i], &values[i], sizeof(uint64_t)) != sizeof(uint64_t))
+            values[i] = 0;
+#endif
+    }
+}
+//---------------------------------------------------------------------------
+inline void close_hardware_counters(t_hardware_counters &hc)
+{
+#if defined(__linux__)
+    for (int i = 0; i < NumHardwareCounters; i++)
+        if (hc.fd[i] >= 0)
+            close(hc.fd[i]);
+#endif
+}
+//---------------------------------------------------------------------------
+inline void write_csv_header(t_telemetry &t)
+{
+    static const char *counter_names[NumHardwareCounters] = { "cycles", "instructions", "cache_misses" };
+    fprintf(t.f, "island,generation,time,seconds,evaluations,evaluations_per_second");
+    for (int p = 0; p < t.num_phases; p++)
+        fprintf(t.f, ",%s_seconds", t.phase_names[p]);
+    fprintf(t.f, ",best_fitness,mean_fitness,median_fitness,worst_fitness");
+    for (int o = 0; o < t.num_operators; o++)
+        fprintf(t.f, ",%s_applied,%s_improved", t.operator_names[o], t.operator_names[o]);
+    if (t.hardware_counters)
+        for (int c = 0; c < NumHardwareCounters; c++)
+            fprintf(t.f, ",%s", counter_names[c]);
+    fprintf(t.f, "\n");
+}
+//---------------------------------------------------------------------------
+inline void write_record(t_telemetry &t, const t_telemetry_record &r)
+{
+    static const char *counter_names[NumHardwareCounters] = { "cycles", "instructions", "cache_misses" };
+    double evaluations_per_second = r.seconds > 0 ? r.num_evaluations / r.seconds : 0;
+    if (t.csv){
+        fprintf(t.f, "%d,%d,%.6f,%.9f,%d,%.6g", r.island, r.generation, r.time, r.seconds, r.num_evaluations, evaluations_per_second);
+        for (int p = 0; p < t.num_phases; p++)
+            fprintf(t.f, ",%.9f", r.phase_seconds[p]);
+        fprintf(t.f, ",%d,%.6g,%d,%d", r.best_fitness, r.mean_fitness, r.median_fitness, r.worst_fitness);
+        for (int o = 0; o < t.num_operators; o++)
+            fprintf(t.f, ",%d,%d", r.applied[o], r.improved[o]);
+        if (t.hardware_counters)
+            for (int c = 0; c < NumHardwareCounters; c++)
+                r.has_counters ? fprintf(t.f, ",%llu", (unsigned long long)r.counters[c]) : fprintf(t.f, ",");
+        fprintf(t.f, "\n");
+        return;
+    }
+    fprintf(t.f, "{\"island\": %d, \"generation\": %d, \"time\": %.6f, \"seconds\": %.9f, \"evaluations\": %d, \"evaluations_per_second\": %.6g, \"phase_seconds\": {",
+            r.island, r.generation, r.time, r.seconds, r.num_evaluations, evaluations_per_second);
+    for (int p = 0; p < t.num_phases; p++)
+        fprintf(t.f, "%s\"%s\": %.9f", p ? ", " : "", t.phase_names[p], r.phase_seconds[p]);
+    fprintf(t.f, "}, \"fitness\": {\"best\": %d, \"mean\": %.6g, \"median\": %d, \"worst\": %d}, \"operators\": {",
+            r.best_fitness, r.mean_fitness, r.median_fitness, r.worst_fitness);
+    for (int o = 0; o < t.num_operators; o++)
+        fprintf(t.f, "%s\"%s\": {\"applied\": %d, \"improved\": %d}", o ? ", " : "", t.operator_names[o], r.applied[o], r.improved[o]);
+    fprintf(t.f, "}");
+    if (r.has_counters){
+        fprintf(t.f, ", \"counters\": {");
+        for (int c = 0; c < NumHardwareCounters; c++)
+            fprintf(t.f, "%s\"%s\": %llu", c ? ", " : "", counter_names[c], (unsigned long long)r.counters[c]);
+        fprintf(t.f, "}");
+    }
+    fprintf(t.f, "}\n");
+}
+//---------------------------------------------------------------------------
+inline void telemetry_writer(t_telemetry *t)
+{
+    std::unique_lock<std::mutex> lock(t->mutex);
+    for (;;){
+        while (!t->stop && t->num_filling < TelemetryBufferSize / 2)
+            t->records_available.wait_for(lock, std::chrono::milliseconds(200));
+        int n = t->num_filling;
+        std::swap(t->filling, t->writing);
+        t->num_filling = 0;
+        bool stop = t->stop;
+        t->space_available.notify_all();
+        lock.unlock();
+        for (int i = 0; i < n; i++)
+            write_record(*t, t->writing[i]);
+        fflush(t->f);
+        lock.lock();
+        if (stop && !t->num_filling)
+            return;
+    }
+}
+//---------------------------------------------------------------------------
+inline bool start_telemetry(t_telemetry &t, const char *filename, bool hardware_counters, int num_phases, const char *const *phase_names,
+                            int num_operators, const char *const *operator_names)
+{
+    t.f = fopen(filename, "w");
+    if (!t.f)
+        return false;
+    size_t length = strlen(filename);
+    t.csv = length >= 4 && !strcmp(filename + length - 4, ".csv");
+    t.num_phases = num_phases;
+    t.phase_names = phase_names;
+    t.num_operators = num_operators;
+    t.operator_names = operator_names;
+    t.hardware_counters = hardware_counters;
+    if (t.csv)
+        write_csv_header(t);
+    t.filling = new t_telemetry_record[TelemetryBufferSize];
+    t.writing = new t_telemetry_record[TelemetryBufferSize];
+    t.num_filling = 0;
+    t.stop = false;
+    t.start_time = std::chrono::steady_clock::now();
+    t.start_ticks = read_ticks();
+    t.writer = std::thread(telemetry_writer, &t);
+    return true;
+}
+//---------------------------------------------------------------------------
+inline void stop_telemetry(t_telemetry &t)
+{
+    {
+        std::lock_guard<std::mutex> lock(t.mutex);
+        t.stop = true;
+    }
+    t.records_available.notify_one();
+    t.writer.join();
+    fclose(t.f);
+    delete[] t.filling;
+    delete[] t.writing;
+}
+//---------------------------------------------------------------------------
+inline void send_record(t_telemetry &t, const t_telemetry_record &r)
+// waits only if the writer is late by a whole buffer
+{
+    std::unique_lock<std::mutex> lock(t.mutex);
+    while (t.num_filling == TelemetryBufferSize)
+        t.space_available.wait(lock);
+    t.filling[t.num_filling++] = r;
+    if (t.num_filling == TelemetryBufferSize / 2)
+        t.records_available.notify_one();
+}
+//---------------------------------------------------------------------------
+inline void start_island_telemetry(t_island_telemetry &it, t_telemetry *t, int island, int pop_size)
+// it.offspring is NULL if there is no telemetry, so the offspring can test it
+{
+    it.telemetry = t;
+    it.offspring = NULL;
+    if (!t)
+        return;
+    it.offspring = new t_offspring_telemetry[pop_size];
+    it.pop_size = pop_size;
+    it.sorted_fitness = new int[pop_size];
+    it.record.island = island;
+    it.record.has_counters = false;
+    if (t->hardware_counters){
+        it.record.has_counters = open_hardware_counters(it.counters);
+        if (!it.record.has_counters)
+            fprintf(stderr, "island %d: hardware counters are not available\n", island);
+        read_hardware_counters(it.counters, it.last_counters);
+    }
+}
+//---------------------------------------------------------------------------
+inline void begin_generation_telemetry(t_island_telemetry &it, int generation)
+{
+    if (!it.telemetry)
+        return;
+    memset(it.offspring, 0, it.pop_size * sizeof(t_offspring_telemetry));
+    for (int k = 0; k < it.pop_size; k++)
+        it.offspring[k].op = -1;
+    memset(it.island_ticks, 0, sizeof(it.island_ticks));
+    it.record.generation = generation;
+    it.generation_start = std::chrono::steady_clock::now();
+}
+//---------------------------------------------------------------------------
+inline void end_generation_telemetry(t_island_telemetry &it, const int *fitness)
+// fitness: the population built by the generation
+{
+    if (!it.telemetry)
+        return;
+    t_telemetry &t = *it.telemetry;
+    t_telemetry_record &r = it.record;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    r.seconds = std::chrono::duration<double>(now - it.generation_start).count();
+    r.time = std::chrono::duration<double>(now - t.start_time).count();
+    uint64_t ticks = read_ticks() - t.start_ticks;
+    double seconds_per_tick = ticks ? r.time / ticks : 0;
+
+    uint64_t phase_ticks[MaxPhases];
+    memcpy(phase_ticks, it.island_ticks, sizeof(phase_ticks));
+    r.num_evaluations = 0;
+    for (int o = 0; o < t.num_operators; o++)
+        r.applied[o] = r.improved[o] = 0;
+    double sum = 0;
+    for (int k = 0; k < it.pop_size; k++){
+        const t_offspring_telemetry &o = it.offspring[k];
+        for (int p = 0; p < t.num_phases; p++)
+            phase_ticks[p] += o.ticks[p];
+        r.num_evaluations += o.evaluated;
+        if (o.op >= 0){
+            r.applied[o.op]++;
+            r.improved[o.op] += o.improved;
+        }
+        sum += fitness[k];
+        it.sorted_fitness[k] = fitness[k];
+    }
+    for (int p = 0; p < t.num_phases; p++)
+        r.phase_seconds[p] = phase_ticks[p] * seconds_per_tick;
+    std::nth_element(it.sorted_fitness, it.sorted_fitness + it.pop_size / 2, it.sorted_fitness + it.pop_size);
+    r.median_fitness = it.sorted_fitness[it.pop_size / 2];
+    r.best_fitness = *std::min_element(it.sorted_fitness, it.sorted_fitness + it.pop_size);
+    r.worst_fitness = *std::max_element(it.sorted_fitness, it.sorted_fitness + it.pop_size);
+    r.mean_fitness = sum / it.pop_size;
+    if (r.has_counters){
+        uint64_t values[NumHardwareCounters];
+        read_hardware_counters(it.counters, values);
+        for (int c = 0; c < NumHardwareCounters; c++){
+            r.counters[c] = values[c] - it.last_counters[c];
+            it.last_counters[c] = values[c];
+        }
+    }
+    send_record(t, r);
+}
+//---------------------------------------------------------------------------
+inline void stop_island_telemetry(t_island_telemetry &it)
+{
+    if (!it.telemetry)
+        return;
+    if (it.record.has_counters)
+        close_hardware_counters(it.counters);
+    delete[] it.offspring;
+    delete[] it.sorted_fitness;
+}
+//---------------------------------------------------------------------------
+// checkpoints
+// a snapshot of a run is serialized in memory by the thread running the generations, then written to
+// the disk by a background thread, so the run never waits for the disk. there are 2 buffers: one is
+// written while the other one receives the next snapshot; when a snapshot is ready and the previous one
+// is still waiting for the writer, the waiting one is dropped. a snapshot is written under a temporary
+// name, then renamed: a crash while writing leaves the previous checkpoint intact.
+// snapshots are raw memory, so they are read back on the same kind of machine
+//---------------------------------------------------------------------------
+#define SnapshotMagic "TGPSNAP1"  // 8 bytes at the start of each snapshot
+
+struct t_snapshot_buffer{
+    char *data;
+    size_t size, capacity;
+};
+
+struct t_checkpoint_writer{
+    const char *filename;
+    char *temporary_name;
+    t_snapshot_buffer buffer[2];
+    int filling;                 // buffer filled by the run (-1 if none)
+    int pending;                 // buffer waiting for the writer (-1 if none)
+    int writing;                 // buffer being written (-1 if none)
+    int num_written, num_dropped;
+    bool failed;                 // a snapshot could not be written
+    std::mutex mutex;
+    std::condition_variable snapshot_available;
+    bool stop;
+    std::thread writer;
+};
+
+struct t_snapshot_reader{
+    const char *p, *end;
+    bool ok;                     // false once a read went past the end
+};
+//---------------------------------------------------------------------------
+inline bool write_snapshot_file(const char *filename, const char *temporary_name, const t_snapshot_buffer &b)
+{
+    FILE *f = fopen(temporary_name, "wb");
+    if (!f)
+        return false;
+    bool ok = fwrite(b.data, 1, b.size, f) == b.size;
+    ok = fclose(f) == 0 && ok;
+#if defined(_WIN32)
+    if (ok)
+        remove(filename); // rename does not replace a file
+#endif
+    return ok && rename(temporary_name, filename) == 0;
+}
+//---------------------------------------------------------------------------
+inline void checkpoint_writer(t_checkpoint_writer *w)
+{
+    std::unique_lock<std::mutex> lock(w->mutex);
+    for (;;){
+        while (!w->stop && w->pending < 0)
+            w->snapshot_available.wait(lock);
+        if (w->pending < 0)
+            return;
+        w->writing = w->pending;
+        w->pending = -1;
+        lock.unlock();
+        bool ok = write_snapshot_file(w->filename, w->temporary_name, w->buffer[w->writing]);
+        lock.lock();
+        w->writing = -1;
+        if (ok)
+            w->num_written++;
+        else
+            w->failed = true;
+    }
+}
+//---------------------------------------------------------------------------
+inline void start_checkpoint_writer(t_checkpoint_writer &w, const char *filename)
+{
+    w.filename = filename;
+    w.temporary_name = new char[strlen(filename) + 5];
+    strcpy(w.temporary_name, filename);
+    strcat(w.temporary_name, ".tmp");
+    for (int i = 0; i < 2; i++){
+        w.buffer[i].data = NULL;
+        w.buffer[i].size = w.buffer[i].capacity = 0;
+    }
+    w.filling = w.pending = w.writing = -1;
+    w.num_written = w.num_dropped = 0;
+    w.failed = false;
+    w.stop = false;
+    w.writer = std::thread(checkpoint_writer, &w);
+}
+//---------------------------------------------------------------------------
+inline void stop_checkpoint_writer(t_checkpoint_writer &w)
+// the snapshot waiting for the writer is written first
+{
+    {
+        std::lock_guard<std::mutex> lock(w.mutex);
+        w.stop = true;
+    }
+    w.snapshot_available.notify_one();
+    w.writer.join();
+    for (int i = 0; i < 2; i++)
+        delete[] w.buffer[i].data;
+    delete[] w.temporary_name;
+}
+//---------------------------------------------------------------------------
+inline char* begin_snapshot(t_checkpoint_writer &w, size_t size)
+// returns the memory where the run serializes a snapshot of size bytes; never waits for the writer
+{
+    {
+        std::lock_guard<std::mutex> lock(w.mutex);
+        if (w.pending >= 0){
+            w.filling = w.pending;
+            w.pending = -1;
+            w.num_dropped++;
+        }
+        else
+            w.filling = w.writing == 0 ? 1 : 0;
+    }
+    t_snapshot_buffer &b = w.buffer[w.filling];
+    if (b.capacity < size){
+        delete[] b.data;
+        b.data = new char[size];
+        b.capacity = size;
+    }
+    b.size = size;
+    return b.data;
+}
+//---------------------------------------------------------------------------
+inline void end_snapshot(t_checkpoint_writer &w)
+{
+    {
+        std::lock_guard<std::mutex> lock(w.mutex);
+        w.pending = w.filling;
+        w.filling = -1;
+    }
+    w.snapshot_available.notify_one();
+}
+//---------------------------------------------------------------------------
+inline void put_bytes(char *&p, const void *x, size_t size)
+{
+    memcpy(p, x, size);
+    p += size;
+}
+//---------------------------------------------------------------------------
+template <typename T>
+inline void put_value(char *&p, const T &x)
+{
+    put_bytes(p, &x, sizeof(T));
+}
+//---------------------------------------------------------------------------
+inline void get_bytes(t_snapshot_reader &r, void *x, size_t size)
+// a read past the end gives zeros
+{
+    if (!r.ok || (size_t)(r.end - r.p) < size){
+        r.ok = false;
+        memset(x, 0, size);
+        return;
+    }
+    memcpy(x, r.p, size);
+    r.p += size;
+}
+//---------------------------------------------------------------------------
+template <typename T>
+inline T get_value(t_snapshot_reader &r)
+{
+    T x;
+    get_bytes(r, &x, sizeof(T));
+    return x;
+}
+//---------------------------------------------------------------------------
+// lineage
+// the lineage records how the programs were built: a node is a variable or an operator applied to
+// the nodes of the 2 parents. TGP itself needs only the values, but with the lineage a program can be
+// evaluated again, on other data.
+// nodes are only added, after their parents: each generation reserves one node for each offspring, which
+// writes it without any lock or reference count. the problem decides when the nodes which its programs do
+// not need anymore are collected (see collect_lineage_garbage); nobody reads the lineage meanwhile.
+// nodes are allocated in chunks which never move: a node can be read while other nodes are added.
+//---------------------------------------------------------------------------
+#define LineageChunkBits 16
+#define LineageChunkSize (1 << LineageChunkBits)
+#define MaxLineageChunks (1 << 14)   // at most 2^30 nodes
+#define MinLineageCollection (1 << 20) // the lineage is not collected before it has this many nodes
+
+struct t_lineage_node{
+    int op;                      // operator, or -1 for a variable
+    int left, right;             // nodes of the parents; for a variable, left is the index of the variable
+};
+
+struct t_lineage{
+    t_lineage_node **chunk;
+    int num_chunks;
+    std::atomic<int> num_nodes;  // nodes reserved so far, including those which are not needed anymore
+    int collect_at;              // the lineage is collected when it has this many nodes: twice as many as it kept
+    int num_variables;           // nodes 0 .. num_variables - 1 are the variables; they are never collected
+    std::mutex mutex;            // held while nodes are reserved
+};
+//---------------------------------------------------------------------------
+inline t_lineage_node& get_node(t_lineage &lineage, int node)
+{
+    return lineage.chunk[node >> LineageChunkBits][node & (LineageChunkSize - 1)];
+}
+//---------------------------------------------------------------------------
+inline void allocate_lineage(t_lineage &lineage, int num_variables)
+{
+    lineage.chunk = new t_lineage_node*[MaxLineageChunks];
+    lineage.num_chunks = 0;
+    lineage.collect_at = MinLineageCollection;
+    lineage.num_variables = num_variables;
+    for (int j = 0; j < num_variables; j += LineageChunkSize)
+        lineage.chunk[lineage.num_chunks++] = new t_lineage_node[LineageChunkSize];
+    for (int j = 0; j < num_variables; j++){
+        t_lineage_node &x = get_node(lineage, j);
+        x.op = -1;
+        x.left = j;
+        x.right = -1;
+    }
+    lineage.num_nodes = num_variables;
+}
+//---------------------------------------------------------------------------
+inline void delete_lineage(t_lineage &lineage)
+{
+    for (int i = 0; i < lineage.num_chunks; i++)
+        delete[] lineage.chunk[i];
+    delete[] lineage.chunk;
+}
+//---------------------------------------------------------------------------
+inline int set_node(t_lineage &lineage, int node, int op, int left, int right)
+// node is a reserved node; the parents must be older nodes
+{
+    t_lineage_node &x = get_node(lineage, node);
+    x.op = op;
+    x.left = left;
+    x.right = right;
+    return node;
+}
+//---------------------------------------------------------------------------
+inline int reserve_nodes(t_lineage &lineage, int n)
+// returns the first of n consecutive new nodes, which are written by set_node
+{
+    std::lock_guard<std::mutex> lock(lineage.mutex);
+    int first = lineage.num_nodes;
+    if (n > MaxLineageChunks * LineageChunkSize - first){
+        printf("The lineage is too large!\n");
+        exit(1);
+    }
+    while (lineage.num_chunks * LineageChunkSize < first + n)
+        lineage.chunk[lineage.num_chunks++] = new t_lineage_node[LineageChunkSize];
+    // a node which is not written (the offspring was a copy) is a program of the first variable, which nobody uses
+    for (int k = first; k < first + n; k++)
+        set_node(lineage, k, -1, 0, 0);
+    lineage.num_nodes = first + n;
+    return first;
+}
+//---------------------------------------------------------------------------
+inline void collect_lineage_garbage(t_lineage &lineage, int **root, int num_roots)
+// keeps only the nodes needed by the roots (the nodes held by the programs, -1 for none), renumbered in the
+// same order, so that the parents still come first; the roots receive the new numbers.
+// nobody may read or write the lineage meanwhile. the lineage is large, so each pass reads it in order,
+// without branches
+{
+    int num_nodes = lineage.num_nodes;
+    int num_variables = lineage.num_variables;
+    char *needed = new char[num_nodes]();
+    int *position = new int[num_nodes];  // new number of each node (of the next needed one for the others)
+    for (int r = 0; r < num_roots; r++)
+        if (*root[r] >= 0)
+            needed[*root[r]] = 1;
+    // the parents are older than their children: one pass from the newest node finds all the nodes needed
+    for (int n = num_nodes - 1; n >= num_variables; n--){
+        t_lineage_node &x = get_node(lineage, n);
+        needed[x.left] |= needed[n];
+        needed[x.right] |= needed[n];
+    }
+    for (int n = 0; n < num_variables; n++)
+        position[n] = n;
+    // a node which is not needed is copied too, then overwritten by the next needed one
+    int num_kept = num_variables;
+    for (int n = num_variables; n < num_nodes; n++){
+        t_lineage_node x = get_node(lineage, n);
+        x.left = position[x.left];
+        x.right = position[x.right];
+        position[n] = num_kept;
+        get_node(lineage, num_kept) = x;
+        num_kept += needed[n];
+    }
+    for (int r = 0; r < num_roots; r++)
+        if (*root[r] >= 0)
+            *root[r] = position[*root[r]];
+    lineage.num_nodes = num_kept;
+    lineage.collect_at = num_kept > MinLineageCollection / 2 ? 2 * num_kept : MinLineageCollection;
+    delete[] needed;
+    delete[] position;
+}
+//---------------------------------------------------------------------------
+// the GP loop
+// each island evolves a population of programs, known only by their values on the fitness cases: an
+// offspring is a variable (insertion), a copy of a parent or an operator applied to 2 parents, whose values
+// are computed from theirs. the loop is the same for every problem, which gives it as a policy struct
+// (derived from t_gp_problem, whose hooks do nothing):
+//
+//    typedef ... t_value;           the values of the programs (see the kernels)
+//    typedef ... t_target;          the targets of the data
+//    typedef ... t_parameters;      derived from t_gp_parameters
+//    typedef ... t_run;             the data of a run, derived from t_gp_run<t_value>
+//    typedef ... t_island_data;     what the problem keeps for each island
+//    static const t_kernels<t_value, t_target>& kernels(void);
+//    static int evaluate(t_generation<t_problem> &gen, int op, const t_value *a, const t_value *b, t_value *result,
+//                        uint64_t *hash, t_phase_clock &clock);
+//        result = a op b on gen.num_values values, and its hash if hash is not NULL; returns its errors, or
+//        if gen.max_errors >= 0, a number above gen.max_errors as soon as there are more errors
+//    static int begin_island(t_island<t_problem> &island);
+//        sets the data of the generations of the island (gen.target, num_data, num_values, last_mask and the
+//        functions if not all), then builds the first population (init_population); returns its generation
+//    static void print_generation(t_island<t_problem> &island, int generation);
+//
+// and the hooks which it needs among those of t_gp_problem. an island is a thread, whose own thread pool
+// builds the offspring of a generation concurrently; the islands share the pool of values and exchange
+// migrants through lock-free queues.
+//---------------------------------------------------------------------------
+#define MaxDuplicateRetries 3
+#define MultiobjectiveTournamentSize 2
+#define MigrationRing 0          // island i sends to island i + 1
+#define MigrationAllToAll 1      // each island sends to all the others
+
+// the phases timed by the telemetry; a problem numbers its own phases from NumLoopPhases. the population is
+// never sorted, only the best individuals are selected for migration, so sorting is part of migration
+#define PhaseSelection 0
+#define PhaseOperators 1         // with the counting of errors, if the problem does both in one pass
+#define PhaseFitness 2           // the counting of errors, and the semantic cache
+#define PhaseCopy 3
+#define PhaseMigration 4
+#define PhaseLineage 5
+#define NumLoopPhases 6
+//---------------------------------------------------------------------------
+struct t_gp_parameters{
+    int num_generations;
+    int pop_size;                // population size
+    double insertion_probability, crossover_probability;
+
+    unsigned int seed;           // the run depends only on the seed, not on the number of threads
+    int num_threads;             // threads building the offspring
+    int print_interval;          // the best fitness is printed every print_interval generations (0 = never)
+
+    // island model: several populations evolve in parallel, each on its own threads, and send
+    // copies of their best individuals to their neighbours; migration is asynchronous (no barrier)
+    int num_islands;             // 1 means a single population
+    int migration_interval;      // number of generations between 2 migrations of an island
+    int num_migrants;            // number of best individuals sent to each neighbour
+    int migration_topology;      // MigrationRing or MigrationAllToAll
+
+    const char *telemetry_file;  // per generation metrics of each island (NULL = none); CSV if it ends with .csv
+    bool hardware_counters;      // adds the cycles, instructions and cache misses to the metrics
+
+    // semantic cache: the values of each program are hashed, and the result of an operator applied to 2
+    // parents with known values is remembered, so it is not evaluated again (see semantic hashing).
+    // with reject_duplicates, an offspring whose values are already in the current population is built
+    // again, at most MaxDuplicateRetries times, which keeps the population more diverse
+    bool semantic_cache;         // does not change the results
+    bool reject_duplicates;      // changes the results; implies semantic_cache
+
+    // in place steady state: a single population, where each offspring replaces the worse of 2 individuals
+    // as soon as it is built; the same number of offspring makes a generation. the population needs half the
+    // memory, but with several threads the results depend on their timing
+    bool in_place;
+};
+//---------------------------------------------------------------------------
+template <typename t_value>
+struct t_tgp_chromosome{
+    t_value *value;  // value of the current program for each fitness case
+    int buffer;     // the buffer of the value pool which holds value (-1 if none)
+    int node;       // the lineage node of the program (-1 if the lineage is not recorded)
+    uint64_t hash;  // hash of value (only with the semantic cache)
+} ;
+//---------------------------------------------------------------------------
+template <typename t_value>
+struct t_tgp_population{
+    // the population is never sorted: individuals are addressed by index and the best one is tracked
+    // while the offspring are built; fitness is kept apart, so selection reads a dense array
+    t_tgp_chromosome<t_value> *chromosome;
+    int *fitness;          //num incorrect classified
+    int best;              // index of the best individual
+    int worst_fitness;
+    int *objectives;       // multiobjective: the objectives of the problem, then the depth, of each individual (else NULL)
+    int *selection_rank;   // multiobjective: position of each individual in the crowded order (lower is better)
+} ;
+//---------------------------------------------------------------------------
+template <typename t_value>
+void alocate_population(t_tgp_population<t_value> &pop, int pop_size)
+{
+    pop.chromosome = new t_tgp_chromosome<t_value>[pop_size];
+    pop.fitness = new int[pop_size];
+    pop.objectives = NULL;
+    pop.selection_rank = NULL;
+
+    for (int i = 0; i < pop_size; i++){
+        pop.chromosome[i].value = NULL;
+        pop.chromosome[i].buffer = -1;
+        pop.chromosome[i].node = -1;
+        pop.chromosome[i].hash = 0;
+    }
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void copy_chromosome(t_tgp_chromosome<t_value>& dest, t_tgp_chromosome<t_value>& source, t_value_pool<t_value> &pool)
+// no values are copied: dest shares the buffer of source
+{
+    share_buffer(dest, pool, source.buffer);
+    dest.hash = source.hash;
+    dest.node = source.node;
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void init_variable_buffers(int *&variable_buffer, t_value_pool<t_value> &pool, int num_variables, t_value ** data)
+// the column of each variable is shared by all simple programs made from it
+{
+    variable_buffer = new int[num_variables];
+    for (int j = 0; j < num_variables; j++)
+        variable_buffer[j] = add_external_buffer(pool, data[j]);
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+int init_chromosome(t_tgp_chromosome<t_value> &c, int num_variables, int *variable_buffer, uint64_t *variable_hash, t_value_pool<t_value> &pool, t_lineage *lineage, t_random &r)
+// returns the variable
+{
+    int random_var = random_int(r, num_variables);
+
+    share_buffer(c, pool, variable_buffer[random_var]);
+    c.hash = variable_hash[random_var];
+    c.node = lineage ? random_var : -1;
+    return random_var;
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void find_best(t_tgp_population<t_value> &pop, int pop_size)
+{
+    pop.best = 0;
+    pop.worst_fitness = pop.fitness[0];
+    for (int i = 1; i < pop_size; i++){
+        if (pop.fitness[i] < pop.fitness[pop.best])
+            pop.best = i;
+        if (pop.fitness[i] > pop.worst_fitness)
+            pop.worst_fitness = pop.fitness[i];
+    }
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void select_best(t_tgp_population<t_value> &pop, int pop_size, int k, int *index)
+// index[0 .. k - 1] = the k best individuals (best first), without sorting the population
+// index must have room for pop_size elements
+{
+    for (int i = 0; i < pop_size; i++)
+        index[i] = i;
+    t_rank_compare compare = { pop.fitness };
+    std::partial_sort(index, index + k, index + pop_size, compare);
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void release_chromosome(t_tgp_chromosome<t_value> &c, t_value_pool<t_value> &pool)
+{
+    if (c.buffer >= 0)
+        release_buffer(pool, c.buffer);
+    c.value = NULL;
+    c.buffer = -1;
+    c.node = -1;
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void release_chromosomes(t_tgp_population<t_value> &pop, int pop_size, t_value_pool<t_value> &pool)
+{
+    for (int i = 0; i < pop_size; i++)
+        release_chromosome(pop.chromosome[i], pool);
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void free_pop_memory(t_tgp_population<t_value> &pop, int pop_size, t_value_pool<t_value> &pool)
+{
+    release_chromosomes(pop, pop_size, pool);
+
+    delete[] pop.chromosome;
+    delete[] pop.fitness;
+    delete[] pop.objectives;
+    delete[] pop.selection_rank;
+}
+//---------------------------------------------------------------------------
+struct t_migrant{
+    int buffer;     // the migrant owns a reference to this buffer of the value pool
+    int node;       // its lineage node (if the lineage is recorded)
+    int fitness;
+    uint64_t hash;
+};
+//---------------------------------------------------------------------------
+template <typename t_value>
+struct t_gp_run{
+    // data and storage shared by all islands; the run of a problem derives from it
+    int num_variables;
+    t_value_pool<t_value> pool;           // one pool, so migrants share their values instead of copying them
+    int *variable_buffer;
+    int *variable_fitness;       // fitness and hash of each variable on the data seen by the individuals,
+    uint64_t *variable_hash;     // computed by the problem
+    t_lineage *lineage;          // NULL if the lineage is not recorded
+
+    t_migration_queue<t_migrant> *queues;   // queues[from * num_islands + to]
+    unsigned int queue_capacity;
+    int *best_fitness;           // best fitness of each island at the end of the run
+    t_telemetry *telemetry;      // NULL if there is no telemetry
+};
+//---------------------------------------------------------------------------
+template <typename t_problem>
+struct t_generation{
+    // everything needed to build a chromosome of a generation
+    typedef typename t_problem::t_value t_value;
+    typename t_problem::t_parameters *parameters;
+    typename t_problem::t_run *run;
+    t_tgp_population<t_value> *current_pop, *new_pop;
+    t_value_pool<t_value> *pool;
+    t_lineage *lineage;          // NULL if the lineage is not recorded
+    int first_node;              // the nodes reserved for the generation start here: the kth offspring writes
+                                 // first_node + k, or in place the next one, since its parents may be newer offspring
+    int *variable_buffer;
+    int *variable_fitness;
+    uint64_t *variable_hash;
+    int num_variables;
+    // the data seen by the individuals, set by the problem
+    const typename t_problem::t_target *target;
+    int num_data;                // fitness cases
+    int num_values;              // values of a program: num_data, or fewer if the fitness cases are packed
+    uint64_t last_mask;          // meaningful bits of the last word of the values (see finish_hash)
+    int generation;
+    int max_errors;              // cutoff of the evaluation of the offspring (-1 = none)
+    int num_objectives;          // 0 if the fitness is the only objective
+    int num_functions;
+    int function[MaxOperators];  // the operators used, all those of the kernels by default
+    t_offspring_telemetry *telemetry;  // one per chromosome, NULL if there is no telemetry
+    t_semantic_cache *cache;     // NULL if there is no semantic cache
+    t_hash_set *present;         // hashes of the current population, if duplicates are rejected (else NULL)
+    t_slot_locks *slots;         // in place: the locks of the individuals of current_pop (else NULL)
+
+    std::atomic<uint64_t> best_key;  // rank_key of the best individual built so far
+    std::atomic<int> worst_fitness;
+    std::atomic<int> next_node;  // in place: the next reserved node
+};
+//---------------------------------------------------------------------------
+struct t_multiobjective{
+    // work memory for ranking the current population and its offspring together
+    int num_objectives;
+    int *objectives;             // of the 2 populations, the current one first
+    int *fitness;
+    int *front;
+    double *distance;            // crowding distance in the front
+    int *order;                  // crowded order
+    int *slot;                   // place of each survivor in the new population
+    int front_size;              // number of individuals of the current population in the first front
+};
+//---------------------------------------------------------------------------
+template <typename t_problem>
+struct t_island{
+    // the state of an island, given to the hooks of the problem
+    typedef typename t_problem::t_value t_value;
+    typename t_problem::t_parameters *parameters;  // of the island: its own seed and threads
+    typename t_problem::t_run *run;
+    int index;                   // of the island in the run
+    t_tgp_population<t_value> current_pop, new_pop; // new_pop is not allocated in place
+    t_generation<t_problem> gen;
+    t_thread_pool threads;       // they build the offspring of the island
+    t_island_telemetry telemetry;
+    t_phase_clock clock;         // the phases run by the island itself
+    t_semantic_cache cache;
+    t_hash_set present;
+    t_slot_locks slots;
+    t_multiobjective mo;         // if the problem has several objectives
+    int *index_work;             // pop_size indices, for migration
+    t_migrant *arrived;          // room for the content of all incoming queues
+    typename t_problem::t_island_data data;
+};
+//---------------------------------------------------------------------------
+struct t_gp_problem{
+    // the hooks which a problem may not need (see the GP loop)
+    struct t_island_data{};
+    static bool unary(int) { return false; }           // of the operators, for the semantic cache
+    static bool commutative(int) { return false; }
+    template <typename t_parameters, typename t_run>
+    static int num_objectives(t_parameters &, t_run &) { return 0; }  // more objectives than the fitness, plus the depth
+    template <typename t_gen, typename t_value>
+    static void objectives(t_gen &, const t_value *, int, int *) {}    // of a program, but its depth (the last one)
+    template <typename t_state>
+    static bool begin_generation(t_state &, int) { return true; }     // false stops the island
+    template <typename t_state>
+    static int max_errors(t_state &) { return -1; }                   // see t_generation::max_errors
+    template <typename t_state>
+    static void end_generation(t_state &, int) {}
+    template <typename t_state>
+    static void end_island(t_state &, int) {}                         // before its memory is released
+};
+//---------------------------------------------------------------------------
+template <typename t_problem>
+void compute_objectives(t_generation<t_problem> &gen, t_tgp_population<typename t_problem::t_value> &pop, int k, int depth)
+// the objectives of the problem, then the depth of the program
+{
+    int *objectives = pop.objectives + k * gen.num_objectives;
+    t_problem::objectives(gen, pop.chromosome[k].value, pop.fitness[k], objectives);
+    objectives[gen.num_objectives - 1] = depth;
+}
+//---------------------------------------------------------------------------
+template <typename t_problem>
+void init_task(int k, void *context)
+// builds the kth chromosome of the initial population
+{
+    t_generation<t_problem> &gen = *(t_generation<t_problem>*)context;
+    t_random r;
+    init_random(r, gen.parameters->seed, 0, k);
+    t_tgp_population<typename t_problem::t_value> &pop = *gen.current_pop;
+    int v = init_chromosome(pop.chromosome[k], gen.num_variables, gen.variable_buffer, gen.variable_hash, *gen.pool, gen.lineage, r);
+    pop.fitness[k] = gen.variable_fitness[v];
+    if (gen.num_objectives)
+        compute_objectives(gen, pop, k, 0);
+    update_best(gen.best_key, gen.worst_fitness, pop.fitness[k], k);
+}
+//---------------------------------------------------------------------------
+template <typename t_problem>
+t_tgp_chromosome<typename t_problem::t_value>& get_parent(t_generation<t_problem> &gen, int p, t_tgp_chromosome<typename t_problem::t_value> &copy, int &parent_fitness)
+// in place, the parent is copied (its values and its node are shared) under the lock of its slot, since other
+// steps may replace it meanwhile; the caller releases the copy
+{
+    t_tgp_population<typename t_problem::t_value> &pop = *gen.current_pop;
+    if (!gen.slots){
+        parent_fitness = pop.fitness[p];
+        return pop.chromosome[p];
+    }
+    lock_slot(*gen.slots, p);
+    copy_chromosome(copy, pop.chromosome[p], *gen.pool);
+    parent_fitness = pop.fitness[p];
+    unlock_slot(*gen.slots, p);
+    return copy;
+}
+//---------------------------------------------------------------------------
+template <typename t_problem>
+bool make_offspring(t_generation<t_problem> &gen, int k, t_tgp_chromosome<typename t_problem::t_value> &child, int &child_fitness, int &child_depth, t_random &r,
+                    t_offspring_telemetry *telemetry, t_phase_clock &clock, t_tgp_chromosome<typename t_problem::t_value> *parent_copy)
+// builds the kth chromosome of the new population; returns false if it is a copy of a parent.
+// child_depth is only computed with several objectives; parent_copy holds the 2 parents read in place (see get_parent)
+{
+    typedef typename t_problem::t_value t_value;
+    t_gp_parameters &parameters = *gen.parameters;
+    t_tgp_population<t_value> &current_pop = *gen.current_pop;
+    t_value_pool<t_value> &pool = *gen.pool;
+    size_t size = (size_t)gen.num_values * sizeof(t_value);
+
+    double p = random_double(r);
+
+    if (p < parameters.insertion_probability){  // insertion of a simple program (made from a single variable)
+        int v = init_chromosome(child, gen.num_variables, gen.variable_buffer, gen.variable_hash, pool, gen.lineage, r);
+        child_fitness = gen.variable_fitness[v];
+        child_depth = 0;
+        end_phase(clock, PhaseCopy);
+        return true;
+    }
+    // recombination of 2 programs
+    // first I have to choose an operator
+    int f = random_int(r, gen.num_functions);
+    int op = gen.function[f];
+    // multiobjective runs select by crowded tournament (see select_survivors)
+    const int *selection = gen.num_objectives ? current_pop.selection_rank : current_pop.fitness;
+    int tournament_size = gen.num_objectives ? MultiobjectiveTournamentSize : 1;
+    int p1 = tournament_selection(selection, parameters.pop_size, tournament_size, r);
+    int p2 = tournament_selection(selection, parameters.pop_size, tournament_size, r);
+    double ps = random_double(r);
+    int fitness1, fitness2;
+    t_tgp_chromosome<t_value> &a = get_parent(gen, p1, parent_copy[0], fitness1);
+    end_phase(clock, PhaseSelection);
+    int depth1 = 0, depth2 = 0;
+    if (gen.num_objectives){
+        depth1 = current_pop.objectives[(p1 + 1) * gen.num_objectives - 1];
+        depth2 = current_pop.objectives[(p2 + 1) * gen.num_objectives - 1];
+    }
+    child_depth = depth1;
+    if (ps > parameters.crossover_probability){
+        // copy one of the parents to the new population
+        copy_chromosome(child, a, pool);
+        child_fitness = fitness1;
+        end_phase(clock, PhaseCopy);
+        return false;
+    }
+
+    t_tgp_chromosome<t_value> &b = get_parent(gen, p2, parent_copy[1], fitness2);
+    uint64_t key = 0, hash;
+    bool known = gen.cache && find_semantic(*gen.cache, key = semantic_key(op, a.hash, t_problem::unary(op) ? 0 : b.hash, t_problem::commutative(op)), hash, child_fitness);
+    bool hopeless = known && gen.max_errors >= 0 && child_fitness > gen.max_errors;
+    if (known && !hopeless){
+        make_writable(child, pool);
+        t_problem::kernels().apply_operator[op](a.value, b.value, child.value, gen.num_values);
+        child.hash = hash;
+        if (hash == a.hash || hash == b.hash){
+            // the values may be those of a parent (a - 0, or a AND a, for instance), whose buffer is then shared; the
+            // program is still a new one. the values are compared, since different values may have the same hash
+            t_tgp_chromosome<t_value> &parent = hash == a.hash ? a : b;
+            if (same_values(child.value, parent.value, size, gen.last_mask))
+                share_buffer(child, pool, parent.buffer);
+            else
+                known = false;
+        }
+        end_phase(clock, PhaseOperators);
+    }
+    if (!known){
+        make_writable(child, pool);
+        child_fitness = t_problem::evaluate(gen, op, a.value, b.value, child.value, gen.cache ? &child.hash : NULL, clock);
+        hopeless = gen.max_errors >= 0 && child_fitness > gen.max_errors;
+        if (gen.cache && !hopeless) // the count of a hopeless child is not complete
+            store_semantic(*gen.cache, key, child.hash, child_fitness);
+        end_phase(clock, PhaseFitness);
+    }
+    if (telemetry){
+        telemetry->op = f;
+        telemetry->evaluated = !known;
+        telemetry->improved = child_fitness < fitness1 && child_fitness < fitness2;
+    }
+    if (hopeless){
+        // hopeless child: keep its first parent instead
+        copy_chromosome(child, a, pool);
+        child_fitness = fitness1;
+        end_phase(clock, PhaseCopy);
+        return false;
+    }
+    child_depth = (depth1 > depth2 || t_problem::unary(op) ? depth1 : depth2) + 1;
+    if (gen.lineage){
+        // the child is not seen by the other offspring before it is built, so the next attempt writes the same
+        // node if it is rejected; in place, the nodes are taken in the order the offspring are built
+        int node = gen.slots ? gen.next_node++ : gen.first_node + k;
+        child.node = set_node(*gen.lineage, node, op, a.node, b.node);
+        end_phase(clock, PhaseLineage);
+    }
+    return true;
+}
+//---------------------------------------------------------------------------
+template <typename t_problem>
+bool is_present(t_generation<t_problem> &gen, t_tgp_chromosome<typename t_problem::t_value> &c)
+// whether the values of c are those of an individual of the current population (in place, of the individual
+// that had the same hash when the generation started, if it is still there)
+{
+    int i = find_hash(*gen.present, c.hash);
+    if (i < 0)
+        return false;
+    if (gen.slots)
+        lock_slot(*gen.slots, i);
+    t_tgp_chromosome<typename t_problem::t_value> &other = gen.current_pop->chromosome[i];
+    bool present = other.hash == c.hash && same_values(other.value, c.value, (size_t)gen.num_values * sizeof(typename t_problem::t_value), gen.last_mask);
+    if (gen.slots)
+        unlock_slot(*gen.slots, i);
+    return present;
+}
+//---------------------------------------------------------------------------
+template <typename t_problem>
+void build_offspring(t_generation<t_problem> &gen, int k, t_tgp_chromosome<typename t_problem::t_value> &child, int &child_fitness, int &child_depth, t_random &r,
+                     t_tgp_chromosome<typename t_problem::t_value> *parent_copy)
+// the kth offspring of the generation
+{
+    t_offspring_telemetry *telemetry = gen.telemetry ? &gen.telemetry[k] : NULL;
+    t_phase_clock clock;
+    start_phases(clock, telemetry ? telemetry->ticks : NULL);
+
+    for (int attempt = 0; ; attempt++){
+        bool built = make_offspring(gen, k, child, child_fitness, child_depth, r, telemetry, clock, parent_copy);
+        // copies are duplicates by design; the other offspring are built again if their values are already present
+        if (!built || !gen.present || attempt == MaxDuplicateRetries || !is_present(gen, child))
+            break;
+    }
+}
+//---------------------------------------------------------------------------
+template <typename t_problem>
+void offspring_task(int k, void *context)
+// builds the kth chromosome of the new population
+{
+    t_generation<t_problem> &gen = *(t_generation<t_problem>*)context;
+    t_random r;
+    init_random(r, gen.parameters->seed, gen.generation, k);
+    t_tgp_chromosome<typename t_problem::t_value> parent_copy[2]; // not used: the current population does not change
+    int child_depth;
+    build_offspring(gen, k, gen.new_pop->chromosome[k], gen.new_pop->fitness[k], child_depth, r, parent_copy);
+    if (gen.num_objectives)
+        compute_objectives(gen, *gen.new_pop, k, child_depth);
+    update_best(gen.best_key, gen.worst_fitness, gen.new_pop->fitness[k], k);
+}
+//---------------------------------------------------------------------------
+template <typename t_problem>
+void in_place_task(int k, void *context)
+// step k of a generation in place: the offspring replaces the loser of a tournament of 2 (never the best)
+{
+    t_generation<t_problem> &gen = *(t_generation<t_problem>*)context;
+    t_tgp_population<typename t_problem::t_value> &pop = *gen.current_pop;
+    t_random r;
+    init_random(r, gen.parameters->seed, gen.generation, k);
+    t_tgp_chromosome<typename t_problem::t_value> child, parent_copy[2];
+    child.buffer = parent_copy[0].buffer = parent_copy[1].buffer = -1;
+    child.node = parent_copy[0].node = parent_copy[1].node = -1;
+    int child_fitness, child_depth;
+    build_offspring(gen, k, child, child_fitness, child_depth, r, parent_copy);
+
+    int i = random_int(r, gen.parameters->pop_size), j = random_int(r, gen.parameters->pop_size);
+    lock_slots(*gen.slots, i, j);
+    int loser = tournament_loser(pop.fitness, i, j, (int)(gen.best_key & 0xFFFFFFFF));
+    if (loser >= 0){
+        std::swap(pop.chromosome[loser], child); // the replaced individual is released with child
+        pop.fitness[loser] = child_fitness;
+        update_best(gen.best_key, gen.worst_fitness, child_fitness, loser);
+    }
+    unlock_slots(*gen.slots, i, j);
+
+    release_chromosome(parent_copy[0], *gen.pool);
+    release_chromosome(parent_copy[1], *gen.pool);
+    release_chromosome(child, *gen.pool);
+}
+//---------------------------------------------------------------------------
+inline bool is_neighbour(int from, int to, t_gp_parameters &parameters)
+{
+    if (from == to)
+        return false;
+    if (parameters.migration_topology == MigrationAllToAll)
+        return true;
+    return to == (from + 1) % parameters.num_islands;
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void release_migrant(t_gp_run<t_value> &run, t_migrant &m)
+{
+    release_buffer(run.pool, m.buffer);
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void send_migrants(t_tgp_population<t_value> &pop, int *index, t_gp_parameters &parameters, t_gp_run<t_value> &run, int island)
+// the best num_migrants individuals are sent; migrants which do not fit in a full queue are dropped
+// index is a work array of pop_size elements
+{
+    int num_migrants = parameters.num_migrants < parameters.pop_size ? parameters.num_migrants : parameters.pop_size;
+    if (num_migrants == 1)
+        index[0] = pop.best;
+    else
+        select_best(pop, parameters.pop_size, num_migrants, index);
+    for (int to = 0; to < parameters.num_islands; to++)
+        if (is_neighbour(island, to, parameters))
+            for (int i = 0; i < num_migrants; i++){
+                t_migrant m;
+                m.buffer = pop.chromosome[index[i]].buffer;
+                m.node = pop.chromosome[index[i]].node;
+                m.fitness = pop.fitness[index[i]];
+                m.hash = pop.chromosome[index[i]].hash;
+                run.pool.ref_count[m.buffer]++;
+                if (!push_migrant(run.queues[island * parameters.num_islands + to], m)){
+                    release_migrant(run, m);
+                    break;
+                }
+            }
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+int receive_migrants(t_tgp_population<t_value> &pop, int *index, t_migrant *arrived, t_gp_parameters &parameters, t_gp_run<t_value> &run, int island)
+// the migrants replace the worst individuals of pop; the best one is never replaced
+// index is a work array of pop_size elements; arrived has room for the content of all incoming queues
+{
+    int num_received = 0;
+    for (int from = 0; from < parameters.num_islands; from++)
+        if (is_neighbour(from, island, parameters)){
+            t_migration_queue<t_migrant> &q = run.queues[from * parameters.num_islands + island];
+            for (unsigned int i = 0; i < q.capacity && pop_migrant(q, arrived[num_received]); i++)
+                num_received++;
+        }
+    if (!num_received)
+        return 0;
+
+    int num_replaced = num_received < parameters.pop_size - 1 ? num_received : parameters.pop_size - 1;
+    for (int i = 0; i < parameters.pop_size; i++)
+        index[i] = i;
+    std::swap(index[pop.best], index[parameters.pop_size - 1]); // keep the best out of the selection
+    t_reverse_rank_compare compare = { pop.fitness };
+    std::partial_sort(index, index + num_replaced, index + parameters.pop_size - 1, compare);
+    for (int i = 0; i < num_replaced; i++){
+        t_tgp_chromosome<t_value> &c = pop.chromosome[index[i]];
+        release_buffer(run.pool, c.buffer);
+        c.buffer = arrived[i].buffer;
+        c.value = run.pool.buffer[arrived[i].buffer];
+        c.node = arrived[i].node;
+        pop.fitness[index[i]] = arrived[i].fitness;
+        c.hash = arrived[i].hash;
+    }
+    for (int i = num_replaced; i < num_received; i++)
+        release_migrant(run, arrived[i]);
+    find_best(pop, parameters.pop_size);
+    return num_received;
+}
+//---------------------------------------------------------------------------
+// multiobjective selection
+// the offspring and the current population compete together: they are sorted in Pareto fronts, then by
+// crowding distance within a front, and the first pop_size survive; the individual with the fewest errors
+// always survives. parents are chosen by tournaments in this order
+//---------------------------------------------------------------------------
+template <typename t_value>
+void allocate_multiobjective(t_multiobjective &mo, t_tgp_population<t_value> &current_pop, t_tgp_population<t_value> &new_pop, int pop_size, int num_objectives)
+{
+    mo.num_objectives = num_objectives;
+    mo.objectives = new int[2 * pop_size * mo.num_objectives];
+    mo.fitness = new int[2 * pop_size];
+    mo.front = new int[2 * pop_size];
+    mo.distance = new double[2 * pop_size];
+    mo.order = new int[2 * pop_size];
+    mo.slot = new int[2 * pop_size];
+    mo.front_size = 0;
+    current_pop.objectives = new int[pop_size * mo.num_objectives];
+    current_pop.selection_rank = new int[pop_size];
+    new_pop.objectives = new int[pop_size * mo.num_objectives];
+    new_pop.selection_rank = new int[pop_size];
+}
+//---------------------------------------------------------------------------
+inline void delete_multiobjective(t_multiobjective &mo)
+{
+    delete[] mo.objectives;
+    delete[] mo.fitness;
+    delete[] mo.front;
+    delete[] mo.distance;
+    delete[] mo.order;
+    delete[] mo.slot;
+}
+//---------------------------------------------------------------------------
+inline void crowded_order(t_multiobjective &mo, const int *objectives, const int *fitness, int n)
+// mo.order = the n individuals in crowded order, except that the one with the fewest errors (the
+// first one in the lowest front) comes first, so that it always survives
+{
+    non_dominated_sort(objectives, n, mo.num_objectives, mo.front);
+    crowding_distance(objectives, mo.front, n, mo.num_objectives, mo.distance);
+    int elite = 0;
+    for (int i = 1; i < n; i++)
+        if (fitness[i] < fitness[elite] || (fitness[i] == fitness[elite] && mo.front[i] < mo.front[elite]))
+            elite = i;
+    for (int i = 0; i < n; i++)
+        mo.order[i] = i;
+    t_crowded_compare compare = { mo.front, mo.distance };
+    std::sort(mo.order, mo.order + n, compare);
+    int *position = std::find(mo.order, mo.order + n, elite);
+    std::rotate(mo.order, position, position + 1);
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void rank_population(t_multiobjective &mo, t_tgp_population<t_value> &pop, int pop_size)
+// after the objectives of the whole population have changed (initial population, new data)
+{
+    crowded_order(mo, pop.objectives, pop.fitness, pop_size);
+    mo.front_size = 0;
+    for (int i = 0; i < pop_size; i++){
+        pop.selection_rank[mo.order[i]] = i;
+        mo.front_size += mo.front[i] == 0;
+    }
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void select_survivors(t_multiobjective &mo, t_tgp_population<t_value> &current_pop, t_tgp_population<t_value> &new_pop, int pop_size)
+// the first pop_size individuals of both populations, in crowded order, are moved into new_pop;
+// the others are left in current_pop, which is overwritten by the next generation
+{
+    int m = mo.num_objectives;
+    memcpy(mo.objectives, current_pop.objectives, pop_size * m * sizeof(int));
+    memcpy(mo.objectives + pop_size * m, new_pop.objectives, pop_size * m * sizeof(int));
+    memcpy(mo.fitness, current_pop.fitness, pop_size * sizeof(int));
+    memcpy(mo.fitness + pop_size, new_pop.fitness, pop_size * sizeof(int));
+    crowded_order(mo, mo.objectives, mo.fitness, 2 * pop_size);
+
+    // the individuals are numbered 0 .. pop_size - 1 in current_pop, pop_size .. 2 pop_size - 1 in new_pop
+    for (int i = 0; i < 2 * pop_size; i++)
+        mo.slot[i] = -1;
+    mo.front_size = 0;
+    for (int p = 0; p < pop_size; p++){
+        mo.slot[mo.order[p]] = 0;
+        mo.front_size += mo.front[mo.order[p]] == 0;
+    }
+    // each survivor of current_pop takes the place of an offspring which does not survive
+    int free_slot = 0;
+    for (int i = 0; i < pop_size; i++)
+        if (mo.slot[i] >= 0){
+            while (mo.slot[pop_size + free_slot] >= 0)
+                free_slot++;
+            std::swap(current_pop.chromosome[i], new_pop.chromosome[free_slot]);
+            std::swap_ranges(current_pop.objectives + i * m, current_pop.objectives + (i + 1) * m, new_pop.objectives + free_slot * m);
+            std::swap(current_pop.fitness[i], new_pop.fitness[free_slot]);
+            mo.slot[i] = free_slot++;
+        }
+    for (int p = 0; p < pop_size; p++){
+        int u = mo.order[p];
+        new_pop.selection_rank[u < pop_size ? mo.slot[u] : u - pop_size] = p;
+    }
+    find_best(new_pop, pop_size);
+}
+//---------------------------------------------------------------------------
+// islands
+//---------------------------------------------------------------------------
+template <typename t_problem>
+void start_island(t_island<t_problem> &island, typename t_problem::t_parameters &parameters, typename t_problem::t_run &run, int index)
+// the memory of the island; the problem sets the data of its generations in begin_island
+{
+    island.parameters = &parameters;
+    island.run = &run;
+    island.index = index;
+    alocate_population(island.current_pop, parameters.pop_size);
+    if (!parameters.in_place)
+        alocate_population(island.new_pop, parameters.pop_size);
+    if (parameters.in_place)
+        allocate_slot_locks(island.slots, parameters.pop_size);
+    start_thread_pool(island.threads, parameters.num_threads);
+    island.index_work = new int[parameters.pop_size];
+    island.arrived = new t_migrant[parameters.num_islands * run.queue_capacity];
+    start_island_telemetry(island.telemetry, run.telemetry, index, parameters.pop_size);
+    if (parameters.semantic_cache)
+        allocate_semantic_cache(island.cache, 16 * parameters.pop_size);
+    if (parameters.reject_duplicates)
+        allocate_hash_set(island.present, parameters.pop_size);
+
+    t_generation<t_problem> &gen = island.gen;
+    gen.parameters = &parameters;
+    gen.run = &run;
+    gen.current_pop = &island.current_pop;
+    gen.new_pop = &island.new_pop;
+    gen.pool = &run.pool;
+    gen.lineage = run.lineage;
+    gen.variable_buffer = run.variable_buffer;
+    gen.variable_fitness = run.variable_fitness;
+    gen.variable_hash = run.variable_hash;
+    gen.num_variables = run.num_variables;
+    gen.target = NULL;
+    gen.num_data = gen.num_values = 0;
+    gen.last_mask = ~(uint64_t)0;
+    gen.max_errors = -1;
+    gen.num_functions = t_problem::kernels().num_operators;
+    for (int op = 0; op < gen.num_functions; op++)
+        gen.function[op] = op;
+    gen.telemetry = island.telemetry.offspring;
+    gen.cache = parameters.semantic_cache ? &island.cache : NULL;
+    gen.present = parameters.reject_duplicates ? &island.present : NULL;
+    gen.slots = parameters.in_place ? &island.slots : NULL;
+    gen.num_objectives = t_problem::num_objectives(parameters, run);
+    if (gen.num_objectives)
+        allocate_multiobjective(island.mo, island.current_pop, island.new_pop, parameters.pop_size, gen.num_objectives);
+}
+//---------------------------------------------------------------------------
+template <typename t_problem>
+void stop_island(t_island<t_problem> &island)
+{
+    typename t_problem::t_parameters &parameters = *island.parameters;
+    t_value_pool<typename t_problem::t_value> &pool = island.run->pool;
+    if (island.gen.num_objectives)
+        delete_multiobjective(island.mo);
+    stop_island_telemetry(island.telemetry);
+    if (parameters.semantic_cache)
+        delete_semantic_cache(island.cache);
+    if (parameters.reject_duplicates)
+        delete_hash_set(island.present);
+    stop_thread_pool(island.threads);
+    delete[] island.index_work;
+    delete[] island.arrived;
+    free_pop_memory(island.current_pop, parameters.pop_size, pool);
+    if (parameters.in_place)
+        delete_slot_locks(island.slots);
+    else
+        free_pop_memory(island.new_pop, parameters.pop_size, pool);
+}
+//---------------------------------------------------------------------------
+template <typename t_problem>
+void init_population(t_island<t_problem> &island)
+// each individual of the first population is a variable
+{
+    t_generation<t_problem> &gen = island.gen;
+    t_tgp_population<typename t_problem::t_value> &pop = island.current_pop;
+    int pop_size = island.parameters->pop_size;
+    gen.best_key = UINT64_MAX;
+    gen.worst_fitness = -1;
+    parallel_for(island.threads, 0, pop_size, init_task<t_problem>, &gen);
+    pop.best = (int)(gen.best_key & 0xFFFFFFFF);
+    pop.worst_fitness = gen.worst_fitness;
+    if (gen.num_objectives)
+        rank_population(island.mo, pop, pop_size);
+}
+//---------------------------------------------------------------------------
+template <typename t_problem>
+int evolve(typename t_problem::t_parameters &parameters, typename t_problem::t_run &run, int index)
+// evolves one population; returns the fitness of its best individual
+{
+    t_island<t_problem> island;
+    start_island(island, parameters, run, index);
+    t_tgp_population<typename t_problem::t_value> &current_pop = island.current_pop, &new_pop = island.new_pop;
+    t_generation<t_problem> &gen = island.gen;
+    t_phase_clock &clock = island.clock;
+    int last_generation = t_problem::begin_island(island);
+
+    for (int g = last_generation + 1; g < parameters.num_generations; g++){
+        begin_generation_telemetry(island.telemetry, g);
+        start_phases(clock, island.telemetry.offspring ? island.telemetry.island_ticks : NULL);
+        if (!t_problem::begin_generation(island, g))
+            break;
+        if (parameters.num_islands > 1 && parameters.pop_size > 1 && g % parameters.migration_interval == 0){
+            send_migrants(current_pop, island.index_work, parameters, run, index);
+            receive_migrants(current_pop, island.index_work, island.arrived, parameters, run, index);
+            end_phase(clock, PhaseMigration);
+        }
+
+        // elitism: copy best to the new population (multiobjective runs keep it when selecting the survivors,
+        // runs in place never replace it)
+        if (!gen.num_objectives && !parameters.in_place){
+            copy_chromosome(new_pop.chromosome[0], current_pop.chromosome[current_pop.best], run.pool);
+            new_pop.fitness[0] = current_pop.fitness[current_pop.best];
+            end_phase(clock, PhaseCopy);
+        }
+
+        gen.max_errors = t_problem::max_errors(island);
+        if (parameters.print_interval > 0 && g % parameters.print_interval == 0)
+            t_problem::print_generation(island, g);
+
+        if (gen.present){
+            clear_hash_set(island.present);
+            for (int i = 0; i < parameters.pop_size; i++)
+                insert_hash(island.present, current_pop.chromosome[i].hash, i);
+        }
+
+        gen.generation = g;
+        if (gen.lineage){
+            // in place, each attempt of an offspring has its own node
+            int num_attempts = parameters.in_place && parameters.reject_duplicates ? MaxDuplicateRetries + 1 : 1;
+            gen.next_node = gen.first_node = reserve_nodes(*gen.lineage, num_attempts * parameters.pop_size);
+        }
+        if (parameters.in_place){
+            gen.best_key = rank_key(current_pop.fitness[current_pop.best], current_pop.best);
+            gen.worst_fitness = current_pop.worst_fitness;
+            parallel_for(island.threads, 1, parameters.pop_size, in_place_task<t_problem>, &gen);
+            find_best(current_pop, parameters.pop_size); // the same best as gen.best_key; the worst may be better
+        }
+        else if (gen.num_objectives){
+            gen.best_key = UINT64_MAX;
+            gen.worst_fitness = -1;
+            parallel_for(island.threads, 0, parameters.pop_size, offspring_task<t_problem>, &gen);
+            start_phases(clock, clock.ticks);
+            select_survivors(island.mo, current_pop, new_pop, parameters.pop_size);
+            end_phase(clock, PhaseSelection);
+        }
+        else{
+            gen.best_key = rank_key(new_pop.fitness[0], 0);
+            gen.worst_fitness = new_pop.fitness[0];
+            parallel_for(island.threads, 1, parameters.pop_size, offspring_task<t_problem>, &gen);
+            new_pop.best = (int)(gen.best_key & 0xFFFFFFFF);
+            new_pop.worst_fitness = gen.worst_fitness;
+        }
+
+        // the new population becomes the current one; the old current population is overwritten in the next generation
+        if (!parameters.in_place)
+            std::swap(current_pop, new_pop);
+        last_generation = g;
+
+        start_phases(clock, clock.ticks); // the offspring have timed their own phases
+        t_problem::end_generation(island, g);
+        end_generation_telemetry(island.telemetry, current_pop.fitness);
+    }
+
+    int best_fitness = current_pop.fitness[current_pop.best];
+    t_problem::end_island(island, last_generation);
+    stop_island(island);
+    return best_fitness;
+}
+//---------------------------------------------------------------------------
+template <typename t_problem>
+void island_thread(typename t_problem::t_parameters *parameters, typename t_problem::t_run *run, int island)
+{
+    typename t_problem::t_parameters island_parameters = *parameters;
+    // each island has its own random numbers; island 0 behaves like a single population
+    island_parameters.seed = parameters->seed + island * 0x9E3779B9u;
+    island_parameters.num_threads = parameters->num_threads / parameters->num_islands;
+    run->best_fitness[island] = evolve<t_problem>(island_parameters, *run, island);
+}
+//---------------------------------------------------------------------------
+// runs
+//---------------------------------------------------------------------------
+template <typename t_value>
+void start_gp_run(t_gp_parameters &parameters, t_gp_run<t_value> &run, t_value **columns, int num_variables, int num_values)
+// the queues between the islands, the pool of values and the buffers of the variables, whose columns have
+// num_values values; the problem computes the fitness and the hash of the variables
+{
+    run.num_variables = num_variables;
+    int num_islands = parameters.num_islands > 1 ? parameters.num_islands : 1;
+    unsigned int queue_capacity = run.queue_capacity = 2 * parameters.num_migrants;
+    int num_queues = 0;
+    run.queues = new t_migration_queue<t_migrant>[num_islands * num_islands];
+    for (int from = 0; from < num_islands; from++)
+        for (int to = 0; to < num_islands; to++){
+            t_migration_queue<t_migrant> &q = run.queues[from * num_islands + to];
+            q.capacity = queue_capacity;
+            q.migrants = new t_migrant[queue_capacity];
+            q.head = 0;
+            q.tail = 0;
+            if (is_neighbour(from, to, parameters))
+                num_queues++;
+        }
+    run.best_fitness = new int[num_islands];
+
+    // each chromosome of the 2 populations of each island uses at most one buffer; migrants waiting in queues use one too.
+    // in place, a thread also holds its offspring and 2 parents which may have been replaced meanwhile
+    int island_threads = parameters.num_threads / num_islands > 1 ? parameters.num_threads / num_islands : 1;
+    int island_buffers = parameters.in_place ? parameters.pop_size + 3 * island_threads : 2 * parameters.pop_size;
+    allocate_value_pool(run.pool, island_buffers * num_islands + num_queues * queue_capacity, num_variables, num_values);
+    init_variable_buffers(run.variable_buffer, run.pool, num_variables, columns);
+    run.variable_fitness = new int[num_variables];
+    run.variable_hash = new uint64_t[num_variables];
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void stop_gp_run(t_gp_parameters &parameters, t_gp_run<t_value> &run)
+{
+    int num_islands = parameters.num_islands > 1 ? parameters.num_islands : 1;
+    for (int i = 0; i < num_islands * num_islands; i++)
+        delete[] run.queues[i].migrants;
+    delete[] run.queues;
+    delete[] run.best_fitness;
+    delete[] run.variable_buffer;
+    delete[] run.variable_fitness;
+    delete[] run.variable_hash;
+    delete_value_pool(run.pool);
+}
+//---------------------------------------------------------------------------
+template <typename t_problem>
+int run_islands(typename t_problem::t_parameters &parameters, typename t_problem::t_run &run)
+// evolves the islands concurrently, island 0 on the calling thread; returns the best island
+{
+    int num_islands = parameters.num_islands > 1 ? parameters.num_islands : 1;
+    int best = 0;
+    if (num_islands == 1)
+        island_thread<t_problem>(&parameters, &run, 0);
+    else{
+        std::thread *islands = new std::thread[num_islands - 1];
+        for (int i = 1; i < num_islands; i++)
+            islands[i - 1] = std::thread(island_thread<t_problem>, &parameters, &run, i);
+        island_thread<t_problem>(&parameters, &run, 0);
+        for (int i = 1; i < num_islands; i++)
+            islands[i - 1].join();
+        delete[] islands;
+
+        for (int i = 1; i < num_islands; i++)
+            if (run.best_fitness[i] < run.best_fitness[best])
+                best = i;
+    }
+    return best;
+}
+//---------------------------------------------------------------------------
+// benchmarks
+// a measure calls a function in batches of doubling size until it has run for a minimal time, after a
+// first call which warms up the caches; it reports the time of one call. the results are written as
+// JSON (one object per measure, with its parameters), so they can be compared across versions
+//---------------------------------------------------------------------------
+typedef void (*t_benchmark_function)(void *context);
+
+struct t_benchmark_report{
+    FILE *f;
+    double min_seconds;          // minimal duration of a measure
+    int num_results;
+};
+//---------------------------------------------------------------------------
+inline double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+//---------------------------------------------------------------------------
+inline double time_per_call(t_benchmark_function function, void *context, double min_seconds)
+{
+    function(context);
+    double num_calls = 0, seconds;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (long long batch = 1; ; batch *= 2){
+        for (long long i = 0; i < batch; i++)
+            function(context);
+        num_calls += batch;
+        if ((seconds = seconds_since(start)) >= min_seconds)
+            return seconds / num_calls;
+    }
+}
+//---------------------------------------------------------------------------
+inline void begin_benchmark_report(t_benchmark_report &report, FILE *f, double min_seconds, const char *program, const char *kernels_name, int num_threads)
+{
+    report.f = f;
+    report.min_seconds = min_seconds;
+    report.num_results = 0;
+    char date[32];
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    fprintf(f, "{\n  \"program\": \"%s\",\n  \"date\": \"%s\",\n  \"kernels\": \"%s\",\n  \"threads\": %d,\n  \"results\": [",
+            program, date, kernels_name, num_threads);
+}
+//---------------------------------------------------------------------------
+inline void add_benchmark_result(t_benchmark_report &report, const char *name, const char *parameters, double seconds, double num_items, const char *unit)
+// parameters: JSON members describing the measure, for example "\"n\": 1024"; one call processes num_items units.
+// the result is also printed on stderr, to follow the progress
+{
+    fprintf(report.f, "%s\n    {\"name\": \"%s\", %s%s\"seconds\": %.6g, \"%s_per_second\": %.6g}",
+            report.num_results++ ? "," : "", name, parameters, *parameters ? ", " : "", seconds, unit, num_items / seconds);
+    fflush(report.f);
+    fprintf(stderr, "%s {%s}: %.4g %s per second\n", name, parameters, num_items / seconds, unit);
+}
+//---------------------------------------------------------------------------
+inline void measure(t_benchmark_report &report, const char *name, const char *parameters, t_benchmark_function function, void *context, double num_items, const char *unit)
+{
+    add_benchmark_result(report, name, parameters, time_per_call(function, context, report.min_seconds), num_items, unit);
+}
+//---------------------------------------------------------------------------
+inline void end_benchmark_report(t_benchmark_report &report)
+{
+    fprintf(report.f, "\n  ]\n}\n");
+    fflush(report.f);
+}
+//---------------------------------------------------------------------------
+// the measures shared by the problems: the operations of the GP loop on populations with random fitness,
+// and the length of the runs
+//---------------------------------------------------------------------------
+#define BenchmarkDataFile "tgp_benchmark.tmp"   // written in the current directory, then removed
+#define NumSelections 1000                      // selections per call of the selection measure
+
+template <typename t_value>
+struct t_population_benchmark{
+    int pop_size;
+    t_value_pool<t_value> pool;
+    t_tgp_population<t_value> pop[2];
+    int *index;
+    int tournament_size;
+    int sum;                     // kept, so that the selections are not optimized away
+    t_random r;
+};
+//---------------------------------------------------------------------------
+template <typename t_value>
+void benchmark_copy(void *context)
+{
+    t_population_benchmark<t_value> &pb = *(t_population_benchmark<t_value>*)context;
+    for (int i = 0; i < pb.pop_size; i++)
+        copy_chromosome(pb.pop[1].chromosome[i], pb.pop[0].chromosome[i], pb.pool);
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void benchmark_selection(void *context)
+{
+    t_population_benchmark<t_value> &pb = *(t_population_benchmark<t_value>*)context;
+    int sum = 0;
+    for (int i = 0; i < NumSelections; i++)
+        sum += tournament_selection(pb.pop[0].fitness, pb.pop_size, pb.tournament_size, pb.r);
+    pb.sum = sum;
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void benchmark_select_best(void *context)
+{
+    t_population_benchmark<t_value> &pb = *(t_population_benchmark<t_value>*)context;
+    select_best(pb.pop[0], pb.pop_size, pb.pop_size / 10 + 1, pb.index);
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void benchmark_populations(t_benchmark_report &report, unsigned int seed)
+// copies, selection of the best individuals and tournaments, for populations of 100, 1000 and 10000
+{
+    t_population_benchmark<t_value> pb;
+    char description[256];
+    int pop_sizes[] = { 100, 1000, 10000 };
+    for (int i = 0; i < 3; i++){
+        pb.pop_size = pop_sizes[i];
+        allocate_value_pool(pb.pool, 2 * pop_sizes[i], 0, 1);
+        pb.index = new int[pop_sizes[i]];
+        init_random(pb.r, seed, 0, 0);
+        for (int k = 0; k < 2; k++)
+            alocate_population(pb.pop[k], pop_sizes[i]);
+        for (int k = 0; k < pop_sizes[i]; k++){
+            make_writable(pb.pop[0].chromosome[k], pb.pool);
+            pb.pop[0].fitness[k] = random_int(pb.r, 1 << 16);
+        }
+        snprintf(description, sizeof(description), "\"pop_size\": %d", pop_sizes[i]);
+        measure(report, "copy_chromosome", description, benchmark_copy<t_value>, &pb, pop_sizes[i], "copies");
+        measure(report, "select_best", description, benchmark_select_best<t_value>, &pb, 1, "selections");
+        for (pb.tournament_size = 1; pb.tournament_size <= 4; pb.tournament_size *= 4){
+            snprintf(description, sizeof(description), "\"pop_size\": %d, \"tournament_size\": %d", pop_sizes[i], pb.tournament_size);
+            measure(report, "tournament_selection", description, benchmark_selection<t_value>, &pb, NumSelections, "selections");
+        }
+        for (int k = 0; k < 2; k++)
+            free_pop_memory(pb.pop[k], pop_sizes[i], pb.pool);
+        delete[] pb.index;
+        delete_value_pool(pb.pool);
+    }
+}
+//---------------------------------------------------------------------------
+inline int benchmark_generations(double work)
+// the number of generations of a measured run, whose generations cost work (pop_size * values): the run is short
+{
+    return work * 1000 < 5e7 ? 1000 : (work * 5 > 5e7 ? 5 : (int)(5e7 / work));
+}
+//---------------------------------------------------------------------------
+#endif
@@ -43,304 +43,3903 @@
 #include <math.h>
 #include <string.h>
 #include <float.h>
+#include <stdint.h>
+#include <limits.h>
 
-#define NumberOfOperators 4
+#include <algorithm>
+#include <limits>
+#include <chrono>
 
-// + -1
-// - -2
-// * -3
-// / -4
+#include "tgp_engine.h"
 //---------------------------------------------------------------------------
-struct t_tgp_chromosome{
-    double *value;  // value of the current program for kth data (training, validation or test)
+struct t_tgp_parameters : t_gp_parameters{
+    // the parameters of the GP loop (see tgp_engine.h), then those of the classification
 
-    int fitness;           //num incorrect classified
-} ;
+    // the operators which recombine programs: bit op is set if operator op of t_arithmetic_operators is used.
+    // the extended functions (protected division, sqrt, log, exp, sin, abs, min, max, if) are as cheap as +
+    // and never make Inf or NaN from finite values
+    unsigned int functions;
+
+    // early abort of hopeless offspring: evaluation stops as soon as a child is known to have more
+    // incorrectly classified data than the threshold, and the child is replaced by its first parent
+    int max_errors;              // user cutoff; -1 means no cutoff
+    bool abort_above_worst;      // also use the fitness of the worst individual of the current population as threshold
+
+    // the values of the programs are doubles, floats or fixed point numbers; floats and fixed point numbers
+    // halve or quarter the memory traffic and double or quadruple the SIMD lanes, but change the results
+    int value_type;              // ValueDouble, ValueFloat or ValueFixed
+    bool precision_report;       // at the end, the best individual is evaluated with double values in the range of its values too
+
+    // subset-sampled fitness, for data larger than the memory: the individuals are evaluated on a subset
+    // of subset_size training data, made of chunks of subset_chunk_size consecutive data.
+    // every subset_interval generations a new subset is read and all individuals are evaluated on it
+    // again, from their lineage; every full_evaluation_interval generations (a multiple of subset_interval)
+    // the best individual is evaluated on all training data.
+    // evaluating a program again replays its lineage, which grows with the number of generations:
+    // subset_interval should be large compared with the time needed to read a subset
+    int subset_size;             // 0 means that all training data are used
+    int subset_chunk_size;
+    int subset_interval;
+    int subset_selection;        // SubsetRandom or SubsetDynamic
+    int full_evaluation_interval; // 0 means only at the end of the run
+
+    // at the end, the best program is rebuilt from the lineage and saved, so it can classify new data
+    // without training again (see -predict); the lineage is recorded only if it is needed
+    const char *model_file;      // NULL means that no model is saved
+
+    // validation and test data are not seen by the evolution: the best individual is evaluated on them from
+    // its lineage, on the validation data every validation_interval generations (only if it changed), and on
+    // the test data once, at the end. with validation data, the program kept at the end (test fitness, model)
+    // is the best one on the validation data.
+    // the run stops early when the best training fitness reaches target_fitness, or when the best fitness
+    // (on the validation data if any, else on the training data) has not improved for patience generations;
+    // with subsets, the islands stop together at the next change of subset
+    int validation_interval;
+    int patience;                // 0 means no limit
+    int target_fitness;          // -1 means no target
+
+    // one-vs-rest decomposition for many classes: a binary population learns each class against all the
+    // others (the class is 1, the others 0). the populations of the classes run concurrently on a thread
+    // pool, with num_threads / (classes run at once) threads each, and share the training data; a data
+    // is classified by combining the outputs of the programs kept for the classes (see combine_outputs)
+    bool one_vs_rest;
+    int combination;             // OvrArgmax or OvrConfidence
+    const char *label;           // printed before the messages of a run started by a driver, e.g. "class = 2 " (NULL = none)
+
+    // checkpoints of a single population: every checkpoint_interval generations, the state of the run
+    // (current population, lineage of its programs, subset, early stopping) is copied and written to
+    // checkpoint_file by a background thread. a run started with resume_file continues from such a
+    // snapshot exactly as the interrupted run would have, if it has the same parameters (the seed, the
+    // data, the population size and the subsets are checked). the random numbers depend only on the seed
+    // and on the generation, so they need no state
+    const char *checkpoint_file; // NULL means no checkpoints
+    int checkpoint_interval;
+    const char *resume_file;     // NULL means a new run
+
+    // multiobjective runs minimize the errors on each class and the depth of the programs (a proxy of their
+    // size) instead of the total errors. the offspring and the current population compete together: they
+    // are sorted in Pareto fronts, then by crowding distance within a front, and the first pop_size survive
+    // (the individual with the fewest errors always survives). parents are chosen by tournaments in this
+    // order. the program kept at the end is still the one with the fewest errors, on the validation data if any
+    bool multiobjective;
+    // (with in_place, a generation is still pop_size - 1 offspring, so migration, subsets, validation and
+    // checkpoints happen between them; the semantic cache of an island is cleared when the subset changes)
+};
+#define MaxParetoPrinted 10      // distinct points of the final Pareto front which are printed
+#define OvrArgmax 0              // the class whose program gives the largest value
+#define OvrConfidence 1          // the most accurate program among those which claim the data, else argmax
+#define ValueDouble 0
+#define ValueFloat 1
+#define ValueFixed 2             // int16_t with FixedPointBits fractional bits
+#define FixedPointBits 8         // fixed point values are in -128 .. 128 - 1/256
+#define FixedPointOne (1 << FixedPointBits)
+#define SubsetRandom 0           // chunks are chosen uniformly
+#define SubsetDynamic 1          // chunks are chosen by difficulty and age (dynamic subset selection)
+
+// the phases timed by the telemetry: those of the GP loop (see tgp_engine.h), then the changes of subset and
+// the validation. the operator and the counting of errors run in one pass over the data, so they are a single phase
+#define PhaseSubset NumLoopPhases
+#define PhaseValidation (NumLoopPhases + 1)
+#define NumPhases (NumLoopPhases + 2)
+const char *const phase_names[NumPhases] = { "selection", "operator_and_fitness", "fitness", "copy", "migration", "lineage", "subset", "validation" };
+//---------------------------------------------------------------------------
+struct t_data_set{
+    // validation or test data, stored by columns like the training data
+    double **data;
+    int *target;
+    int num_data;                // 0 if there are no such data
+};
+//---------------------------------------------------------------------------
+template <typename t_value>
+void allocate_columns(t_value **&data, int num_training_data, int num_variables)
+// data is stored by columns: data[j] holds the values of variable j for all training data
+// all columns are in a single aligned block
+{
+    int stride = get_stride<t_value>(num_training_data);
+    data = new t_value*[num_variables + 1]; // data[0] holds the block even if there are no variables
+    data[0] = (t_value*)allocate_aligned((size_t)num_variables * stride * sizeof(t_value));
+    for (int j = 1; j < num_variables; j++)
+        data[j] = data[0] + (size_t)j * stride;
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void delete_columns(t_value **&data)
+{
+    if (data)
+        free_aligned(data[0]);
+    delete[] data;
+    data = NULL;
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void allocate_training_data(t_value **&data, int *&target, int num_training_data, int num_variables)
+{
+    target = new int[num_training_data];
+    allocate_columns(data, num_training_data, num_variables);
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void delete_data(t_value **&data, int *&target)
+{
+    delete_columns(data);
+    delete[] target;
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void convert_values(const double *source, t_value *values, int n)
+{
+    for (int i = 0; i < n; i++)
+        values[i] = (t_value)source[i];
+}
+//---------------------------------------------------------------------------
+void convert_values(const double *source, int16_t *values, int n)
+// to fixed point, rounded to the nearest and saturated
+{
+    for (int i = 0; i < n; i++){
+        double x = source[i] * FixedPointOne;
+        values[i] = x != x ? 0 : (x <= INT16_MIN ? INT16_MIN : (x >= INT16_MAX ? INT16_MAX : (int16_t)lrint(x)));
+    }
+}
+//---------------------------------------------------------------------------
+int count_outside_fixed_range(double **data, int num_data, int num_variables)
+// the number of values which are saturated when they are converted to fixed point
+{
+    int n = 0;
+    for (int j = 0; j < num_variables; j++)
+        for (int i = 0; i < num_data; i++){
+            double x = data[j][i] * FixedPointOne;
+            n += x <= INT16_MIN - 0.5 || x >= INT16_MAX + 0.5;
+        }
+    return n;
+}
+//---------------------------------------------------------------------------
+void warn_outside_fixed_range(const char *name, double **data, int num_data, int num_variables)
+{
+    int n = num_data ? count_outside_fixed_range(data, num_data, num_variables) : 0;
+    if (n)
+        printf("warning: %d values of the %s data are outside -128 .. 128 and are saturated in fixed point\n", n, name);
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+t_value** training_columns(double **)
+// the training data as values, when they need no conversion
+{
+    return NULL;
+}
+//---------------------------------------------------------------------------
+template <>
+double** training_columns<double>(double **data)
+{
+    return data;
+}
+//---------------------------------------------------------------------------
+// computational kernels (see tgp_engine.h)
+// the function set is + - * / and the extended functions below, for each type of values: double, float and
+// fixed point (int16_t); a run uses the subset of them given by t_tgp_parameters::functions.
+// the operators and the class decoding are the hot path of TGP, so they have AVX2 and AVX-512 versions.
+//---------------------------------------------------------------------------
+// fixed point values
+// int16_t with FixedPointBits fractional bits; + - * saturate, / is computed in float and truncated.
+// the SIMD versions perform exactly the same operations
+//---------------------------------------------------------------------------
+inline int16_t saturate16(int x)
+{
+    return (int16_t)(x < INT16_MIN ? INT16_MIN : (x > INT16_MAX ? INT16_MAX : x));
+}
+//---------------------------------------------------------------------------
+inline int16_t fixed_divide(int16_t a, int16_t b)
+// division by 0 saturates (0 / 0 = 0)
+{
+    float q = (float)a * (float)FixedPointOne / (float)b;
+    if (q != q)
+        q = 0;
+    q = q < (float)INT16_MIN ? (float)INT16_MIN : (q > (float)INT16_MAX ? (float)INT16_MAX : q);
+    return (int16_t)q;
+}
+//---------------------------------------------------------------------------
+#if TGP_X86_SIMD
+TGP_TARGET_AVX2 inline __m128i fixed_divide_avx2(__m128i a, __m128i b)
+// 8 values at once, in float
+{
+    __m256 x = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(a));
+    __m256 y = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(b));
+    __m256 q = _mm256_div_ps(_mm256_mul_ps(x, _mm256_set1_ps((float)FixedPointOne)), y);
+    q = _mm256_and_ps(q, _mm256_cmp_ps(q, q, _CMP_ORD_Q)); // 0 / 0 = 0
+    q = _mm256_min_ps(_mm256_max_ps(q, _mm256_set1_ps((float)INT16_MIN)), _mm256_set1_ps((float)INT16_MAX));
+    __m256i q32 = _mm256_cvttps_epi32(q);
+    return _mm_packs_epi32(_mm256_castsi256_si128(q32), _mm256_extracti128_si256(q32, 1));
+}
+#endif
+//---------------------------------------------------------------------------
+struct t_add{
+    template <typename t_value>
+    static t_value apply(t_value a, t_value b) { return a + b; }
+    static int16_t apply(int16_t a, int16_t b) { return saturate16(a + b); }
+#if TGP_X86_SIMD
+    TGP_TARGET_AVX2 static __m256d apply(__m256d a, __m256d b) { return _mm256_add_pd(a, b); }
+    TGP_TARGET_AVX2 static __m256 apply(__m256 a, __m256 b) { return _mm256_add_ps(a, b); }
+    TGP_TARGET_AVX2 static t_avx2_int16 apply(t_avx2_int16 a, t_avx2_int16 b) { t_avx2_int16 r = { _mm256_adds_epi16(a.v, b.v) }; return r; }
+#endif
+#if TGP_AVX512
+    TGP_TARGET_AVX512 static __m512d apply(__m512d a, __m512d b) { return _mm512_add_pd(a, b); }
+    TGP_TARGET_AVX512 static __m512 apply(__m512 a, __m512 b) { return _mm512_add_ps(a, b); }
+#endif
+};
+//---------------------------------------------------------------------------
+struct t_sub{
+    template <typename t_value>
+    static t_value apply(t_value a, t_value b) { return a - b; }
+    static int16_t apply(int16_t a, int16_t b) { return saturate16(a - b); }
+#if TGP_X86_SIMD
+    TGP_TARGET_AVX2 static __m256d apply(__m256d a, __m256d b) { return _mm256_sub_pd(a, b); }
+    TGP_TARGET_AVX2 static __m256 apply(__m256 a, __m256 b) { return _mm256_sub_ps(a, b); }
+    TGP_TARGET_AVX2 static t_avx2_int16 apply(t_avx2_int16 a, t_avx2_int16 b) { t_avx2_int16 r = { _mm256_subs_epi16(a.v, b.v) }; return r; }
+#endif
+#if TGP_AVX512
+    TGP_TARGET_AVX512 static __m512d apply(__m512d a, __m512d b) { return _mm512_sub_pd(a, b); }
+    TGP_TARGET_AVX512 static __m512 apply(__m512 a, __m512 b) { return _mm512_sub_ps(a, b); }
+#endif
+};
+//---------------------------------------------------------------------------
+struct t_mul{
+    template <typename t_value>
+    static t_value apply(t_value a, t_value b) { return a * b; }
+    static int16_t apply(int16_t a, int16_t b) { return saturate16((a * b) >> FixedPointBits); }
+#if TGP_X86_SIMD
+    TGP_TARGET_AVX2 static __m256d apply(__m256d a, __m256d b) { return _mm256_mul_pd(a, b); }
+    TGP_TARGET_AVX2 static __m256 apply(__m256 a, __m256 b) { return _mm256_mul_ps(a, b); }
+    TGP_TARGET_AVX2 static t_avx2_int16 apply(t_avx2_int16 a, t_avx2_int16 b)
+    // the 32 bit products are shifted, then packed back with saturation
+    {
+        __m256i low = _mm256_mullo_epi16(a.v, b.v);
+        __m256i high = _mm256_mulhi_epi16(a.v, b.v);
+        __m256i product_0 = _mm256_srai_epi32(_mm256_unpacklo_epi16(low, high), FixedPointBits);
+        __m256i product_1 = _mm256_srai_epi32(_mm256_unpackhi_epi16(low, high), FixedPointBits);
+        t_avx2_int16 r = { _mm256_packs_epi32(product_0, product_1) };
+        return r;
+    }
+#endif
+#if TGP_AVX512
+    TGP_TARGET_AVX512 static __m512d apply(__m512d a, __m512d b) { return _mm512_mul_pd(a, b); }
+    TGP_TARGET_AVX512 static __m512 apply(__m512 a, __m512 b) { return _mm512_mul_ps(a, b); }
+#endif
+};
+//---------------------------------------------------------------------------
+struct t_div{
+    template <typename t_value>
+    static t_value apply(t_value a, t_value b) { return a / b; }
+    static int16_t apply(int16_t a, int16_t b) { return fixed_divide(a, b); }
+#if TGP_X86_SIMD
+    TGP_TARGET_AVX2 static __m256d apply(__m256d a, __m256d b) { return _mm256_div_pd(a, b); }
+    TGP_TARGET_AVX2 static __m256 apply(__m256 a, __m256 b) { return _mm256_div_ps(a, b); }
+    TGP_TARGET_AVX2 static t_avx2_int16 apply(t_avx2_int16 a, t_avx2_int16 b)
+    {
+        __m128i low = fixed_divide_avx2(_mm256_castsi256_si128(a.v), _mm256_castsi256_si128(b.v));
+        __m128i high = fixed_divide_avx2(_mm256_extracti128_si256(a.v, 1), _mm256_extracti128_si256(b.v, 1));
+        t_avx2_int16 r = { _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1) };
+        return r;
+    }
+#endif
+#if TGP_AVX512
+    TGP_TARGET_AVX512 static __m512d apply(__m512d a, __m512d b) { return _mm512_div_pd(a, b); }
+    TGP_TARGET_AVX512 static __m512 apply(__m512 a, __m512 b) { return _mm512_div_ps(a, b); }
+#endif
+};
+//---------------------------------------------------------------------------
+// the extended function set
+// protected functions never make Inf or NaN from finite values: pdiv gives 1 for a divisor near 0 and
+// limits its quotient to the largest finite value, sqrt and log use |a| (log gives 0 near 0), exp limits
+// its argument to a finite result, and sin gives 0 where its argument cannot be reduced accurately. sqrt,
+// log, exp, sin and abs ignore their second operand; if(a, b) is b when a > 0, else 0.
+// libm has no SIMD versions and its results depend on the library, so each function is written once,
+// with the operations of t_real only, and is inlined into the loop of each instruction set: all of them
+// give the same bits (as long as the compiler does not fuse multiply-adds: no -mfma, -march=native or
+// -ffast-math). compared with libm, the error is at most 1-2 ulps for exp and 3 ulps for log; for sin,
+// measured on every float below 8192 and on doubles near the multiples of pi, it is at most 3.6 ulps for
+// float and 4.4 ulps for double, zeros included. fixed point values are computed in float
+//---------------------------------------------------------------------------
+#define ProtectedEpsilon 1e-6    // pdiv and log treat a smaller |value| as 0
+//---------------------------------------------------------------------------
+template <typename t_float, typename t_bits, int mantissa_bits, int exponent_bias>
+struct t_real_scalar{
+    // a single real value
+    typedef t_float t_scalar;
+    typedef bool t_mask;
+    static t_float set(t_float x) { return x; }
+    static t_float add(t_float a, t_float b) { return a + b; }
+    static t_float sub(t_float a, t_float b) { return a - b; }
+    static t_float mul(t_float a, t_float b) { return a * b; }
+    static t_float div(t_float a, t_float b) { return a / b; }
+    static t_float min(t_float a, t_float b) { return a < b ? a : b; } // b if one of them is NaN, as the SIMD min
+    static t_float max(t_float a, t_float b) { return a > b ? a : b; }
+    static t_float abs(t_float a) { return (t_float)fabs(a); }
+    static t_float sqrt(t_float a) { return (t_float)::sqrt((double)a); } // correctly rounded in double, so also in float
+    static t_float round(t_float a) { return (t_float)nearbyint(a); }  // to the nearest integer, ties to even
+    static bool less(t_float a, t_float b) { return a < b; }             // false if one of them is NaN
+    static t_float select(bool mask, t_float a, t_float b) { return mask ? a : b; }
+    static t_float split(t_float a, t_float &mantissa)
+    // a = mantissa * 2^exponent, 1 <= mantissa < 2, for a positive normal a; returns the exponent
+    {
+        t_bits bits;
+        memcpy(&bits, &a, sizeof(bits));
+        t_bits m = (bits & (((t_bits)1 << mantissa_bits) - 1)) | ((t_bits)exponent_bias << mantissa_bits);
+        memcpy(&mantissa, &m, sizeof(m));
+        return (t_float)((int)(bits >> mantissa_bits) - exponent_bias);
+    }
+    static t_float pow2(t_float k)
+    // 2^k for an integer k, if 2^k is a normal value
+    {
+        t_bits bits = (t_bits)((int)k + exponent_bias) << mantissa_bits;
+        t_float x;
+        memcpy(&x, &bits, sizeof(x));
+        return x;
+    }
+};
+//---------------------------------------------------------------------------
+template <typename t_vector>
+struct t_real{};   // the operations on a real value or on a SIMD vector of real values
+
+#if TGP_X86_SIMD
+// with SIMD, a value is also computed in the loop of an instruction set, for the last values: + - * are then
+// made by SSE intrinsics, which GCC does not fuse into multiply-adds where the instruction set has them
+template <>
+struct t_real<double> : t_real_scalar<double, uint64_t, 52, 1023>{
+    static double add(double a, double b) { return _mm_cvtsd_f64(_mm_add_sd(_mm_set_sd(a), _mm_set_sd(b))); }
+    static double sub(double a, double b) { return _mm_cvtsd_f64(_mm_sub_sd(_mm_set_sd(a), _mm_set_sd(b))); }
+    static double mul(double a, double b) { return _mm_cvtsd_f64(_mm_mul_sd(_mm_set_sd(a), _mm_set_sd(b))); }
+};
+
+template <>
+struct t_real<float> : t_real_scalar<float, uint32_t, 23, 127>{
+    static float add(float a, float b) { return _mm_cvtss_f32(_mm_add_ss(_mm_set_ss(a), _mm_set_ss(b))); }
+    static float sub(float a, float b) { return _mm_cvtss_f32(_mm_sub_ss(_mm_set_ss(a), _mm_set_ss(b))); }
+    static float mul(float a, float b) { return _mm_cvtss_f32(_mm_mul_ss(_mm_set_ss(a), _mm_set_ss(b))); }
+};
+#else
+template <>
+struct t_real<double> : t_real_scalar<double, uint64_t, 52, 1023>{};
+
+template <>
+struct t_real<float> : t_real_scalar<float, uint32_t, 23, 127>{};
+#endif
+//---------------------------------------------------------------------------
+#if TGP_X86_SIMD
+struct t_avx2_double{ __m256d v; };   // wrapped, so that t_real can be specialized for them
+struct t_avx2_float{ __m256 v; };
+
+template <>
+struct t_real<t_avx2_double>{
+    typedef double t_scalar;
+    typedef t_avx2_double t_vector;
+    typedef __m256d t_mask;
+    TGP_TARGET_AVX2 static t_vector make(__m256d x) { t_vector r = { x }; return r; }
+    TGP_TARGET_AVX2 static t_vector set(double x) { return make(_mm256_set1_pd(x)); }
+    TGP_TARGET_AVX2 static t_vector add(t_vector a, t_vector b) { return make(_mm256_add_pd(a.v, b.v)); }
+    TGP_TARGET_AVX2 static t_vector sub(t_vector a, t_vector b) { return make(_mm256_sub_pd(a.v, b.v)); }
+    TGP_TARGET_AVX2 static t_vector mul(t_vector a, t_vector b) { return make(_mm256_mul_pd(a.v, b.v)); }
+    TGP_TARGET_AVX2 static t_vector div(t_vector a, t_vector b) { return make(_mm256_div_pd(a.v, b.v)); }
+    TGP_TARGET_AVX2 static t_vector min(t_vector a, t_vector b) { return make(_mm256_min_pd(a.v, b.v)); }
+    TGP_TARGET_AVX2 static t_vector max(t_vector a, t_vector b) { return make(_mm256_max_pd(a.v, b.v)); }
+    TGP_TARGET_AVX2 static t_vector abs(t_vector a) { return make(_mm256_and_pd(a.v, _mm256_castsi256_pd(_mm256_set1_epi64x(0x7FFFFFFFFFFFFFFFLL)))); }
+    TGP_TARGET_AVX2 static t_vector sqrt(t_vector a) { return make(_mm256_sqrt_pd(a.v)); }
+    TGP_TARGET_AVX2 static t_vector round(t_vector a) { return make(_mm256_round_pd(a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)); }
+    TGP_TARGET_AVX2 static t_mask less(t_vector a, t_vector b) { return _mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ); }
+    TGP_TARGET_AVX2 static t_vector select(t_mask mask, t_vector a, t_vector b) { return make(_mm256_blendv_pd(b.v, a.v, mask)); }
+    TGP_TARGET_AVX2 static t_vector split(t_vector a, t_vector &mantissa)
+    // the exponent is converted exactly by writing it below the mantissa of 2^52
+    {
+        __m256i bits = _mm256_castpd_si256(a.v);
+        mantissa = make(_mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL)),
+                                                            _mm256_set1_epi64x(0x3FF0000000000000LL))));
+        __m256d exponent = _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(bits, 52), _mm256_set1_epi64x(0x4330000000000000LL)));
+        return make(_mm256_sub_pd(exponent, _mm256_set1_pd(4503599627370496.0 + 1023)));
+    }
+    TGP_TARGET_AVX2 static t_vector pow2(t_vector k)
+    // the biased exponent is the low bits of 2^52 + k + 1023
+    {
+        __m256i bits = _mm256_castpd_si256(_mm256_add_pd(k.v, _mm256_set1_pd(4503599627370496.0 + 1023)));
+        return make(_mm256_castsi256_pd(_mm256_slli_epi64(bits, 52)));
+    }
+};
+
+template <>
+struct t_real<t_avx2_float>{
+    typedef float t_scalar;
+    typedef t_avx2_float t_vector;
+    typedef __m256 t_mask;
+    TGP_TARGET_AVX2 static t_vector make(__m256 x) { t_vector r = { x }; return r; }
+    TGP_TARGET_AVX2 static t_vector set(float x) { return make(_mm256_set1_ps(x)); }
+    TGP_TARGET_AVX2 static t_vector add(t_vector a, t_vector b) { return make(_mm256_add_ps(a.v, b.v)); }
+    TGP_TARGET_AVX2 static t_vector sub(t_vector a, t_vector b) { return make(_mm256_sub_ps(a.v, b.v)); }
+    TGP_TARGET_AVX2 static t_vector mul(t_vector a, t_vector b) { return make(_mm256_mul_ps(a.v, b.v)); }
+    TGP_TARGET_AVX2 static t_vector div(t_vector a, t_vector b) { return make(_mm256_div_ps(a.v, b.v)); }
+    TGP_TARGET_AVX2 static t_vector min(t_vector a, t_vector b) { return make(_mm256_min_ps(a.v, b.v)); }
+    TGP_TARGET_AVX2 static t_vector max(t_vector a, t_vector b) { return make(_mm256_max_ps(a.v, b.v)); }
+    TGP_TARGET_AVX2 static t_vector abs(t_vector a) { return make(_mm256_and_ps(a.v, _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF)))); }
+    TGP_TARGET_AVX2 static t_vector sqrt(t_vector a) { return make(_mm256_sqrt_ps(a.v)); }
+    TGP_TARGET_AVX2 static t_vector round(t_vector a) { return make(_mm256_round_ps(a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)); }
+    TGP_TARGET_AVX2 static t_mask less(t_vector a, t_vector b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+    TGP_TARGET_AVX2 static t_vector select(t_mask mask, t_vector a, t_vector b) { return make(_mm256_blendv_ps(b.v, a.v, mask)); }
+    TGP_TARGET_AVX2 static t_vector split(t_vector a, t_vector &mantissa)
+    {
+        __m256i bits = _mm256_castps_si256(a.v);
+        mantissa = make(_mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)), _mm256_set1_epi32(0x3F800000))));
+        return make(_mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127))));
+    }
+    TGP_TARGET_AVX2 static t_vector pow2(t_vector k)
+    {
+        __m256i bits = _mm256_add_epi32(_mm256_cvtps_epi32(k.v), _mm256_set1_epi32(127));
+        return make(_mm256_castsi256_ps(_mm256_slli_epi32(bits, 23)));
+    }
+};
+#endif
+//---------------------------------------------------------------------------
+#if TGP_AVX512
+struct t_avx512_double{ __m512d v; };
+struct t_avx512_float{ __m512 v; };
+
+template <>
+struct t_real<t_avx512_double>{
+    typedef double t_scalar;
+    typedef t_avx512_double t_vector;
+    typedef __mmask8 t_mask;
+    // + - * in masked form, which GCC cannot fuse into multiply-adds (AVX-512 has them, the other versions not);
+    // the other masked forms avoid false warnings of GCC (see hash_words_avx512)
+    static const __mmask8 all = 0xFF;
+    TGP_TARGET_AVX512 static t_vector make(__m512d x) { t_vector r = { x }; return r; }
+    TGP_TARGET_AVX512 static t_vector set(double x) { return make(_mm512_set1_pd(x)); }
+    TGP_TARGET_AVX512 static t_vector add(t_vector a, t_vector b) { return make(_mm512_maskz_add_pd(all, a.v, b.v)); }
+    TGP_TARGET_AVX512 static t_vector sub(t_vector a, t_vector b) { return make(_mm512_maskz_sub_pd(all, a.v, b.v)); }
+    TGP_TARGET_AVX512 static t_vector mul(t_vector a, t_vector b) { return make(_mm512_maskz_mul_pd(all, a.v, b.v)); }
+    TGP_TARGET_AVX512 static t_vector div(t_vector a, t_vector b) { return make(_mm512_div_pd(a.v, b.v)); }
+    TGP_TARGET_AVX512 static t_vector min(t_vector a, t_vector b) { return make(_mm512_maskz_min_pd(all, a.v, b.v)); }
+    TGP_TARGET_AVX512 static t_vector max(t_vector a, t_vector b) { return make(_mm512_maskz_max_pd(all, a.v, b.v)); }
+    TGP_TARGET_AVX512 static t_vector abs(t_vector a)
+    {
+        return make(_mm512_castsi512_pd(_mm512_and_si512(_mm512_castpd_si512(a.v), _mm512_set1_epi64(0x7FFFFFFFFFFFFFFFLL))));
+    }
+    TGP_TARGET_AVX512 static t_vector sqrt(t_vector a) { return make(_mm512_maskz_sqrt_pd(all, a.v)); }
+    TGP_TARGET_AVX512 static t_vector round(t_vector a) { return make(_mm512_maskz_roundscale_pd(all, a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)); }
+    TGP_TARGET_AVX512 static t_mask less(t_vector a, t_vector b) { return _mm512_cmp_pd_mask(a.v, b.v, _CMP_LT_OQ); }
+    TGP_TARGET_AVX512 static t_vector select(t_mask mask, t_vector a, t_vector b) { return make(_mm512_mask_blend_pd(mask, b.v, a.v)); }
+    TGP_TARGET_AVX512 static t_vector split(t_vector a, t_vector &mantissa)
+    {
+        __m512i bits = _mm512_castpd_si512(a.v);
+        mantissa = make(_mm512_castsi512_pd(_mm512_or_si512(_mm512_and_si512(bits, _mm512_set1_epi64(0x000FFFFFFFFFFFFFLL)),
+                                                            _mm512_set1_epi64(0x3FF0000000000000LL))));
+        __m512d exponent = _mm512_castsi512_pd(_mm512_or_si512(_mm512_maskz_srli_epi64(all, bits, 52), _mm512_set1_epi64(0x4330000000000000LL)));
+        return make(_mm512_maskz_sub_pd(all, exponent, _mm512_set1_pd(4503599627370496.0 + 1023)));
+    }
+    TGP_TARGET_AVX512 static t_vector pow2(t_vector k)
+    {
+        __m512i bits = _mm512_castpd_si512(_mm512_maskz_add_pd(all, k.v, _mm512_set1_pd(4503599627370496.0 + 1023)));
+        return make(_mm512_castsi512_pd(_mm512_maskz_slli_epi64(all, bits, 52)));
+    }
+};
+
+template <>
+struct t_real<t_avx512_float>{
+    typedef float t_scalar;
+    typedef t_avx512_float t_vector;
+    typedef __mmask16 t_mask;
+    static const __mmask16 all = 0xFFFF;
+    TGP_TARGET_AVX512 static t_vector make(__m512 x) { t_vector r = { x }; return r; }
+    TGP_TARGET_AVX512 static t_vector set(float x) { return make(_mm512_set1_ps(x)); }
+    TGP_TARGET_AVX512 static t_vector add(t_vector a, t_vector b) { return make(_mm512_maskz_add_ps(all, a.v, b.v)); }
+    TGP_TARGET_AVX512 static t_vector sub(t_vector a, t_vector b) { return make(_mm512_maskz_sub_ps(all, a.v, b.v)); }
+    TGP_TARGET_AVX512 static t_vector mul(t_vector a, t_vector b) { return make(_mm512_maskz_mul_ps(all, a.v, b.v)); }
+    TGP_TARGET_AVX512 static t_vector div(t_vector a, t_vector b) { return make(_mm512_div_ps(a.v, b.v)); }
+    TGP_TARGET_AVX512 static t_vector min(t_vector a, t_vector b) { return make(_mm512_maskz_min_ps(all, a.v, b.v)); }
+    TGP_TARGET_AVX512 static t_vector max(t_vector a, t_vector b) { return make(_mm512_maskz_max_ps(all, a.v, b.v)); }
+    TGP_TARGET_AVX512 static t_vector abs(t_vector a)
+    {
+        return make(_mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(a.v), _mm512_set1_epi32(0x7FFFFFFF))));
+    }
+    TGP_TARGET_AVX512 static t_vector sqrt(t_vector a) { return make(_mm512_maskz_sqrt_ps(all, a.v)); }
+    TGP_TARGET_AVX512 static t_vector round(t_vector a) { return make(_mm512_maskz_roundscale_ps(all, a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)); }
+    TGP_TARGET_AVX512 static t_mask less(t_vector a, t_vector b) { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ); }
+    TGP_TARGET_AVX512 static t_vector select(t_mask mask, t_vector a, t_vector b) { return make(_mm512_mask_blend_ps(mask, b.v, a.v)); }
+    TGP_TARGET_AVX512 static t_vector split(t_vector a, t_vector &mantissa)
+    {
+        __m512i bits = _mm512_castps_si512(a.v);
+        mantissa = make(_mm512_castsi512_ps(_mm512_or_si512(_mm512_and_si512(bits, _mm512_set1_epi32(0x007FFFFF)), _mm512_set1_epi32(0x3F800000))));
+        return make(_mm512_maskz_cvtepi32_ps(all, _mm512_sub_epi32(_mm512_maskz_srli_epi32(all, bits, 23), _mm512_set1_epi32(127))));
+    }
+    TGP_TARGET_AVX512 static t_vector pow2(t_vector k)
+    {
+        __m512i bits = _mm512_add_epi32(_mm512_maskz_cvtps_epi32(all, k.v), _mm512_set1_epi32(127));
+        return make(_mm512_castsi512_ps(_mm512_maskz_slli_epi32(all, bits, 23)));
+    }
+};
+#endif
+//---------------------------------------------------------------------------
+template <typename t_scalar>
+struct t_function_constants{};
+
+template <>
+struct t_function_constants<double>{
+    enum { num_exp = 14, num_log = 10, num_sin = 10, num_pi = 4 };
+    static const double exp_coefficients[num_exp], log_coefficients[num_log], sin_coefficients[num_sin];
+    static const double max_exp_argument, max_sin_argument, pi[num_pi];
+};
+
+template <>
+struct t_function_constants<float>{
+    enum { num_exp = 8, num_log = 6, num_sin = 6, num_pi = 4 };
+    static const float exp_coefficients[num_exp], log_coefficients[num_log], sin_coefficients[num_sin];
+    static const float max_exp_argument, max_sin_argument, pi[num_pi];
+};
+
+// exp(r) for |r| <= ln(2) / 2: 1 / n!
+const double t_function_constants<double>::exp_coefficients[] = { 1.0, 1.0, 1.0 / 2, 1.0 / 6, 1.0 / 24, 1.0 / 120, 1.0 / 720, 1.0 / 5040,
+    1.0 / 40320, 1.0 / 362880, 1.0 / 3628800, 1.0 / 39916800, 1.0 / 479001600, 1.0 / 6227020800.0 };
+const float t_function_constants<float>::exp_coefficients[] = { 1.0f, 1.0f, 1.0f / 2, 1.0f / 6, 1.0f / 24, 1.0f / 120, 1.0f / 720, 1.0f / 5040 };
+// log(m) = 2 atanh(s), s = (m - 1) / (m + 1), |s| <= 0.172: 2 / (2 n + 1), a polynomial in s^2
+const double t_function_constants<double>::log_coefficients[] = { 2.0, 2.0 / 3, 2.0 / 5, 2.0 / 7, 2.0 / 9, 2.0 / 11, 2.0 / 13, 2.0 / 15, 2.0 / 17, 2.0 / 19 };
+const float t_function_constants<float>::log_coefficients[] = { 2.0f, 2.0f / 3, 2.0f / 5, 2.0f / 7, 2.0f / 9, 2.0f / 11 };
+// sin(r) for |r| <= pi / 2: (-1)^n / (2 n + 1)!, a polynomial in r^2
+const double t_function_constants<double>::sin_coefficients[] = { 1.0, -1.0 / 6, 1.0 / 120, -1.0 / 5040, 1.0 / 362880, -1.0 / 39916800,
+    1.0 / 6227020800.0, -1.0 / 1307674368000.0, 1.0 / 355687428096000.0, -1.0 / 121645100408832000.0 };
+const float t_function_constants<float>::sin_coefficients[] = { 1.0f, -1.0f / 6, 1.0f / 120, -1.0f / 5040, 1.0f / 362880, -1.0f / 39916800 };
+// exp stays a normal value; sin reduces its argument by multiples of pi, written in 4 parts (Cody and Waite),
+// the first ones with few bits so that their products by the multiple are exact
+const double t_function_constants<double>::max_exp_argument = 700;
+const float t_function_constants<float>::max_exp_argument = 80;
+const double t_function_constants<double>::max_sin_argument = 1073741824.0;
+const float t_function_constants<float>::max_sin_argument = 8192;
+const double t_function_constants<double>::pi[] = { 3.1415927410125732421875, -8.74227765734758577309548854827880859375e-8,
+    -3.430249020011763745607868969500486855395138263702392578125e-15, 2.1125998133974855e-23 };
+const float t_function_constants<float>::pi[] = { 3.140625f, 9.677410125732421875e-4f, -8.7427906692028045654296875e-8f,
+    5.126688136514179205960317631252110004425048828125e-12f };
+//---------------------------------------------------------------------------
+// the functions are instantiated with SIMD vectors outside of the code of their instruction set, which GCC
+// reports as a change of ABI; they are always inlined, so their ABI does not matter
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+//---------------------------------------------------------------------------
+template <typename t_vector>
+TGP_ALWAYS_INLINE t_vector polynomial(const t_vector &x, const typename t_real<t_vector>::t_scalar *coefficients, int n)
+// coefficients[0] + coefficients[1] x + ... + coefficients[n - 1] x^(n - 1), by Horner's rule
+{
+    typedef t_real<t_vector> R;
+    t_vector p = R::set(coefficients[n - 1]);
+    for (int i = n - 2; i >= 0; i--)
+        p = R::add(R::mul(p, x), R::set(coefficients[i]));
+    return p;
+}
+//---------------------------------------------------------------------------
+struct t_pdiv{
+    template <typename t_vector>
+    static TGP_ALWAYS_INLINE t_vector compute(const t_vector &a, const t_vector &b)
+    {
+        typedef t_real<t_vector> R;
+        // the quotient of finite values may overflow: it is limited to the largest finite value (a NaN
+        // quotient, from a non-finite operand, goes through as the second operand of min and max)
+        t_vector largest = R::set(std::numeric_limits<typename R::t_scalar>::max());
+        t_vector q = R::min(largest, R::max(R::sub(R::set(0), largest), R::div(a, b)));
+        return R::select(R::less(R::set(ProtectedEpsilon), R::abs(b)), q, R::set(1));
+    }
+};
+//---------------------------------------------------------------------------
+struct t_sqrt{
+    template <typename t_vector>
+    static TGP_ALWAYS_INLINE t_vector compute(const t_vector &a, const t_vector &)
+    {
+        typedef t_real<t_vector> R;
+        return R::sqrt(R::abs(a));
+    }
+};
+//---------------------------------------------------------------------------
+struct t_log{
+    template <typename t_vector>
+    static TGP_ALWAYS_INLINE t_vector compute(const t_vector &a, const t_vector &)
+    // |a| = m 2^e with sqrt(2) / 2 <= m < sqrt(2); log |a| = e ln(2) + log(m), with ln(2) in 2 parts
+    {
+        typedef t_real<t_vector> R;
+        typedef t_function_constants<typename R::t_scalar> C;
+        t_vector x = R::abs(a);
+        typename R::t_mask valid = R::less(R::set(ProtectedEpsilon), x); // false for NaN
+        t_vector m;
+        t_vector e = R::split(R::min(x, R::set(std::numeric_limits<typename R::t_scalar>::max())), m);
+        typename R::t_mask large = R::less(R::set(1.41421356237309504880), m);
+        m = R::select(large, R::mul(m, R::set(0.5)), m);
+        e = R::select(large, R::add(e, R::set(1)), e);
+        t_vector s = R::div(R::sub(m, R::set(1)), R::add(m, R::set(1)));
+        t_vector log_m = R::mul(s, polynomial(R::mul(s, s), C::log_coefficients, C::num_log));
+        t_vector y = R::add(R::add(R::mul(e, R::set(-2.121944400546905827679e-4)), log_m), R::mul(e, R::set(0.693359375)));
+        return R::select(valid, y, R::set(0));
+    }
+};
+//---------------------------------------------------------------------------
+struct t_exp{
+    template <typename t_vector>
+    static TGP_ALWAYS_INLINE t_vector compute(const t_vector &a, const t_vector &)
+    // exp(a) = 2^k exp(r), with k the integer nearest to a / ln(2)
+    {
+        typedef t_real<t_vector> R;
+        typedef t_function_constants<typename R::t_scalar> C;
+        t_vector x = R::min(R::max(a, R::set(-C::max_exp_argument)), R::set(C::max_exp_argument)); // NaN gives the minimum
+        t_vector k = R::round(R::mul(x, R::set(1.44269504088896340736)));
+        t_vector r = R::sub(R::sub(x, R::mul(k, R::set(0.693359375))), R::mul(k, R::set(-2.121944400546905827679e-4)));
+        return R::mul(polynomial(r, C::exp_coefficients, C::num_exp), R::pow2(k));
+    }
+};
+//---------------------------------------------------------------------------
+struct t_sin{
+    template <typename t_vector>
+    static TGP_ALWAYS_INLINE t_vector compute(const t_vector &a, const t_vector &)
+    // sin(a) = (-1)^k sin(r), with r = a - k pi and k the integer nearest to a / pi
+    {
+        typedef t_real<t_vector> R;
+        typedef t_function_constants<typename R::t_scalar> C;
+        typename R::t_mask valid = R::less(R::abs(a), R::set(C::max_sin_argument)); // false for Inf and NaN
+        t_vector k = R::round(R::mul(a, R::set(0.318309886183790671538)));
+        t_vector r = a;
+        for (int i = 0; i < C::num_pi; i++)
+            r = R::sub(r, R::mul(k, R::set(C::pi[i])));
+        t_vector y = R::mul(r, polynomial(R::mul(r, r), C::sin_coefficients, C::num_sin));
+        t_vector half_k = R::round(R::mul(k, R::set(0.5)));
+        typename R::t_mask odd = R::less(R::set(0.5), R::abs(R::sub(k, R::add(half_k, half_k))));
+        y = R::select(odd, R::sub(R::set(0), y), y);
+        return R::select(valid, y, R::set(0));
+    }
+};
+//---------------------------------------------------------------------------
+struct t_abs{
+    template <typename t_vector>
+    static TGP_ALWAYS_INLINE t_vector compute(const t_vector &a, const t_vector &)
+    {
+        return t_real<t_vector>::abs(a);
+    }
+};
+//---------------------------------------------------------------------------
+struct t_min{
+    template <typename t_vector>
+    static TGP_ALWAYS_INLINE t_vector compute(const t_vector &a, const t_vector &b)
+    {
+        return t_real<t_vector>::min(a, b);
+    }
+};
+//---------------------------------------------------------------------------
+struct t_max{
+    template <typename t_vector>
+    static TGP_ALWAYS_INLINE t_vector compute(const t_vector &a, const t_vector &b)
+    {
+        return t_real<t_vector>::max(a, b);
+    }
+};
+//---------------------------------------------------------------------------
+struct t_if{
+    template <typename t_vector>
+    static TGP_ALWAYS_INLINE t_vector compute(const t_vector &a, const t_vector &b)
+    {
+        typedef t_real<t_vector> R;
+        return R::select(R::less(R::set(0), a), b, R::set(0));
+    }
+};
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+//---------------------------------------------------------------------------
+inline float real_from_fixed(int16_t a)
+{
+    return (float)a * (1.0f / FixedPointOne);
+}
+//---------------------------------------------------------------------------
+inline int16_t fixed_from_real(float x)
+// truncated and saturated, as fixed_divide
+{
+    float q = x * (float)FixedPointOne;
+    if (q != q)
+        q = 0;
+    q = q < (float)INT16_MIN ? (float)INT16_MIN : (q > (float)INT16_MAX ? (float)INT16_MAX : q);
+    return (int16_t)q;
+}
+//---------------------------------------------------------------------------
+#if TGP_X86_SIMD
+TGP_TARGET_AVX2 inline t_avx2_float real_from_fixed_avx2(__m128i a)
+{
+    t_avx2_float x = { _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(a)), _mm256_set1_ps(1.0f / FixedPointOne)) };
+    return x;
+}
+//---------------------------------------------------------------------------
+TGP_TARGET_AVX2 inline __m128i fixed_from_real_avx2(t_avx2_float x)
+{
+    __m256 q = _mm256_mul_ps(x.v, _mm256_set1_ps((float)FixedPointOne));
+    q = _mm256_and_ps(q, _mm256_cmp_ps(q, q, _CMP_ORD_Q));
+    q = _mm256_min_ps(_mm256_max_ps(q, _mm256_set1_ps((float)INT16_MIN)), _mm256_set1_ps((float)INT16_MAX));
+    __m256i q32 = _mm256_cvttps_epi32(q);
+    return _mm_packs_epi32(_mm256_castsi256_si128(q32), _mm256_extracti128_si256(q32, 1));
+}
+#endif
+//---------------------------------------------------------------------------
+template <typename t_function>
+struct t_real_operator{
+    // the operator of the function set made of t_function::compute, for each type of values
+    static double apply(double a, double b) { return t_function::compute(a, b); }
+    static float apply(float a, float b) { return t_function::compute(a, b); }
+    static int16_t apply(int16_t a, int16_t b) { return fixed_from_real(t_function::compute(real_from_fixed(a), real_from_fixed(b))); }
+#if TGP_X86_SIMD
+    TGP_TARGET_AVX2 static __m256d apply(__m256d a, __m256d b)
+    {
+        t_avx2_double x = { a }, y = { b };
+        return t_function::compute(x, y).v;
+    }
+    TGP_TARGET_AVX2 static __m256 apply(__m256 a, __m256 b)
+    {
+        t_avx2_float x = { a }, y = { b };
+        return t_function::compute(x, y).v;
+    }
+    TGP_TARGET_AVX2 static t_avx2_int16 apply(t_avx2_int16 a, t_avx2_int16 b)
+    // in 2 vectors of 8 floats, in a loop (GCC 12 at -O2 gives wrong results for the high half of log and
+    // sin when both halves are written out)
+    {
+        __m128i half_a[2], half_b[2], half_r[2];
+        _mm256_storeu_si256((__m256i*)half_a, a.v);
+        _mm256_storeu_si256((__m256i*)half_b, b.v);
+        for (int h = 0; h < 2; h++)
+            half_r[h] = fixed_from_real_avx2(t_function::compute(real_from_fixed_avx2(half_a[h]), real_from_fixed_avx2(half_b[h])));
+        t_avx2_int16 r = { _mm256_loadu_si256((const __m256i*)half_r) };
+        return r;
+    }
+#endif
+#if TGP_AVX512
+    TGP_TARGET_AVX512 static __m512d apply(__m512d a, __m512d b)
+    {
+        t_avx512_double x = { a }, y = { b };
+        return t_function::compute(x, y).v;
+    }
+    TGP_TARGET_AVX512 static __m512 apply(__m512 a, __m512 b)
+    {
+        t_avx512_float x = { a }, y = { b };
+        return t_function::compute(x, y).v;
+    }
+#endif
+};
+//---------------------------------------------------------------------------
+typedef t_operator_list<t_add, t_sub, t_mul, t_div, t_real_operator<t_pdiv>, t_real_operator<t_sqrt>, t_real_operator<t_log>,
+                        t_real_operator<t_exp>, t_real_operator<t_sin>, t_real_operator<t_abs>, t_real_operator<t_min>,
+                        t_real_operator<t_max>, t_real_operator<t_if> > t_arithmetic_operators;
+const char *const operator_names[] = { "add", "sub", "mul", "div", "pdiv", "sqrt", "log", "exp", "sin", "abs", "min", "max", "if" };
+const bool operator_commutative[] = { true, false, true, false, false, false, false, false, false, false, true, true, false };
+const bool operator_unary[] = { false, false, false, false, false, true, true, true, true, true, false, false, false };
+#define DefaultFunctions 0xF     // + - * /
+//---------------------------------------------------------------------------
+bool parse_functions(const char *list, unsigned int &functions)
+// a list of operator names separated by commas, e.g. "add,sub,mul,pdiv"; functions receives the bit of each
+{
+    functions = 0;
+    while (*list){
+        size_t length = strcspn(list, ",");
+        int op = 0;
+        while (op < t_arithmetic_operators::size && (strlen(operator_names[op]) != length || strncmp(list, operator_names[op], length)))
+            op++;
+        if (op == t_arithmetic_operators::size){
+            printf("Unknown function %.*s\n", (int)length, list);
+            return false;
+        }
+        functions |= 1u << op;
+        list += length;
+        if (*list == ',')
+            list++;
+    }
+    if (!functions){
+        printf("The function set is empty\n");
+        return false;
+    }
+    return true;
+}
+//---------------------------------------------------------------------------
+int list_functions(unsigned int functions, int *function)
+// the operators of the function set, in the order of t_arithmetic_operators; returns their number
+{
+    int n = 0;
+    for (int op = 0; op < t_arithmetic_operators::size; op++)
+        if (functions & (1u << op))
+            function[n++] = op;
+    return n;
+}
+//---------------------------------------------------------------------------
+struct t_nearest_class{
+    // fitness policy: a value is classified to the nearest class
+    typedef int t_target;
+    template <typename t_value>
+    static int count_errors_scalar(const t_value *value, const int *target, int n, int num_classes);
+    static int count_errors_scalar(const int16_t *value, const int *target, int n, int num_classes);
+#if TGP_X86_SIMD
+    TGP_TARGET_AVX2 static int count_errors_avx2(const double *value, const int *target, int n, int num_classes);
+    TGP_TARGET_AVX2 static int count_errors_avx2(const float *value, const int *target, int n, int num_classes);
+    TGP_TARGET_AVX2 static int count_errors_avx2(const int16_t *value, const int *target, int n, int num_classes);
+#endif
+#if TGP_AVX512
+    TGP_TARGET_AVX512 static int count_errors_avx512(const double *value, const int *target, int n, int num_classes);
+    TGP_TARGET_AVX512 static int count_errors_avx512(const float *value, const int *target, int n, int num_classes);
+#endif
+};
+//---------------------------------------------------------------------------
+template <typename t_value>
+int decode_class(t_value value, int num_classes)
+// classify it to the nearest class
+{
+    t_value min = std::numeric_limits<t_value>::max();
+    int actual_class = -1;
+    for (int k = 0; k < num_classes; k++){
+        t_value distance = value - k;
+        if (distance < 0)
+            distance = -distance;
+        if (distance < min){
+            min = distance;
+            actual_class = k;
+        }
+    }
+    return actual_class;
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+int t_nearest_class::count_errors_scalar(const t_value *value, const int *target, int n, int num_classes)
+{
+    int num_errors = 0;
+    for (int i = 0; i < n; i++)
+        // found a class for it, now see if it is equal to the real one
+        if (decode_class(value[i], num_classes) != target[i])
+            num_errors++;
+    return num_errors;
+}
+//---------------------------------------------------------------------------
+inline int decode_class(int16_t value, int num_classes)
+// the nearest class; as for the floating point values, a tie goes to the smaller class
+{
+    int k = (value >> FixedPointBits) + ((value & (FixedPointOne - 1)) > FixedPointOne / 2);
+    return k < 0 ? 0 : (k >= num_classes ? num_classes - 1 : k);
+}
+//---------------------------------------------------------------------------
+int t_nearest_class::count_errors_scalar(const int16_t *value, const int *target, int n, int num_classes)
+{
+    int num_errors = 0;
+    for (int i = 0; i < n; i++)
+        if (decode_class(value[i], num_classes) != target[i])
+            num_errors++;
+    return num_errors;
+}
+//---------------------------------------------------------------------------
+#if TGP_X86_SIMD
+TGP_TARGET_AVX2 int t_nearest_class::count_errors_avx2(const double *value, const int *target, int n, int num_classes)
+// same decoding as decode_class, but 4 values at once and without branches:
+// a lane takes class k only when |value - k| is strictly smaller than the best distance so far
+{
+    const __m256d abs_mask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+    int num_errors = 0;
+    int i = 0;
+    for (; i + 4 <= n; i += 4){
+        __m256d v = _mm256_loadu_pd(value + i);
+        __m256d min = _mm256_set1_pd(DBL_MAX);
+        __m256d actual_class = _mm256_set1_pd(-1.0);
+        for (int k = 0; k < num_classes; k++){
+            __m256d class_k = _mm256_set1_pd((double)k);
+            __m256d distance = _mm256_and_pd(_mm256_sub_pd(v, class_k), abs_mask);
+            __m256d closer = _mm256_cmp_pd(distance, min, _CMP_LT_OQ);
+            min = _mm256_blendv_pd(min, distance, closer);
+            actual_class = _mm256_blendv_pd(actual_class, class_k, closer);
+        }
+        __m256d expected = _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)(target + i)));
+        num_errors += popcount32((unsigned int)_mm256_movemask_pd(_mm256_cmp_pd(actual_class, expected, _CMP_NEQ_UQ)));
+    }
+    return num_errors + count_errors_scalar(value + i, target + i, n - i, num_classes);
+}
+//---------------------------------------------------------------------------
+TGP_TARGET_AVX2 int t_nearest_class::count_errors_avx2(const float *value, const int *target, int n, int num_classes)
+{
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    int num_errors = 0;
+    int i = 0;
+    for (; i + 8 <= n; i += 8){
+        __m256 v = _mm256_loadu_ps(value + i);
+        __m256 min = _mm256_set1_ps(FLT_MAX);
+        __m256 actual_class = _mm256_set1_ps(-1.0f);
+        for (int k = 0; k < num_classes; k++){
+            __m256 class_k = _mm256_set1_ps((float)k);
+            __m256 distance = _mm256_and_ps(_mm256_sub_ps(v, class_k), abs_mask);
+            __m256 closer = _mm256_cmp_ps(distance, min, _CMP_LT_OQ);
+            min = _mm256_blendv_ps(min, distance, closer);
+            actual_class = _mm256_blendv_ps(actual_class, class_k, closer);
+        }
+        __m256 expected = _mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(target + i)));
+        num_errors += popcount32((unsigned int)_mm256_movemask_ps(_mm256_cmp_ps(actual_class, expected, _CMP_NEQ_UQ)));
+    }
+    return num_errors + count_errors_scalar(value + i, target + i, n - i, num_classes);
+}
+//---------------------------------------------------------------------------
+TGP_TARGET_AVX2 int t_nearest_class::count_errors_avx2(const int16_t *value, const int *target, int n, int num_classes)
+{
+    const __m256i half = _mm256_set1_epi16(FixedPointOne / 2);
+    const __m256i fraction_mask = _mm256_set1_epi16(FixedPointOne - 1);
+    const __m256i last_class = _mm256_set1_epi16((short)(num_classes - 1 < INT16_MAX ? num_classes - 1 : INT16_MAX));
+    int num_errors = 0;
+    int i = 0;
+    for (; i + 16 <= n; i += 16){
+        __m256i v = _mm256_loadu_si256((const __m256i*)(value + i));
+        __m256i round_up = _mm256_cmpgt_epi16(_mm256_and_si256(v, fraction_mask), half); // -1 if the fraction is above 1/2
+        __m256i actual_class = _mm256_sub_epi16(_mm256_srai_epi16(v, FixedPointBits), round_up);
+        actual_class = _mm256_min_epi16(_mm256_max_epi16(actual_class, _mm256_setzero_si256()), last_class);
+        __m256i expected = _mm256_packs_epi32(_mm256_loadu_si256((const __m256i*)(target + i)), _mm256_loadu_si256((const __m256i*)(target + i + 8)));
+        expected = _mm256_permute4x64_epi64(expected, 0xD8); // packs works inside each 128 bit lane
+        unsigned int equal = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi16(actual_class, expected));
+        num_errors += 16 - popcount32(equal) / 2;
+    }
+    return num_errors + count_errors_scalar(value + i, target + i, n - i, num_classes);
+}
+#endif
+//---------------------------------------------------------------------------
+#if TGP_AVX512
+TGP_TARGET_AVX512 int t_nearest_class::count_errors_avx512(const double *value, const int *target, int n, int num_classes)
+{
+    const __m512i abs_mask = _mm512_set1_epi64(0x7FFFFFFFFFFFFFFFLL);
+    int num_errors = 0;
+    int i = 0;
+    for (; i + 8 <= n; i += 8){
+        __m512d v = _mm512_loadu_pd(value + i);
+        __m512d min = _mm512_set1_pd(DBL_MAX);
+        __m512d actual_class = _mm512_set1_pd(-1.0);
+        for (int k = 0; k < num_classes; k++){
+            __m512d class_k = _mm512_set1_pd((double)k);
+            __m512d distance = _mm512_castsi512_pd(_mm512_and_si512(_mm512_castpd_si512(_mm512_sub_pd(v, class_k)), abs_mask));
+            __mmask8 closer = _mm512_cmp_pd_mask(distance, min, _CMP_LT_OQ);
+            min = _mm512_mask_blend_pd(closer, min, distance);
+            actual_class = _mm512_mask_blend_pd(closer, actual_class, class_k);
+        }
+        __m512d expected = _mm512_maskz_cvtepi32_pd(0xFF, _mm256_loadu_si256((const __m256i*)(target + i)));
+        num_errors += popcount32((unsigned int)_mm512_cmp_pd_mask(actual_class, expected, _CMP_NEQ_UQ));
+    }
+    return num_errors + count_errors_scalar(value + i, target + i, n - i, num_classes);
+}
+//---------------------------------------------------------------------------
+TGP_TARGET_AVX512 int t_nearest_class::count_errors_avx512(const float *value, const int *target, int n, int num_classes)
+{
+    const __m512i abs_mask = _mm512_set1_epi32(0x7FFFFFFF);
+    int num_errors = 0;
+    int i = 0;
+    for (; i + 16 <= n; i += 16){
+        __m512 v = _mm512_loadu_ps(value + i);
+        __m512 min = _mm512_set1_ps(FLT_MAX);
+        __m512 actual_class = _mm512_set1_ps(-1.0f);
+        for (int k = 0; k < num_classes; k++){
+            __m512 class_k = _mm512_set1_ps((float)k);
+            __m512 distance = _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(_mm512_sub_ps(v, class_k)), abs_mask));
+            __mmask16 closer = _mm512_cmp_ps_mask(distance, min, _CMP_LT_OQ);
+            min = _mm512_mask_blend_ps(closer, min, distance);
+            actual_class = _mm512_mask_blend_ps(closer, actual_class, class_k);
+        }
+        __m512 expected = _mm512_maskz_cvtepi32_ps(0xFFFF, _mm512_loadu_si512((const void*)(target + i)));
+        num_errors += popcount32((unsigned int)_mm512_cmp_ps_mask(actual_class, expected, _CMP_NEQ_UQ));
+    }
+    return num_errors + count_errors_scalar(value + i, target + i, n - i, num_classes);
+}
+#endif
+//---------------------------------------------------------------------------
+template <typename t_value>
+const t_kernels<t_value, int>& kernels(void)
+{
+    static t_kernels<t_value, int> selected = select_kernels<t_arithmetic_operators, t_nearest_class, t_value>();
+    return selected;
+}
+//---------------------------------------------------------------------------
+#define FusedBlockSize 1024  // 3 blocks of doubles (2 parents and the child) fit in the L1 cache
+//---------------------------------------------------------------------------
+template <typename t_value>
+int apply_operator_and_count_errors(int op, const t_value *a, const t_value *b, t_value *result, int n, const int *target, int num_classes, int max_errors,
+                                    uint64_t *hash = NULL)
+// builds the child and counts its incorrectly classified data in a single pass:
+// each block is decoded, and hashed if hash is not NULL, while it is still in the L1 cache.
+// if max_errors >= 0, stops as soon as the number of errors exceeds max_errors
+// (the returned value is then greater than max_errors, but not the full count, and result and hash are incomplete)
+{
+    const t_kernels<t_value, int> &k = kernels<t_value>();
+    int num_errors = 0;
+    uint64_t sum = 0;
+    size_t last_word = ((size_t)n * sizeof(t_value) + 7) / 8 - 1; // added by finish_hash
+    for (int start = 0; start < n; start += FusedBlockSize){
+        int size = n - start < FusedBlockSize ? n - start : FusedBlockSize;
+        k.apply_operator[op](a + start, b + start, result + start, size);
+        num_errors += k.count_errors(result + start, target + start, size, num_classes);
+        if (max_errors >= 0 && num_errors > max_errors)
+            break;
+        if (hash){  // a block starts on a word (FusedBlockSize values make whole words)
+            size_t first_word = (size_t)start * sizeof(t_value) / 8;
+            size_t end_word = (size_t)(start + size) * sizeof(t_value) / 8;
+            if (end_word > last_word)
+                end_word = last_word;
+            sum += k.hash_words((const unsigned char*)result + 8 * first_word, end_word - first_word, first_word);
+        }
+    }
+    if (hash && n)
+        *hash = finish_hash(sum, result, (size_t)n * sizeof(t_value), ~(uint64_t)0);
+    return num_errors;
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+int fitness(t_tgp_chromosome<t_value> &c, int num_training_data, int *target, int num_classes)
+{
+  return kernels<t_value>().count_errors(c.value, target, num_training_data, num_classes);
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void count_class_errors(const t_value *value, int n, const int *class_target, const int *class_size, int num_classes, int num_errors, int *errors)
+// errors[c] = number of data of class c which are incorrectly classified, knowing the total num_errors.
+// class_target holds the targets once for each class, the data of the other classes having the
+// impossible class num_classes: they are always counted, so the kernel counts the errors of one class
+{
+    int counted = 0;
+    for (int c = 0; c < num_classes - 1; c++){
+        errors[c] = kernels<t_value>().count_errors(value, class_target + (size_t)c * n, n, num_classes) - (n - class_size[c]);
+        counted += errors[c];
+    }
+    errors[num_classes - 1] = num_errors - counted;
+}
+//---------------------------------------------------------------------------
+// evaluation of programs from their lineage
+// the nodes needed by a set of programs (the roots) are compiled into straight-line code, which is
+// executed block by block: a block of values stays in the cache, and is kept only until its last use,
+// so the memory needed does not depend on the number of data
+//---------------------------------------------------------------------------
+#define ProgramBlockSize 256
+
+struct t_instruction{
+    int op;
+    int a, b;          // operands: a slot (>= 0) or the variable j (-1 - j)
+    int result;        // slot
+};
+
+struct t_program{
+    t_instruction *instruction;
+    int num_instructions;
+    int num_slots;     // each slot holds the values of a block
+    int num_outputs;
+    int *output;       // the operand holding the value of each root
+};
+//---------------------------------------------------------------------------
+void compile_program(t_program &program, t_lineage &lineage, const int *root, int num_roots)
+// the instructions are in the order of a depth-first traversal, so the operands are computed first;
+// a slot is reused as soon as the value it holds is not needed anymore
+{
+  int num_nodes = lineage.num_nodes;
+  char *state = new char[num_nodes];   // 0 = not visited, 1 = parents pushed, 2 = compiled
+  int *num_uses = new int[num_nodes];  // uses by compiled nodes and roots which are not compiled yet
+  int *slot = new int[num_nodes];
+  int *order = new int[num_nodes];
+  int *stack = new int[num_roots + 2 * num_nodes];
+  memset(state, 0, num_nodes);
+  memset(num_uses, 0, num_nodes * sizeof(int));
+
+  int num_ordered = 0;
+  for (int r = 0; r < num_roots; r++){
+    if (get_node(lineage, root[r]).op < 0)
+      continue;
+    num_uses[root[r]]++;
+    int top = 0;
+    stack[top++] = root[r];
+    while (top){
+      int node = stack[top - 1];
+      if (state[node] == 0){
+        state[node] = 1;
+        t_lineage_node &x = get_node(lineage, node);
+        int parent[2] = { x.left, x.right };
+        for (int i = 0; i < 2; i++)
+          if (get_node(lineage, parent[i]).op >= 0){
+            num_uses[parent[i]]++;
+            if (!state[parent[i]])
+              stack[top++] = parent[i];
+          }
+      }
+      else{
+        top--;
+        if (state[node] == 1){
+          state[node] = 2;
+          order[num_ordered++] = node;
+        }
+      }
+    }
+  }
+
+  program.instruction = new t_instruction[num_ordered];
+  program.num_instructions = num_ordered;
+  program.num_slots = 0;
+  int *free_slots = stack; // no longer needed as a stack
+  int num_free_slots = 0;
+  for (int i = 0; i < num_ordered; i++){
+    t_lineage_node &x = get_node(lineage, order[i]);
+    t_instruction &instruction = program.instruction[i];
+    instruction.op = x.op;
+    int parent[2] = { x.left, x.right };
+    int *operand[2] = { &instruction.a, &instruction.b };
+    for (int k = 0; k < 2; k++){
+      t_lineage_node &y = get_node(lineage, parent[k]);
+      *operand[k] = y.op < 0 ? -1 - y.left : slot[parent[k]];
+    }
+    for (int k = 0; k < 2; k++) // the result may overwrite an operand: the kernels work element by element
+      if (get_node(lineage, parent[k]).op >= 0 && --num_uses[parent[k]] == 0)
+        free_slots[num_free_slots++] = slot[parent[k]];
+    slot[order[i]] = instruction.result = num_free_slots ? free_slots[--num_free_slots] : program.num_slots++;
+  }
+
+  program.num_outputs = num_roots;
+  program.output = new int[num_roots];
+  for (int r = 0; r < num_roots; r++){
+    t_lineage_node &x = get_node(lineage, root[r]);
+    program.output[r] = x.op < 0 ? -1 - x.left : slot[root[r]];
+  }
+
+  delete[] state;
+  delete[] num_uses;
+  delete[] slot;
+  delete[] order;
+  delete[] stack;
+}
+//---------------------------------------------------------------------------
+void delete_program(t_program &program)
+{
+  delete[] program.instruction;
+  delete[] program.output;
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+inline const t_value* operand_values(int operand, t_value **columns, int offset, t_value *memo)
+// the values of an operand for the current block; the block of variable j starts at columns[j] + offset
+{
+  return operand >= 0 ? memo + (size_t)operand * ProgramBlockSize : columns[-1 - operand] + offset;
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void run_program_block(const t_program &program, t_value **columns, int offset, int size, t_value *memo)
+// executes the program for a block of size <= ProgramBlockSize data; memo holds the slots
+{
+  const t_kernels<t_value, int> &k = kernels<t_value>();
+  for (int i = 0; i < program.num_instructions; i++){
+    const t_instruction &instruction = program.instruction[i];
+    k.apply_operator[instruction.op](operand_values(instruction.a, columns, offset, memo), operand_values(instruction.b, columns, offset, memo),
+                     memo + (size_t)instruction.result * ProgramBlockSize, size);
+  }
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+struct t_program_block{
+    // memory for executing a program block by block
+    t_value *memo;
+    t_value **columns;    // columns of the variables for the current block
+    t_value *converted;   // the variables of the current block, if they must be converted from double
+    int offset;
+};
+//---------------------------------------------------------------------------
+template <typename t_value>
+void allocate_program_block(t_program_block<t_value> &pb, const t_program &program, int num_variables, bool convert)
+{
+    pb.memo = (t_value*)allocate_aligned((size_t)program.num_slots * ProgramBlockSize * sizeof(t_value));
+    pb.columns = new t_value*[num_variables + 1];
+    pb.converted = NULL;
+    if (convert){
+        pb.converted = (t_value*)allocate_aligned((size_t)num_variables * ProgramBlockSize * sizeof(t_value));
+        for (int j = 0; j < num_variables; j++)
+            pb.columns[j] = pb.converted + (size_t)j * ProgramBlockSize;
+    }
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void delete_program_block(t_program_block<t_value> &pb)
+{
+    free_aligned(pb.memo);
+    free_aligned(pb.converted);
+    delete[] pb.columns;
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void load_block(t_program_block<t_value> &pb, t_value **data, double **source, int num_variables, int start, int size)
+// the variables of data start .. start + size - 1 are read from data, or converted from source if data is NULL
+{
+    if (data){
+        for (int j = 0; j < num_variables; j++)
+            pb.columns[j] = data[j];
+        pb.offset = start;
+    }
+    else{
+        for (int j = 0; j < num_variables; j++)
+            convert_values(source[j] + start, pb.columns[j], size);
+        pb.offset = 0;
+    }
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+struct t_program_task{
+    // a program executed on consecutive ranges of data, one range per task
+    const t_program *program;
+    t_value **data;       // the columns of the variables, or NULL
+    double **source;      // if data is NULL, the variables are converted from these columns
+    int num_variables;
+    int num_data;
+    int task_size;        // number of data of a task, multiple of ProgramBlockSize
+    t_value **output;     // if not NULL, output[r] receives the values of root r (unless it is NULL)
+    int *predicted;       // else if not NULL, predicted receives the classes of root 0
+    int *target;          // else num_errors[task] receives the errors of root 0
+    int num_classes;
+    int *num_errors;
+};
+//---------------------------------------------------------------------------
+template <typename t_value>
+void program_task(int task, void *context)
+{
+    t_program_task<t_value> &pt = *(t_program_task<t_value>*)context;
+    const t_program &program = *pt.program;
+    t_program_block<t_value> pb;
+    allocate_program_block(pb, program, pt.num_variables, !pt.data);
+    int end = pt.num_data < (task + 1) * pt.task_size ? pt.num_data : (task + 1) * pt.task_size;
+    int num_errors = 0;
+    for (int start = task * pt.task_size; start < end; start += ProgramBlockSize){
+        int size = end - start < ProgramBlockSize ? end - start : ProgramBlockSize;
+        load_block(pb, pt.data, pt.source, pt.num_variables, start, size);
+        run_program_block(program, pb.columns, pb.offset, size, pb.memo);
+        if (pt.output){
+            for (int r = 0; r < program.num_outputs; r++)
+                if (pt.output[r])
+                    memcpy(pt.output[r] + start, operand_values(program.output[r], pb.columns, pb.offset, pb.memo), size * sizeof(t_value));
+        }
+        else if (pt.predicted){
+            const t_value *value = operand_values(program.output[0], pb.columns, pb.offset, pb.memo);
+            for (int i = 0; i < size; i++)
+                pt.predicted[start + i] = decode_class(value[i], pt.num_classes);
+        }
+        else
+            num_errors += kernels<t_value>().count_errors(operand_values(program.output[0], pb.columns, pb.offset, pb.memo), pt.target + start, size, pt.num_classes);
+    }
+    if (!pt.output && !pt.predicted)
+        pt.num_errors[task] = num_errors;
+    delete_program_block(pb);
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void init_variable_fitness(int *variable_fitness, uint64_t *variable_hash, t_value **data, int num_variables, int num_data, int *target, int num_classes)
+// an inserted program is a single variable: its fitness and its hash are computed once (for each subset)
+{
+  for (int j = 0; j < num_variables; j++){
+    t_tgp_chromosome<t_value> c;
+    c.value = data[j];
+    variable_fitness[j] = fitness(c, num_data, target, num_classes);
+    variable_hash[j] = hash_values(kernels<t_value>(), data[j], (size_t)num_data * sizeof(t_value));
+  }
+}
+//---------------------------------------------------------------------------
+struct t_barrier{
+    std::mutex mutex;
+    std::condition_variable all_arrived;
+    int num_threads;
+    int num_waiting;
+    int phase;                   // incremented each time all threads have arrived
+};
+//---------------------------------------------------------------------------
+void release_barrier(t_barrier &b)
+// called with the mutex held, when all threads have arrived
+{
+    b.num_waiting = 0;
+    b.phase++;
+    b.all_arrived.notify_all();
+}
+//---------------------------------------------------------------------------
+void wait_barrier(t_barrier &b)
+{
+    std::unique_lock<std::mutex> lock(b.mutex);
+    int phase = b.phase;
+    if (++b.num_waiting == b.num_threads)
+        release_barrier(b);
+    else
+        while (phase == b.phase)
+            b.all_arrived.wait(lock);
+}
+//---------------------------------------------------------------------------
+struct t_elite_tracking;
+
+template <typename t_value>
+struct t_tgp_run : t_gp_run<t_value>{
+    // the data shared by all islands
+    double **training_data;
+    int *target;
+    int num_training_data, num_classes;
+    bool hashing;                // the values of the individuals are hashed (semantic cache)
+
+    // the data seen by the individuals, converted to the type of values: all training data, or the current
+    // subset with subset-sampled fitness. in the latter case, training_data and target are read only when
+    // a subset is loaded or when the best individual is evaluated on all data
+    t_value **active_data;       // the variable buffers point to these columns
+    int *active_target;
+    int num_active_data;
+    int num_chunks;              // chunks of the training data
+    int *chunk_errors;           // errors of the best individual on each chunk, at the last evaluation on all data
+    int *chunk_age;              // number of subsets since each chunk was used
+    t_tgp_population<t_value> **current_pop; // the current population of each island, read while the subset changes
+                                 // or the lineage is collected (NULL when the island has ended)
+    t_elite_tracking **elite_tracking; // the programs followed by each island, read while the lineage is collected
+    t_barrier barrier;           // the islands change the subset or collect the lineage together; its threads
+                                 // are the islands which have not ended
+    int *full_fitness;           // fitness of the best individual of each island on all data, at the end of the run
+    int *double_fitness;         // precision report: the same, computed with double values
+    int *num_changed;            // precision report: number of data classified differently with double values
+    int *class_target;           // multiobjective: the active targets once for each class (see count_class_errors)
+    int *class_size;             // multiobjective: number of active data of each class
+
+    int *best_node;              // if a model is saved: lineage node of the best individual of each island at the end of the run
+    t_checkpoint_writer *checkpoint; // NULL if no checkpoints are written
+    t_snapshot_reader *resume;   // the snapshot to resume from, after its header (NULL for a new run)
+
+    t_data_set validation, test;
+    int *validation_fitness;     // smallest validation fitness of the best individuals of each island
+    int *validation_generation;  // generation where it was reached
+    int *test_fitness;           // test fitness of the program kept by each island
+    std::atomic<bool> stop;      // set by the first island which stops early
+    bool stopping;               // with subsets: the value of stop seen by all islands at the last change of subset
+};
+//---------------------------------------------------------------------------
+template <typename t_value>
+void init_class_targets(t_tgp_run<t_value> &run)
+// for a new active data; the memory is allocated by the first call
+{
+    int n = run.num_active_data, num_classes = run.num_classes;
+    if (!run.class_target){
+        run.class_target = new int[(size_t)num_classes * n];
+        run.class_size = new int[num_classes];
+    }
+    for (int c = 0; c < num_classes; c++){
+        int *class_target = run.class_target + (size_t)c * n;
+        run.class_size[c] = 0;
+        for (int i = 0; i < n; i++){
+            class_target[i] = run.active_target[i] == c ? c : num_classes;
+            run.class_size[c] += run.active_target[i] == c;
+        }
+    }
+}
+//---------------------------------------------------------------------------
+// subset-sampled fitness
+//---------------------------------------------------------------------------
+#define SubsetAgeExponent 3.5    // weight of a chunk = errors + age ^ SubsetAgeExponent (Gathercole and Ross)
+//---------------------------------------------------------------------------
+template <typename t_value>
+struct t_subset_task{
+    t_tgp_run<t_value> *run;
+    int chunk_size;
+    int *chunk;           // chunks of the subset, in increasing order
+};
+//---------------------------------------------------------------------------
+template <typename t_value>
+void copy_chunk_task(int i, void *context)
+// copies the ith chunk of the subset; the chunks of the subset are read in the order of the file
+{
+    t_subset_task<t_value> &st = *(t_subset_task<t_value>*)context;
+    t_tgp_run<t_value> &run = *st.run;
+    int first = st.chunk[i] * st.chunk_size;
+    int size = run.num_training_data - first < st.chunk_size ? run.num_training_data - first : st.chunk_size;
+    int position = i * st.chunk_size; // only the last chunk of the training data can be incomplete, and it is the last one of the subset
+    for (int j = 0; j < run.num_variables; j++)
+        convert_values(run.training_data[j] + first, run.active_data[j] + position, size);
+    memcpy(run.active_target + position, run.target + first, size * sizeof(int));
+}
+//---------------------------------------------------------------------------
+struct t_key_compare{
+  const double *key;
+  bool operator()(int a, int b) const { return key[a] > key[b] || (key[a] == key[b] && a < b); }
+};
+//---------------------------------------------------------------------------
+template <typename t_value>
+void load_subset(t_tgp_parameters &parameters, t_tgp_run<t_value> &run, int generation, t_thread_pool &threads)
+// chooses the chunks of the new subset (weighted random sampling without replacement) and reads them
+{
+    int chunk_size = parameters.subset_chunk_size;
+    int num_subset_chunks = (parameters.subset_size + chunk_size - 1) / chunk_size;
+    if (num_subset_chunks > run.num_chunks)
+        num_subset_chunks = run.num_chunks;
+
+    // a chunk of weight w gets the key log(u) / w; the largest keys are chosen
+    double *key = new double[run.num_chunks];
+    int *chunk = new int[run.num_chunks];
+    for (int c = 0; c < run.num_chunks; c++){
+        t_random r;
+        init_random(r, parameters.seed, -1 - generation, c);
+        double weight = 1;
+        if (parameters.subset_selection == SubsetDynamic)
+            weight = run.chunk_errors[c] + pow((double)run.chunk_age[c], SubsetAgeExponent);
+        key[c] = log(1 - random_double(r)) / weight;
+        chunk[c] = c;
+    }
+    t_key_compare compare = { key };
+    std::partial_sort(chunk, chunk + num_subset_chunks, chunk + run.num_chunks, compare);
+    std::sort(chunk, chunk + num_subset_chunks);
+
+    for (int c = 0; c < run.num_chunks; c++)
+        run.chunk_age[c]++;
+    run.num_active_data = 0;
+    for (int i = 0; i < num_subset_chunks; i++){
+        run.chunk_age[chunk[i]] = 1;
+        int first = chunk[i] * chunk_size;
+        run.num_active_data += run.num_training_data - first < chunk_size ? run.num_training_data - first : chunk_size;
+    }
+
+    t_subset_task<t_value> st;
+    st.run = &run;
+    st.chunk_size = chunk_size;
+    st.chunk = chunk;
+    parallel_for(threads, 0, num_subset_chunks, copy_chunk_task<t_value>, &st);
+    delete[] key;
+    delete[] chunk;
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+int full_fitness(t_tgp_chromosome<t_value> &c, t_tgp_parameters &parameters, t_tgp_run<t_value> &run, t_thread_pool &threads, int *chunk_errors)
+// evaluates c on all training data; chunk_errors receives the errors on each chunk
+{
+    t_program program;
+    compile_program(program, *run.lineage, &c.node, 1);
+    t_program_task<t_value> pt;
+    pt.program = &program;
+    pt.data = training_columns<t_value>(run.training_data);
+    pt.source = run.training_data;
+    pt.num_variables = run.num_variables;
+    pt.num_data = run.num_training_data;
+    pt.task_size = parameters.subset_chunk_size;
+    pt.output = NULL;
+    pt.predicted = NULL;
+    pt.target = run.target;
+    pt.num_classes = run.num_classes;
+    pt.num_errors = chunk_errors;
+    parallel_for(threads, 0, run.num_chunks, program_task<t_value>, &pt);
+    delete_program(program);
+
+    int num_errors = 0;
+    for (int i = 0; i < run.num_chunks; i++)
+        num_errors += chunk_errors[i];
+    return num_errors;
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+struct t_evaluation_task{
+    t_tgp_population<t_value> *pop;
+    int *first;           // an individual with each program
+    t_tgp_run<t_value> *run;
+};
+//---------------------------------------------------------------------------
+template <typename t_value>
+void subset_fitness_task(int r, void *context)
+{
+    t_evaluation_task<t_value> &et = *(t_evaluation_task<t_value>*)context;
+    t_tgp_run<t_value> &run = *et.run;
+    int k = et.first[r];
+    t_tgp_chromosome<t_value> &c = et.pop->chromosome[k];
+    et.pop->fitness[k] = fitness(c, run.num_active_data, run.active_target, run.num_classes);
+    if (et.pop->objectives) // the depth does not change
+        count_class_errors(c.value, run.num_active_data, run.class_target, run.class_size, run.num_classes, et.pop->fitness[k],
+                           et.pop->objectives + k * (run.num_classes + 1));
+    if (run.hashing)
+        c.hash = hash_values(kernels<t_value>(), c.value, (size_t)run.num_active_data * sizeof(t_value));
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+struct t_node_compare{
+  const t_tgp_chromosome<t_value> *chromosome;
+  bool operator()(int a, int b) const { return chromosome[a].node < chromosome[b].node || (chromosome[a].node == chromosome[b].node && a < b); }
+};
+//---------------------------------------------------------------------------
+template <typename t_value>
+void evaluate_on_subset(t_tgp_population<t_value> &pop, int pop_size, t_tgp_run<t_value> &run, t_thread_pool &threads)
+// computes the values of all individuals on the new subset, from their lineage;
+// each program is computed once, and the individuals with the same program share the buffer
+{
+    int *index = new int[pop_size];
+    for (int i = 0; i < pop_size; i++)
+        index[i] = i;
+    t_node_compare<t_value> compare = { pop.chromosome };
+    std::sort(index, index + pop_size, compare);
+    int *root = new int[pop_size];
+    int *first = new int[pop_size];
+    int *program_of = new int[pop_size]; // root of each individual
+    int num_roots = 0;
+    for (int i = 0; i < pop_size; i++){
+        if (!i || pop.chromosome[index[i]].node != root[num_roots - 1]){
+            root[num_roots] = pop.chromosome[index[i]].node;
+            first[num_roots++] = index[i];
+        }
+        program_of[index[i]] = num_roots - 1;
+    }
+
+    t_program program;
+    compile_program(program, *run.lineage, root, num_roots);
+    // the values on the old subset are released first, so the new ones fit in the pool of a single population (in place)
+    for (int i = 0; i < pop_size; i++){
+        t_tgp_chromosome<t_value> &c = pop.chromosome[i];
+        if (c.buffer >= 0)
+            release_buffer(run.pool, c.buffer);
+        c.value = NULL;
+        c.buffer = -1;
+    }
+    int *buffer = new int[num_roots];
+    t_value **output = new t_value*[num_roots];
+    for (int r = 0; r < num_roots; r++){
+        int operand = program.output[r];
+        if (operand < 0){ // a variable: its buffer holds the subset already
+            buffer[r] = run.variable_buffer[-1 - operand];
+            run.pool.ref_count[buffer[r]]++;
+            output[r] = NULL;
+        }
+        else{
+            buffer[r] = acquire_buffer(run.pool);
+            output[r] = run.pool.buffer[buffer[r]];
+        }
+    }
+
+    t_program_task<t_value> pt;
+    pt.program = &program;
+    pt.data = run.active_data;
+    pt.source = NULL;
+    pt.num_variables = run.num_variables;
+    pt.num_data = run.num_active_data;
+    pt.task_size = 16 * ProgramBlockSize;
+    pt.output = output;
+    pt.predicted = NULL;
+    if (program.num_instructions)
+        parallel_for(threads, 0, (run.num_active_data + pt.task_size - 1) / pt.task_size, program_task<t_value>, &pt);
+
+    for (int i = 0; i < pop_size; i++)
+        share_buffer(pop.chromosome[i], run.pool, buffer[program_of[i]]);
+    for (int r = 0; r < num_roots; r++)
+        release_buffer(run.pool, buffer[r]);
+
+    t_evaluation_task<t_value> et;
+    et.pop = &pop;
+    et.first = first;
+    et.run = &run;
+    parallel_for(threads, 0, num_roots, subset_fitness_task<t_value>, &et);
+    for (int i = 0; i < pop_size; i++){
+        pop.fitness[i] = pop.fitness[first[program_of[i]]];
+        pop.chromosome[i].hash = pop.chromosome[first[program_of[i]]].hash;
+        if (pop.objectives)
+            memcpy(pop.objectives + i * (run.num_classes + 1), pop.objectives + first[program_of[i]] * (run.num_classes + 1), run.num_classes * sizeof(int));
+    }
+    find_best(pop, pop_size);
+
+    delete_program(program);
+    delete[] index;
+    delete[] root;
+    delete[] first;
+    delete[] program_of;
+    delete[] buffer;
+    delete[] output;
+}
+//---------------------------------------------------------------------------
+// precision report
+// the double run keeps the semantics of the values of the run: after each instruction, its values are
+// limited as t_value would limit them, so that only the precision differs (fixed point saturates and gives
+// 0 for 0 / 0, float overflows to Inf)
+//---------------------------------------------------------------------------
+template <typename t_value>
+void limit_to_range(double *, int)
+{
+}
+//---------------------------------------------------------------------------
+template <>
+void limit_to_range<float>(double *x, int n)
+{
+    const double largest = std::numeric_limits<float>::max();
+    for (int i = 0; i < n; i++)
+        if (x[i] > largest || x[i] < -largest)
+            x[i] = x[i] > 0 ? std::numeric_limits<double>::infinity() : -std::numeric_limits<double>::infinity();
+}
+//---------------------------------------------------------------------------
+template <>
+void limit_to_range<int16_t>(double *x, int n)
+// fixed point has no -0 either, which would change the sign of a division by 0
+{
+    const double lowest = (double)INT16_MIN / FixedPointOne, highest = (double)INT16_MAX / FixedPointOne;
+    for (int i = 0; i < n; i++)
+        x[i] = x[i] != x[i] ? 0 : (x[i] < lowest ? lowest : (x[i] > highest ? highest : x[i] + 0.0));
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void run_reference_block(const t_program &program, double **columns, int size, double *memo)
+// run_program_block with double values limited to the range of t_value; the columns start at the block
+{
+    const t_kernels<double, int> &k = kernels<double>();
+    for (int i = 0; i < program.num_instructions; i++){
+        const t_instruction &instruction = program.instruction[i];
+        double *result = memo + (size_t)instruction.result * ProgramBlockSize;
+        k.apply_operator[instruction.op](operand_values(instruction.a, columns, 0, memo), operand_values(instruction.b, columns, 0, memo), result, size);
+        limit_to_range<t_value>(result, size);
+    }
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+struct t_precision_task{
+    const t_program *program;
+    t_tgp_run<t_value> *run;
+    int task_size;
+    int *num_errors, *num_double_errors, *num_changed;  // for each task
+};
+//---------------------------------------------------------------------------
+template <typename t_value>
+void precision_task(int task, void *context)
+// the program is executed with the type of values of the run and with double values in their range
+{
+    t_precision_task<t_value> &pt = *(t_precision_task<t_value>*)context;
+    const t_program &program = *pt.program;
+    t_tgp_run<t_value> &run = *pt.run;
+    t_value **data = training_columns<t_value>(run.training_data);
+    t_program_block<t_value> pb;
+    t_program_block<double> pd;
+    allocate_program_block(pb, program, run.num_variables, !data);
+    allocate_program_block(pd, program, run.num_variables, true);
+    int end = run.num_training_data < (task + 1) * pt.task_size ? run.num_training_data : (task + 1) * pt.task_size;
+    int num_errors = 0, num_double_errors = 0, num_changed = 0;
+    for (int start = task * pt.task_size; start < end; start += ProgramBlockSize){
+        int size = end - start < ProgramBlockSize ? end - start : ProgramBlockSize;
+        load_block(pb, data, run.training_data, run.num_variables, start, size);
+        run_program_block(program, pb.columns, pb.offset, size, pb.memo);
+        load_block(pd, (double**)NULL, run.training_data, run.num_variables, start, size);
+        for (int j = 0; j < run.num_variables; j++)
+            limit_to_range<t_value>(pd.columns[j], size);
+        run_reference_block<t_value>(program, pd.columns, size, pd.memo);
+        const t_value *value = operand_values(program.output[0], pb.columns, pb.offset, pb.memo);
+        const double *double_value = operand_values(program.output[0], pd.columns, pd.offset, pd.memo);
+        for (int i = 0; i < size; i++){
+            int actual_class = decode_class(value[i], run.num_classes);
+            int double_class = decode_class(double_value[i], run.num_classes);
+            num_errors += actual_class != run.target[start + i];
+            num_double_errors += double_class != run.target[start + i];
+            num_changed += actual_class != double_class;
+        }
+    }
+    pt.num_errors[task] = num_errors;
+    pt.num_double_errors[task] = num_double_errors;
+    pt.num_changed[task] = num_changed;
+    delete_program_block(pb);
+    delete_program_block(pd);
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void precision_report(t_tgp_chromosome<t_value> &c, t_tgp_run<t_value> &run, t_thread_pool &threads, int island)
+// evaluates c on all training data, with its type of values and with doubles in their range
+{
+    t_program program;
+    compile_program(program, *run.lineage, &c.node, 1);
+    t_precision_task<t_value> pt;
+    pt.program = &program;
+    pt.run = &run;
+    pt.task_size = 16 * ProgramBlockSize;
+    int num_tasks = (run.num_training_data + pt.task_size - 1) / pt.task_size;
+    pt.num_errors = new int[num_tasks];
+    pt.num_double_errors = new int[num_tasks];
+    pt.num_changed = new int[num_tasks];
+    parallel_for(threads, 0, num_tasks, precision_task<t_value>, &pt);
+    run.full_fitness[island] = run.double_fitness[island] = run.num_changed[island] = 0;
+    for (int i = 0; i < num_tasks; i++){
+        run.full_fitness[island] += pt.num_errors[i];
+        run.double_fitness[island] += pt.num_double_errors[i];
+        run.num_changed[island] += pt.num_changed[i];
+    }
+    delete[] pt.num_errors;
+    delete[] pt.num_double_errors;
+    delete[] pt.num_changed;
+    delete_program(program);
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void print_full_fitness(t_tgp_parameters &parameters, t_tgp_run<t_value> &run, int island)
+{
+    printf("full data fitness (num incorrect classified) = %d\n", run.full_fitness[island]);
+    if (parameters.precision_report){
+        static const char *value_type_names[] = { "double", "float", "fixed point" };
+        double accuracy = 100.0 * (run.num_training_data - run.full_fitness[island]) / run.num_training_data;
+        double double_accuracy = 100.0 * (run.num_training_data - run.double_fitness[island]) / run.num_training_data;
+        printf("precision report: accuracy with %s values = %.4f%%, with double values in their range = %.4f%% (shift = %+.4f%%), class changed on %d data\n",
+               value_type_names[parameters.value_type], accuracy, double_accuracy, accuracy - double_accuracy, run.num_changed[island]);
+    }
+}
+//---------------------------------------------------------------------------
+// models
+// a model is the compiled best program, saved in a text file:
+//   TGP model version <ModelVersion>
+//   values <double, float or fixed>
+//   variables <n> classes <k>
+//   instructions <m> slots <s> output <operand>
+// followed by m lines "op a b result"; op is the index of the operator in t_arithmetic_operators
+// (0 = +, 1 = -, 2 = *, 3 = /, then pdiv, sqrt, log, exp, sin, abs, min, max, if) and the operands are coded
+// as in t_instruction.
+// a one-vs-rest model has a line "one_vs_rest <argmax or confidence>" after the classes, then the
+// program of each class, preceded by "class <c> errors <training errors of the program>".
+// the version changes with the format; a model of another version (or without one) is not read.
+//---------------------------------------------------------------------------
+#define ModelVersion 2  // the models saved before the version was written are version 1
+//---------------------------------------------------------------------------
+struct t_model{
+    t_program *program;  // a single output each; one program, or one per class with one-vs-rest
+    int num_programs;
+    int combination;     // one-vs-rest: OvrArgmax or OvrConfidence
+    int *class_errors;   // one-vs-rest: training errors of the program of each class (NULL otherwise)
+    int value_type;      // the model is executed with the values of the run which built it
+    int num_variables;
+    int num_classes;
+};
+//---------------------------------------------------------------------------
+static const char *value_type_keywords[] = { "double", "float", "fixed" };
+static const char *combination_keywords[] = { "argmax", "confidence" };
+//---------------------------------------------------------------------------
+void write_program(FILE *f, const t_program &program)
+{
+    fprintf(f, "instructions %d slots %d output %d\n", program.num_instructions, program.num_slots, program.output[0]);
+    for (int i = 0; i < program.num_instructions; i++){
+        const t_instruction &instruction = program.instruction[i];
+        fprintf(f, "%d %d %d %d\n", instruction.op, instruction.a, instruction.b, instruction.result);
+    }
+}
+//---------------------------------------------------------------------------
+bool save_model(const char *filename, const t_model &model)
+{
+    FILE *f = fopen(filename, "w");
+    if (!f)
+        return false;
+    fprintf(f, "TGP model version %d\n", ModelVersion);
+    fprintf(f, "values %s\n", value_type_keywords[model.value_type]);
+    fprintf(f, "variables %d classes %d\n", model.num_variables, model.num_classes);
+    if (model.class_errors)
+        fprintf(f, "one_vs_rest %s\n", combination_keywords[model.combination]);
+    for (int c = 0; c < model.num_programs; c++){
+        if (model.class_errors)
+            fprintf(f, "class %d errors %d\n", c, model.class_errors[c]);
+        write_program(f, model.program[c]);
+    }
+    return fclose(f) == 0;
+}
+//---------------------------------------------------------------------------
+void delete_model(t_model &model)
+{
+    for (int c = 0; c < model.num_programs; c++)
+        delete_program(model.program[c]);
+    delete[] model.program;
+    delete[] model.class_errors;
+}
+//---------------------------------------------------------------------------
+bool read_program(FILE *f, t_program &program, int num_variables)
+// a slot must be written before it is read, so a program which is read can be executed safely
+{
+    int output;
+    program.instruction = NULL;
+    program.num_outputs = 1;
+    program.output = new int[1];
+    bool ok = fscanf(f, " instructions %d slots %d output %d", &program.num_instructions, &program.num_slots, &output) == 3 &&
+              program.num_instructions >= 0 && program.num_slots >= 0 && program.num_slots <= program.num_instructions;
+    if (!ok){
+        program.num_instructions = 0;
+        return false;
+    }
+
+    program.instruction = new t_instruction[program.num_instructions];
+    program.output[0] = output;
+    char *written = new char[program.num_slots + 1];
+    memset(written, 0, program.num_slots + 1);
+    for (int i = 0; ok && i < program.num_instructions; i++){
+        t_instruction &instruction = program.instruction[i];
+        ok = fscanf(f, "%d %d %d %d", &instruction.op, &instruction.a, &instruction.b, &instruction.result) == 4 &&
+             instruction.op >= 0 && instruction.op < t_arithmetic_operators::size &&
+             instruction.a >= -num_variables && instruction.a < program.num_slots && (instruction.a < 0 || written[instruction.a]) &&
+             instruction.b >= -num_variables && instruction.b < program.num_slots && (instruction.b < 0 || written[instruction.b]) &&
+             instruction.result >= 0 && instruction.result < program.num_slots;
+        if (ok)
+            written[instruction.result] = 1;
+    }
+    ok = ok && output >= -num_variables && output < program.num_slots && (output < 0 || written[output]);
+    delete[] written;
+    return ok;
+}
+//---------------------------------------------------------------------------
+bool load_model(const char *filename, t_model &model)
+{
+    FILE *f = fopen(filename, "r");
+    if (!f)
+        return false;
+    char values[16], combination[16];
+    model.program = NULL;
+    model.num_programs = 0;
+    model.class_errors = NULL;
+    int magic_length = 0, version = 1; // without a version, the model is version 1
+    if (fscanf(f, " TGP model%n", &magic_length) == EOF || magic_length == 0){
+        fclose(f);
+        return false;
+    }
+    if (fscanf(f, " version %d", &version) != 1)
+        version = 1;
+    if (version != ModelVersion){
+        printf("%s is a model of version %d, but only version %d is read!\n", filename, version, ModelVersion);
+        fclose(f);
+        return false;
+    }
+    bool ok = fscanf(f, " values %15s variables %d classes %d", values, &model.num_variables, &model.num_classes) == 3;
+    model.value_type = -1;
+    for (int t = 0; ok && t < 3; t++)
+        if (!strcmp(values, value_type_keywords[t]))
+            model.value_type = t;
+    ok = ok && model.value_type >= 0 && model.num_variables > 0 && model.num_classes > 0;
+    model.combination = -1;
+    if (ok && fscanf(f, " one_vs_rest %15s", combination) == 1){
+        for (int c = 0; c < 2; c++)
+            if (!strcmp(combination, combination_keywords[c]))
+                model.combination = c;
+        ok = model.combination >= 0;
+        model.class_errors = new int[model.num_classes];
+    }
+    if (!ok){
+        fclose(f);
+        delete[] model.class_errors;
+        return false;
+    }
+
+    int num_programs = model.class_errors ? model.num_classes : 1;
+    model.program = new t_program[num_programs];
+    for (int c = 0; ok && c < num_programs; c++){
+        int label;
+        if (model.class_errors)
+            ok = fscanf(f, " class %d errors %d", &label, &model.class_errors[c]) == 2 && label == c;
+        if (ok){
+            model.num_programs++; // the program is deleted with the model, even if it is not read completely
+            ok = read_program(f, model.program[c], model.num_variables);
+        }
+    }
+    fclose(f);
+    if (!ok)
+        delete_model(model);
+    return ok;
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void save_best_program(t_tgp_parameters &parameters, t_tgp_run<t_value> &run, int island)
+// the program of the best individual of the island is rebuilt from its lineage
+{
+    t_model model;
+    model.program = new t_program[1];
+    model.num_programs = 1;
+    model.class_errors = NULL;
+    model.value_type = parameters.value_type;
+    model.num_variables = run.num_variables;
+    model.num_classes = run.num_classes;
+    compile_program(model.program[0], *run.lineage, &run.best_node[island], 1);
+    if (save_model(parameters.model_file, model))
+        printf("model saved in %s (%d instructions)\n", parameters.model_file, model.program[0].num_instructions);
+    else
+        printf("Cannot write %s!\n", parameters.model_file);
+    delete_model(model);
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+int combine_outputs(const t_value *output, int stride, const t_model &model)
+// the class of a data from the outputs of the one-vs-rest programs; output[c * stride] is the output of
+// the program of class c. a program claims a data when its output is nearer to 1 than to 0
+{
+    int best = -1;
+    if (model.combination == OvrConfidence)
+        for (int c = 0; c < model.num_programs; c++)
+            if (decode_class(output[c * stride], 2) == 1 && (best < 0 || model.class_errors[c] < model.class_errors[best]))
+                best = c;
+    if (best < 0){
+        best = 0;
+        for (int c = 1; c < model.num_programs; c++)
+            if (output[c * stride] > output[best * stride])
+                best = c;
+    }
+    return best;
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+struct t_one_vs_rest_task{
+    // the programs of a one-vs-rest model executed on consecutive ranges of data, one range per task
+    const t_model *model;
+    t_value **data;       // the columns of the variables, or NULL
+    double **source;      // if data is NULL, the variables are converted from these columns
+    int num_data;
+    int task_size;        // number of data of a task, multiple of ProgramBlockSize
+    int *predicted;
+};
+//---------------------------------------------------------------------------
+template <typename t_value>
+void one_vs_rest_task(int task, void *context)
+// the variables of a block are loaded once for all programs; the outputs of the programs are kept
+// side by side until the block is classified
+{
+    t_one_vs_rest_task<t_value> &ot = *(t_one_vs_rest_task<t_value>*)context;
+    const t_model &model = *ot.model;
+    int largest = 0; // the memo must hold the slots of any program
+    for (int c = 1; c < model.num_programs; c++)
+        if (model.program[c].num_slots > model.program[largest].num_slots)
+            largest = c;
+    t_program_block<t_value> pb;
+    allocate_program_block(pb, model.program[largest], model.num_variables, !ot.data);
+    t_value *output = new t_value[(size_t)model.num_programs * ProgramBlockSize];
+    int end = ot.num_data < (task + 1) * ot.task_size ? ot.num_data : (task + 1) * ot.task_size;
+    for (int start = task * ot.task_size; start < end; start += ProgramBlockSize){
+        int size = end - start < ProgramBlockSize ? end - start : ProgramBlockSize;
+        load_block(pb, ot.data, ot.source, model.num_variables, start, size);
+        for (int c = 0; c < model.num_programs; c++){
+            const t_program &program = model.program[c];
+            run_program_block(program, pb.columns, pb.offset, size, pb.memo);
+            memcpy(output + (size_t)c * ProgramBlockSize, operand_values(program.output[0], pb.columns, pb.offset, pb.memo), size * sizeof(t_value));
+        }
+        for (int i = 0; i < size; i++)
+            ot.predicted[start + i] = combine_outputs(output + i, ProgramBlockSize, model);
+    }
+    delete[] output;
+    delete_program_block(pb);
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void predict(const t_model &model, double **data, int num_data, int *predicted, int num_threads)
+// the classes of the data are computed block by block, by all threads
+{
+    t_thread_pool threads;
+    start_thread_pool(threads, num_threads);
+    int task_size = 16 * ProgramBlockSize;
+    int num_tasks = (num_data + task_size - 1) / task_size;
+    if (model.class_errors){
+        t_one_vs_rest_task<t_value> ot;
+        ot.model = &model;
+        ot.data = training_columns<t_value>(data);
+        ot.source = data;
+        ot.num_data = num_data;
+        ot.task_size = task_size;
+        ot.predicted = predicted;
+        parallel_for(threads, 0, num_tasks, one_vs_rest_task<t_value>, &ot);
+    }
+    else{
+        t_program_task<t_value> pt;
+        pt.program = &model.program[0];
+        pt.data = training_columns<t_value>(data);
+        pt.source = data;
+        pt.num_variables = model.num_variables;
+        pt.num_data = num_data;
+        pt.task_size = task_size;
+        pt.output = NULL;
+        pt.predicted = predicted;
+        pt.target = NULL;
+        pt.num_classes = model.num_classes;
+        pt.num_errors = NULL;
+        parallel_for(threads, 0, num_tasks, program_task<t_value>, &pt);
+    }
+    stop_thread_pool(threads);
+}
+//---------------------------------------------------------------------------
+// validation, test and early stopping
+//---------------------------------------------------------------------------
+struct t_elite_tracking{
+    // state of an island: its best individuals are followed through their lineage nodes, which are kept
+    // when the lineage is collected
+    int best_fitness;            // best fitness watched by the patience, and the generation it was reached
+    int last_improvement;
+    int validated_node;          // the last best individual evaluated on the validation data (-1 if none)
+    int validation_fitness;      // its validation fitness
+    int best_validation_node;    // the best individual with the smallest validation fitness (-1 if none)
+    int best_validation_fitness;
+    int best_validation_generation;
+};
+//---------------------------------------------------------------------------
+template <typename t_value>
+int program_errors(const t_program &program, t_value **data, double **source, int num_variables, int num_data, int *target, int num_classes, t_thread_pool &threads)
+// the program is executed on the data; if data is NULL, the variables are converted from source
+{
+    t_program_task<t_value> pt;
+    pt.program = &program;
+    pt.data = data;
+    pt.source = source;
+    pt.num_variables = num_variables;
+    pt.num_data = num_data;
+    pt.task_size = 16 * ProgramBlockSize;
+    pt.output = NULL;
+    pt.predicted = NULL;
+    pt.target = target;
+    pt.num_classes = num_classes;
+    int num_tasks = (num_data + pt.task_size - 1) / pt.task_size;
+    pt.num_errors = new int[num_tasks];
+    parallel_for(threads, 0, num_tasks, program_task<t_value>, &pt);
+    int num_errors = 0;
+    for (int i = 0; i < num_tasks; i++)
+        num_errors += pt.num_errors[i];
+    delete[] pt.num_errors;
+    return num_errors;
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+int data_set_errors(t_tgp_run<t_value> &run, int node, const t_data_set &set, t_thread_pool &threads)
+// the program of node is compiled and executed on the data set
+{
+    t_program program;
+    compile_program(program, *run.lineage, &node, 1);
+    int num_errors = program_errors(program, training_columns<t_value>(set.data), set.data, run.num_variables, set.num_data, set.target, run.num_classes, threads);
+    delete_program(program);
+    return num_errors;
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void validate_best(t_tgp_run<t_value> &run, t_elite_tracking &et, int node, int generation, t_thread_pool &threads)
+// the best individual is evaluated on the validation data, unless it did not change since the last time
+{
+    if (node == et.validated_node)
+        return;
+    et.validated_node = node;
+    et.validation_fitness = data_set_errors(run, node, run.validation, threads);
+    if (et.best_validation_node < 0 || et.validation_fitness < et.best_validation_fitness){
+        et.best_validation_node = node;
+        et.best_validation_fitness = et.best_fitness = et.validation_fitness;
+        et.best_validation_generation = et.last_improvement = generation;
+    }
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+const char* early_stop(t_tgp_parameters &parameters, t_tgp_run<t_value> &run, t_elite_tracking &et, t_tgp_population<t_value> &pop, int generation, t_thread_pool &threads)
+// called at the end of each generation; returns why the island should stop, or NULL
+{
+    int fitness = pop.fitness[pop.best];
+    if (run.validation.num_data){
+        if (generation % parameters.validation_interval == 0)
+            validate_best(run, et, pop.chromosome[pop.best].node, generation, threads);
+    }
+    else if (fitness < et.best_fitness){
+        et.best_fitness = fitness;
+        et.last_improvement = generation;
+    }
+    if (parameters.target_fitness >= 0 && fitness <= parameters.target_fitness)
+        return "target fitness reached";
+    if (parameters.patience > 0 && generation - et.last_improvement >= parameters.patience)
+        return run.validation.num_data ? "no improvement on validation data" : "no improvement";
+    return NULL;
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void print_generalization(t_tgp_run<t_value> &run, int island)
+{
+    if (run.validation.num_data)
+        printf("validation fitness (num incorrect classified) = %d at generation %d\n", run.validation_fitness[island], run.validation_generation[island]);
+    if (run.test.num_data)
+        printf("test fitness (num incorrect classified) = %d\n", run.test_fitness[island]);
+}
+//---------------------------------------------------------------------------
+// collection of the lineage
+//---------------------------------------------------------------------------
+template <typename t_value>
+void collect_run_lineage(t_tgp_parameters &parameters, t_tgp_run<t_value> &run)
+// called while the islands which have not ended wait: the nodes needed are those of their populations, of the
+// programs they follow, of the migrants and of the programs kept by the islands which have ended. the nodes of
+// the new populations are not needed: they are written before being read again
+{
+    int num_islands = parameters.num_islands > 1 ? parameters.num_islands : 1;
+    int **root = new int*[num_islands * (parameters.pop_size + 2) + num_islands * num_islands * run.queue_capacity];
+    int num_roots = 0;
+    for (int i = 0; i < num_islands; i++)
+        if (run.current_pop[i]){
+            for (int k = 0; k < parameters.pop_size; k++)
+                root[num_roots++] = &run.current_pop[i]->chromosome[k].node;
+            root[num_roots++] = &run.elite_tracking[i]->validated_node;
+            root[num_roots++] = &run.elite_tracking[i]->best_validation_node;
+        }
+        else if (run.best_node)
+            root[num_roots++] = &run.best_node[i];
+    for (int q = 0; q < num_islands * num_islands; q++){
+        t_migration_queue<t_migrant> &queue = run.queues[q];
+        for (unsigned int m = queue.head; m != queue.tail; m++)
+            root[num_roots++] = &queue.migrants[m % queue.capacity].node;
+    }
+    collect_lineage_garbage(*run.lineage, root, num_roots);
+    delete[] root;
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void collect_lineage_together(t_tgp_parameters &parameters, t_tgp_run<t_value> &run)
+// at the start of a generation, when the lineage has grown enough (without subsets): the last island which
+// arrives collects the lineage while the others wait
+{
+    t_barrier &b = run.barrier;
+    std::unique_lock<std::mutex> lock(b.mutex);
+    int phase = b.phase;
+    if (++b.num_waiting == b.num_threads){
+        collect_run_lineage(parameters, run);
+        release_barrier(b);
+    }
+    else
+        while (phase == b.phase)
+            b.all_arrived.wait(lock);
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void end_island_lineage(t_tgp_parameters &parameters, t_tgp_run<t_value> &run, int island)
+// the island does not read the lineage anymore: the others do not wait for it to collect the lineage, and only
+// the node of its kept program is needed
+{
+    t_barrier &b = run.barrier;
+    std::lock_guard<std::mutex> lock(b.mutex);
+    run.current_pop[island] = NULL;
+    if (--b.num_threads && b.num_waiting == b.num_threads){
+        collect_run_lineage(parameters, run);
+        release_barrier(b);
+    }
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+bool change_subset(t_tgp_parameters &parameters, t_tgp_run<t_value> &run, int island, int generation, t_tgp_population<t_value> &current_pop, t_tgp_population<t_value> &new_pop, t_thread_pool &threads)
+// called by all islands at the same generation; returns false if the islands stop
+{
+    // new_pop is built again from scratch: its values are not needed (there is none in place)
+    if (!parameters.in_place)
+        release_chromosomes(new_pop, parameters.pop_size, run.pool);
+    wait_barrier(run.barrier);
+    if (island == 0)
+        run.stopping = run.stop; // the other islands are waiting: they all see this value after the barrier
+    if (island == 0 && !run.stopping){
+        int num_islands = run.barrier.num_threads;
+        if (parameters.full_evaluation_interval > 0 && generation % parameters.full_evaluation_interval == 0){
+            int best = 0;
+            for (int i = 1; i < num_islands; i++)
+                if (run.current_pop[i]->fitness[run.current_pop[i]->best] < run.current_pop[best]->fitness[run.current_pop[best]->best])
+                    best = i;
+            t_tgp_population<t_value> &pop = *run.current_pop[best];
+            if (parameters.label)
+                printf("%s", parameters.label);
+            printf("generation = %d full data fitness (num incorrect classified) = %d\n", generation, full_fitness(pop.chromosome[pop.best], parameters, run, threads, run.chunk_errors));
+        }
+        // the migrants in the queues have the values of the old subset
+        for (int q = 0; q < num_islands * num_islands; q++){
+            t_migrant m;
+            while (pop_migrant(run.queues[q], m))
+                release_migrant(run, m);
+        }
+        load_subset(parameters, run, generation, threads);
+        init_variable_fitness(run.variable_fitness, run.variable_hash, run.active_data, run.num_variables, run.num_active_data, run.active_target, run.num_classes);
+        if (run.class_target)
+            init_class_targets(run);
+        // the islands stop only here, so the lineage is collected here too
+        if (run.lineage && run.lineage->num_nodes >= run.lineage->collect_at)
+            collect_run_lineage(parameters, run);
+    }
+    wait_barrier(run.barrier);
+    if (run.stopping)
+        return false;
+    evaluate_on_subset(current_pop, parameters.pop_size, run, threads);
+    return true;
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void print_pareto_front(t_tgp_parameters &parameters, t_multiobjective &mo, t_tgp_population<t_value> &pop, int island)
+// the distinct objectives of the first front of pop, with the fewest errors first, in a single printf
+// (the classes of one-vs-rest print concurrently)
+{
+    rank_population(mo, pop, parameters.pop_size);
+    int m = mo.num_objectives, n = 0;
+    for (int i = 0; i < parameters.pop_size; i++)
+        if (mo.front[i] == 0)
+            mo.order[n++] = i;
+    t_lexicographic_compare compare = { pop.objectives, m };
+    std::sort(mo.order, mo.order + n, compare);
+    int num_distinct = 0;
+    for (int i = 0; i < n; i++)
+        if (!i || memcmp(pop.objectives + mo.order[i] * m, pop.objectives + mo.order[i - 1] * m, m * sizeof(int)))
+            mo.fitness[num_distinct++] = mo.order[i];
+    t_rank_compare by_errors = { pop.fitness };
+    std::sort(mo.fitness, mo.fitness + num_distinct, by_errors);
+
+    size_t size = 128 + (size_t)MaxParetoPrinted * (12 * m + 32), length = 0;
+    char *text = new char[size];
+    length += snprintf(text + length, size - length, "%s", parameters.label ? parameters.label : "");
+    if (parameters.num_islands > 1)
+        length += snprintf(text + length, size - length, "island = %d ", island);
+    length += snprintf(text + length, size - length, "pareto front = %d individuals, %d distinct\n", n, num_distinct);
+    for (int i = 0; i < num_distinct && i < MaxParetoPrinted; i++){
+        const int *objectives = pop.objectives + mo.fitness[i] * m;
+        length += snprintf(text + length, size - length, "    errors = %d (", pop.fitness[mo.fitness[i]]);
+        for (int c = 0; c < m - 1; c++)
+            length += snprintf(text + length, size - length, c ? " %d" : "%d", objectives[c]);
+        length += snprintf(text + length, size - length, ") depth = %d\n", objectives[m - 1]);
+    }
+    printf("%s", text);
+    delete[] text;
+}
+//---------------------------------------------------------------------------
+// checkpoints (see tgp_engine.h)
+// a snapshot is taken at the end of a generation. the new population is built again from scratch by
+// the next generation, so only the current population is saved, with the values of each buffer once
+// and no values for the variables. the lineage is saved compacted: only the ancestors of the living
+// programs, renumbered after the variables, parents first. a snapshot contains, after its header:
+//   with subsets: the active data, their targets and the statistics of the chunks
+//   with the lineage: the nodes (op, left, right)
+//   the population: best, worst fitness, then fitness, hash, source of the values (and node) of each
+//   individual, then the values which are not shared
+//   the state of the early stopping
+//---------------------------------------------------------------------------
+struct t_snapshot_header{
+    char magic[8];
+    int value_type, num_variables, num_classes, num_training_data;
+    int pop_size, subset_size, subset_chunk_size;
+    unsigned int seed;
+    unsigned int functions;
+    int lineage;                 // 1 if the lineage is saved
+    int generation;              // the snapshot is taken at the end of this generation
+};
+//---------------------------------------------------------------------------
+template <typename t_value>
+void make_snapshot_header(t_snapshot_header &h, t_tgp_parameters &parameters, t_tgp_run<t_value> &run, bool lineage, int generation)
+{
+    memcpy(h.magic, SnapshotMagic, sizeof(h.magic));
+    h.value_type = parameters.value_type;
+    h.num_variables = run.num_variables;
+    h.num_classes = run.num_classes;
+    h.num_training_data = run.num_training_data;
+    h.pop_size = parameters.pop_size;
+    h.subset_size = parameters.subset_size;
+    h.subset_chunk_size = parameters.subset_size > 0 ? parameters.subset_chunk_size : 0;
+    h.seed = parameters.seed;
+    h.functions = parameters.functions;
+    h.lineage = lineage;
+    h.generation = generation;
+}
+//---------------------------------------------------------------------------
+int collect_lineage(t_lineage &lineage, const int *root, int num_roots, int *position, int *order)
+// the nodes needed by the roots, except the variables, in an order where the parents come first;
+// position[node] receives the index of node in order, and must be -1 for all nodes before
+{
+  int *stack = new int[num_roots + 2 * lineage.num_nodes];
+  int num_ordered = 0;
+  for (int r = 0; r < num_roots; r++){
+    if (root[r] < lineage.num_variables || position[root[r]] != -1)
+      continue;
+    int top = 0;
+    stack[top++] = root[r];
+    while (top){
+      int node = stack[top - 1];
+      if (position[node] == -1){
+        position[node] = -2; // parents pushed
+        t_lineage_node &x = get_node(lineage, node);
+        int parent[2] = { x.left, x.right };
+        for (int i = 0; i < 2; i++)
+          if (parent[i] >= lineage.num_variables && position[parent[i]] == -1)
+            stack[top++] = parent[i];
+      }
+      else{
+        top--;
+        if (position[node] == -2){
+          position[node] = num_ordered;
+          order[num_ordered++] = node;
+        }
+      }
+    }
+  }
+  delete[] stack;
+  return num_ordered;
+}
+//---------------------------------------------------------------------------
+inline int encode_node(int node, int num_variables, const int *position)
+// -1, a variable, or num_variables + the index of the node in the snapshot
+{
+    return node < num_variables ? node : num_variables + position[node];
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void save_snapshot(t_tgp_parameters &parameters, t_tgp_run<t_value> &run, t_tgp_population<t_value> &pop, t_elite_tracking &et, int generation)
+{
+    int pop_size = parameters.pop_size;
+    int num_variables = run.num_variables;
+    size_t num_values = run.num_active_data;
+    bool subsets = parameters.subset_size > 0;
+    t_value_pool<t_value> &pool = run.pool;
+
+    // the source of the values of an individual: -1 - j for the variable j, else the first individual with the same buffer
+    int *source = new int[pop_size];
+    int *first_user = new int[pool.num_buffers];
+    for (int b = 0; b < pool.num_buffers; b++)
+        first_user[b] = -1;
+    int num_own = 0;
+    for (int i = 0; i < pop_size; i++){
+        int b = pop.chromosome[i].buffer;
+        if (b >= pool.num_buffers)
+            source[i] = -1 - (b - pool.num_buffers); // the external buffers are the variables, in order
+        else{
+            if (first_user[b] < 0){
+                first_user[b] = i;
+                num_own++;
+            }
+            source[i] = first_user[b];
+        }
+    }
+
+    int num_nodes = 0;
+    int *position = NULL, *order = NULL;
+    if (run.lineage){
+        t_lineage &lineage = *run.lineage;
+        position = new int[lineage.num_nodes];
+        order = new int[lineage.num_nodes];
+        for (int n = 0; n < lineage.num_nodes; n++)
+            position[n] = -1;
+        int *root = new int[pop_size + 2];
+        for (int i = 0; i < pop_size; i++)
+            root[i] = pop.chromosome[i].node;
+        root[pop_size] = et.validated_node;
+        root[pop_size + 1] = et.best_validation_node;
+        num_nodes = collect_lineage(lineage, root, pop_size + 2, position, order);
+        delete[] root;
+    }
+
+    size_t size = sizeof(t_snapshot_header) + 2 * sizeof(int) + pop_size * (2 * sizeof(int) + sizeof(uint64_t)) +
+                  num_own * num_values * sizeof(t_value) + 7 * sizeof(int);
+    if (subsets)
+        size += sizeof(int) + 2 * run.num_chunks * sizeof(int) + num_values * (sizeof(int) + num_variables * sizeof(t_value));
+    if (run.lineage)
+        size += (1 + 3 * (size_t)num_nodes + pop_size) * sizeof(int);
+    char *start = begin_snapshot(*run.checkpoint, size);
+    char *p = start;
+
+    t_snapshot_header h;
+    make_snapshot_header(h, parameters, run, run.lineage != NULL, generation);
+    put_value(p, h);
+    if (subsets){
+        put_value(p, run.num_active_data);
+        put_bytes(p, run.chunk_errors, run.num_chunks * sizeof(int));
+        put_bytes(p, run.chunk_age, run.num_chunks * sizeof(int));
+        put_bytes(p, run.active_target, num_values * sizeof(int));
+        for (int j = 0; j < num_variables; j++)
+            put_bytes(p, run.active_data[j], num_values * sizeof(t_value));
+    }
+    if (run.lineage){
+        put_value(p, num_nodes);
+        for (int k = 0; k < num_nodes; k++){
+            t_lineage_node &x = get_node(*run.lineage, order[k]);
+            put_value(p, x.op);
+            put_value(p, encode_node(x.left, num_variables, position));
+            put_value(p, encode_node(x.right, num_variables, position));
+        }
+    }
+    put_value(p, pop.best);
+    put_value(p, pop.worst_fitness);
+    for (int i = 0; i < pop_size; i++){
+        put_value(p, pop.fitness[i]);
+        put_value(p, pop.chromosome[i].hash);
+        put_value(p, source[i]);
+        if (run.lineage)
+            put_value(p, encode_node(pop.chromosome[i].node, num_variables, position));
+    }
+    for (int i = 0; i < pop_size; i++)
+        if (source[i] == i)
+            put_bytes(p, pop.chromosome[i].value, num_values * sizeof(t_value));
+    put_value(p, et.best_fitness);
+    put_value(p, et.last_improvement);
+    put_value(p, run.lineage ? encode_node(et.validated_node, num_variables, position) : -1);
+    put_value(p, et.validation_fitness);
+    put_value(p, run.lineage ? encode_node(et.best_validation_node, num_variables, position) : -1);
+    put_value(p, et.best_validation_fitness);
+    put_value(p, et.best_validation_generation);
+    end_snapshot(*run.checkpoint);
+
+    delete[] source;
+    delete[] first_user;
+    delete[] position;
+    delete[] order;
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+bool open_snapshot(t_tgp_parameters &parameters, t_tgp_run<t_value> &run, bool lineage, t_mapped_file &mf, t_snapshot_reader &r)
+// maps the snapshot to resume from, and checks that it was taken by a run like this one
+{
+    if (!map_file(parameters.resume_file, mf)){
+        printf("Cannot read %s!\n", parameters.resume_file);
+        return false;
+    }
+    r.p = mf.data;
+    r.end = mf.data + mf.size;
+    r.ok = true;
+    t_snapshot_header h = get_value<t_snapshot_header>(r), expected;
+    make_snapshot_header(expected, parameters, run, lineage, h.generation);
+    r.p = mf.data; // restore_snapshot reads the header again
+    if (!r.ok || memcmp(&h, &expected, sizeof(h))){
+        printf("%s is not a snapshot of a run with these data and parameters!\n", parameters.resume_file);
+        unmap_file(mf);
+        return false;
+    }
+    printf("resuming from %s at generation %d\n", parameters.resume_file, h.generation);
+    return true;
+}
+//---------------------------------------------------------------------------
+inline int decode_node(int code, int num_variables, const int *node, int num_nodes, t_snapshot_reader &r)
+// a node of the snapshot must be a variable or a node read before
+{
+    if (code < -1 || code >= num_variables + num_nodes){
+        r.ok = false;
+        return 0;
+    }
+    return code < num_variables ? code : node[code - num_variables];
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+int restore_snapshot(t_tgp_parameters &parameters, t_tgp_run<t_value> &run, t_tgp_population<t_value> &pop, t_elite_tracking &et)
+// the inverse of save_snapshot, at the start of the run; returns the generation of the snapshot
+{
+    t_snapshot_reader &r = *run.resume;
+    int pop_size = parameters.pop_size;
+    int num_variables = run.num_variables;
+    t_value_pool<t_value> &pool = run.pool;
+    t_snapshot_header h = get_value<t_snapshot_header>(r);
+    if (parameters.subset_size > 0){
+        run.num_active_data = get_value<int>(r);
+        if (run.num_active_data <= 0 || run.num_active_data > parameters.subset_size)
+            r.ok = false;
+        else{
+            get_bytes(r, run.chunk_errors, run.num_chunks * sizeof(int));
+            get_bytes(r, run.chunk_age, run.num_chunks * sizeof(int));
+            get_bytes(r, run.active_target, run.num_active_data * sizeof(int));
+            for (int j = 0; j < num_variables; j++)
+                get_bytes(r, run.active_data[j], run.num_active_data * sizeof(t_value));
+            init_variable_fitness(run.variable_fitness, run.variable_hash, run.active_data, num_variables, run.num_active_data, run.active_target, run.num_classes);
+        }
+    }
+    size_t num_values = run.num_active_data;
+
+    int num_nodes = 0;
+    int *node = NULL;
+    if (run.lineage){
+        num_nodes = get_value<int>(r);
+        if (num_nodes < 0 || (size_t)num_nodes > (size_t)(r.end - r.p) / (3 * sizeof(int))){
+            r.ok = false;
+            num_nodes = 0;
+        }
+        node = new int[num_nodes];
+        int first = reserve_nodes(*run.lineage, num_nodes);
+        for (int k = 0; k < num_nodes; k++){
+            int op = get_value<int>(r);
+            int left = decode_node(get_value<int>(r), num_variables, node, k, r);
+            int right = decode_node(get_value<int>(r), num_variables, node, k, r);
+            if (op < 0 || op >= t_arithmetic_operators::size || left < 0 || right < 0)
+                r.ok = false;
+            node[k] = set_node(*run.lineage, first + k, r.ok ? op : 0, r.ok ? left : 0, r.ok ? right : 0);
+        }
+    }
+
+    pop.best = get_value<int>(r);
+    pop.worst_fitness = get_value<int>(r);
+    int *source = new int[pop_size];
+    for (int i = 0; i < pop_size; i++){
+        t_tgp_chromosome<t_value> &c = pop.chromosome[i];
+        pop.fitness[i] = get_value<int>(r);
+        c.hash = get_value<uint64_t>(r);
+        source[i] = get_value<int>(r);
+        if (source[i] < -num_variables || source[i] > i){
+            r.ok = false;
+            source[i] = -1;
+        }
+        if (run.lineage){
+            int x = decode_node(get_value<int>(r), num_variables, node, num_nodes, r);
+            c.node = x >= 0 ? x : 0;
+        }
+    }
+    for (int i = 0; i < pop_size; i++){
+        t_tgp_chromosome<t_value> &c = pop.chromosome[i];
+        if (source[i] < 0)
+            share_buffer(c, pool, run.variable_buffer[-1 - source[i]]);
+        else if (source[i] < i)
+            share_buffer(c, pool, pop.chromosome[source[i]].buffer);
+        else{
+            make_writable(c, pool);
+            get_bytes(r, c.value, num_values * sizeof(t_value));
+        }
+    }
+    if (pop.best < 0 || pop.best >= pop_size)
+        r.ok = false;
+
+    et.best_fitness = get_value<int>(r);
+    et.last_improvement = get_value<int>(r);
+    int validated = get_value<int>(r);
+    et.validation_fitness = get_value<int>(r);
+    int best_validation = get_value<int>(r);
+    et.best_validation_fitness = get_value<int>(r);
+    et.best_validation_generation = get_value<int>(r);
+    et.validated_node = et.best_validation_node = -1;
+    if (run.lineage){
+        et.validated_node = decode_node(validated, num_variables, node, num_nodes, r);
+        et.best_validation_node = decode_node(best_validation, num_variables, node, num_nodes, r);
+    }
+    if (!r.ok || r.p != r.end){
+        printf("%s is damaged!\n", parameters.resume_file);
+        exit(1);
+    }
+    delete[] node;
+    delete[] source;
+    return h.generation;
+}
+//---------------------------------------------------------------------------
+// the problem
+// the GP loop of tgp_engine.h, with the data of a run (subsets, validation, early stopping, checkpoints and
+// the lineage) handled between the generations
+//---------------------------------------------------------------------------
+template <typename t_number>
+struct t_classification : t_gp_problem{
+    typedef t_number t_value;
+    typedef int t_target;
+    typedef t_tgp_parameters t_parameters;
+    typedef t_tgp_run<t_number> t_run;
+    struct t_island_data{
+        t_elite_tracking et;
+        bool tracking;           // the best individual is followed for validation or early stopping
+    };
+
+    static const t_kernels<t_number, int>& kernels(void) { return ::kernels<t_number>(); }
+    static bool unary(int op) { return operator_unary[op]; }
+    static bool commutative(int op) { return operator_commutative[op]; }
+    static int num_objectives(t_tgp_parameters &parameters, t_tgp_run<t_number> &run) { return parameters.multiobjective ? run.num_classes + 1 : 0; }
+    static int evaluate(t_generation<t_classification> &gen, int op, const t_number *a, const t_number *b, t_number *result, uint64_t *hash,
+                        t_phase_clock &clock);
+    static void objectives(t_generation<t_classification> &gen, const t_number *value, int fitness, int *objectives);
+    static int begin_island(t_island<t_classification> &island);
+    static bool begin_generation(t_island<t_classification> &island, int generation);
+    static int max_errors(t_island<t_classification> &island);
+    static void print_generation(t_island<t_classification> &island, int generation);
+    static void end_generation(t_island<t_classification> &island, int generation);
+    static void end_island(t_island<t_classification> &island, int last_generation);
+};
+//---------------------------------------------------------------------------
+template <typename t_number>
+int t_classification<t_number>::evaluate(t_generation<t_classification> &gen, int op, const t_number *a, const t_number *b, t_number *result, uint64_t *hash,
+                                         t_phase_clock &clock)
+// the operator and the counting of errors run in one pass over the data (see apply_operator_and_count_errors)
+{
+    int num_errors = apply_operator_and_count_errors(op, a, b, result, gen.num_data, gen.target, gen.run->num_classes, gen.max_errors, hash);
+    end_phase(clock, PhaseOperators);
+    return num_errors;
+}
+//---------------------------------------------------------------------------
+template <typename t_number>
+void t_classification<t_number>::objectives(t_generation<t_classification> &gen, const t_number *value, int fitness, int *objectives)
+// the errors on each class
+{
+    t_tgp_run<t_number> &run = *gen.run;
+    count_class_errors(value, gen.num_data, run.class_target, run.class_size, run.num_classes, fitness, objectives);
+}
+//---------------------------------------------------------------------------
+template <typename t_number>
+int t_classification<t_number>::begin_island(t_island<t_classification> &island)
+// the first population, or the one of the snapshot to resume from
+{
+    t_tgp_parameters &parameters = *island.parameters;
+    t_tgp_run<t_number> &run = *island.run;
+    t_generation<t_classification> &gen = island.gen;
+    t_elite_tracking &et = island.data.et;
+    gen.target = run.active_target;
+    gen.num_functions = list_functions(parameters.functions, gen.function);
+    island.data.tracking = run.validation.num_data || parameters.patience > 0 || parameters.target_fitness >= 0;
+
+    int last_generation = run.resume ? restore_snapshot(parameters, run, island.current_pop, et) : 0;
+    gen.num_data = gen.num_values = run.num_active_data;
+    if (!run.resume){
+        t_tgp_population<t_number> &pop = island.current_pop;
+        init_population(island);
+        et.best_fitness = pop.fitness[pop.best];
+        et.last_improvement = 0;
+        et.validated_node = et.best_validation_node = -1;
+        if (run.validation.num_data)
+            validate_best(run, et, pop.chromosome[pop.best].node, 0, island.threads);
+    }
+
+    run.current_pop[island.index] = &island.current_pop;
+    run.elite_tracking[island.index] = &et;
+    return last_generation;
+}
+//---------------------------------------------------------------------------
+template <typename t_number>
+bool t_classification<t_number>::begin_generation(t_island<t_classification> &island, int generation)
+// a new subset, or the collection of the lineage; returns false if the island stops
+{
+    t_tgp_parameters &parameters = *island.parameters;
+    t_tgp_run<t_number> &run = *island.run;
+    t_tgp_population<t_number> &current_pop = island.current_pop;
+    if (parameters.subset_size > 0 && generation % parameters.subset_interval == 0){
+        if (!change_subset(parameters, run, island.index, generation, current_pop, island.new_pop, island.threads))
+            return false;
+        island.gen.num_data = island.gen.num_values = run.num_active_data;
+        if (!run.validation.num_data) // the fitness on the new subset is not an improvement
+            island.data.et.best_fitness = current_pop.fitness[current_pop.best];
+        if (island.gen.cache) // the values are those of the old subset
+            clear_semantic_cache(island.cache);
+        if (parameters.multiobjective)
+            rank_population(island.mo, current_pop, parameters.pop_size);
+        end_phase(island.clock, PhaseSubset);
+    }
+    else if (parameters.subset_size == 0){
+        if (run.stop)
+            return false;
+        if (run.lineage && run.lineage->num_nodes >= run.lineage->collect_at){
+            collect_lineage_together(parameters, run);
+            end_phase(island.clock, PhaseLineage);
+        }
+    }
+    return true;
+}
 //---------------------------------------------------------------------------
-struct t_tgp_parameters{
-    int num_generations;
-    int pop_size;                // population size
-    double insertion_probability, crossover_probability;
-};
+template <typename t_number>
+int t_classification<t_number>::max_errors(t_island<t_classification> &island)
+{
+    t_tgp_parameters &parameters = *island.parameters;
+    int max_errors = parameters.max_errors;
+    if (parameters.abort_above_worst && (max_errors < 0 || island.current_pop.worst_fitness < max_errors))
+        max_errors = island.current_pop.worst_fitness;
+    if (parameters.multiobjective) // an offspring with more errors may still be better on a class
+        max_errors = -1;
+    return max_errors;
+}
 //---------------------------------------------------------------------------
-void allocate_training_data(double **&data, int *&target, int num_training_data, int num_variables)
+template <typename t_number>
+void t_classification<t_number>::print_generation(t_island<t_classification> &island, int generation)
 {
-    target = new int[num_training_data];
-    data = new double*[num_training_data];
-    for (int i = 0; i < num_training_data; i++)
-        data[i] = new double[num_variables];
+    t_tgp_parameters &parameters = *island.parameters;
+    t_tgp_population<t_number> &current_pop = island.current_pop;
+    if (parameters.label)
+        printf("%s", parameters.label);
+    if (parameters.num_islands > 1)
+        printf("island = %d ", island.index);
+    printf("generation = %d fitness (num incorrect classified) = %d", generation, current_pop.fitness[current_pop.best]);
+    if (island.run->validation.num_data)
+        printf(" validation fitness = %d", island.data.et.validation_fitness);
+    if (parameters.multiobjective)
+        printf(" pareto front = %d", island.mo.front_size);
+    printf("\n");
 }
 //---------------------------------------------------------------------------
-void delete_data(double **&data, int *&target, int num_training_data)
+template <typename t_number>
+void t_classification<t_number>::end_generation(t_island<t_classification> &island, int generation)
+// early stopping, then the checkpoint
 {
-    if (data)
-        for (int i = 0; i < num_training_data; i++)
-            delete[] data[i];
-    delete[] data;
-    delete[] target;
+    t_tgp_parameters &parameters = *island.parameters;
+    t_tgp_run<t_number> &run = *island.run;
+    t_elite_tracking &et = island.data.et;
+    const char *reason = island.data.tracking && !run.stop ? early_stop(parameters, run, et, island.current_pop, generation, island.threads) : NULL;
+    end_phase(island.clock, PhaseValidation);
+    if (reason){
+        run.stop = true;
+        if (parameters.label)
+            printf("%s", parameters.label);
+        if (parameters.num_islands > 1)
+            printf("island = %d ", island.index);
+        printf("early stop at generation = %d: %s\n", generation, reason);
+    }
+    else if (run.checkpoint && !run.stop && generation % parameters.checkpoint_interval == 0)
+        save_snapshot(parameters, run, island.current_pop, et, generation);
 }
 //---------------------------------------------------------------------------
-void alocate_population(t_tgp_chromosome *&pop, int pop_size, int num_training_data)
+template <typename t_number>
+void t_classification<t_number>::end_island(t_island<t_classification> &island, int last_generation)
+// the program kept at the end: the best one on the validation data, if any
 {
-  pop = new t_tgp_chromosome[pop_size];
-
-  for (int i = 0; i < pop_size; i++)
-    pop[i].value = new double[num_training_data];
+    t_tgp_parameters &parameters = *island.parameters;
+    t_tgp_run<t_number> &run = *island.run;
+    t_tgp_population<t_number> &current_pop = island.current_pop;
+    t_elite_tracking &et = island.data.et;
+    int index = island.index;
+    if (parameters.multiobjective && parameters.print_interval > 0)
+        print_pareto_front(parameters, island.mo, current_pop, index);
+    int kept_node = run.lineage ? current_pop.chromosome[current_pop.best].node : -1;
+    if (run.validation.num_data){
+        validate_best(run, et, kept_node, last_generation, island.threads);
+        kept_node = et.best_validation_node;
+        run.validation_fitness[index] = et.best_validation_fitness;
+        run.validation_generation[index] = et.best_validation_generation;
+    }
+    if (run.test.num_data)
+        run.test_fitness[index] = data_set_errors(run, kept_node, run.test, island.threads);
+    if (parameters.precision_report)
+        precision_report(current_pop.chromosome[current_pop.best], run, island.threads, index);
+    else if (parameters.subset_size > 0){
+        int *chunk_errors = new int[run.num_chunks];
+        run.full_fitness[index] = full_fitness(current_pop.chromosome[current_pop.best], parameters, run, island.threads, chunk_errors);
+        delete[] chunk_errors;
+    }
+    if (run.best_node)
+        run.best_node[index] = kept_node; // kept when the islands which are still evolving collect the lineage
+    if (run.lineage)
+        end_island_lineage(parameters, run, index);
 }
 //---------------------------------------------------------------------------
-void copy_chromosome(t_tgp_chromosome& dest, t_tgp_chromosome& source, int num_training_data)
+template <typename t_value>
+struct t_driver_run{
+    // a run started by a driver: the binary population of a class in one-vs-rest, or a run of a sweep
+    t_value **columns;           // the training data as values, shared by all runs (NULL if they are converted by each run)
+    int *target;                 // in one-vs-rest, 1 for the data of the class, 0 for the others
+    t_data_set validation, test; // with the same targets
+    t_program program;           // the program kept at the end
+    int fitness, validation_fitness, test_fitness; // its errors
+};
+//---------------------------------------------------------------------------
+template <typename t_value>
+void start_tgp(t_tgp_parameters &parameters, double **training_data, int *target, int num_training_data, int num_variables, int num_classes,
+               const t_data_set &validation, const t_data_set &test, t_driver_run<t_value> *driver_run = NULL)
+// with driver_run, the kept program is compiled in driver_run->program instead of being reported
 {
-  for (int i = 0; i < num_training_data; i++)
-    dest.value[i] = source.value[i];
-  dest.fitness = source.fitness;
+    t_tgp_run<t_value> run;
+    run.training_data = training_data;
+    run.target = target;
+    run.num_training_data = num_training_data;
+    run.num_variables = num_variables;
+    run.num_classes = num_classes;
+    run.validation = validation;
+    run.test = test;
+    run.stop = false;
+    run.stopping = false;
+    bool subsets = parameters.subset_size > 0;
+    if (subsets){
+        // the chunks are read in blocks of the evaluation of programs
+        parameters.subset_chunk_size = (parameters.subset_chunk_size + ProgramBlockSize - 1) / ProgramBlockSize * ProgramBlockSize;
+        int subset_size = parameters.subset_size < num_training_data ? parameters.subset_size : num_training_data;
+        parameters.subset_size = (subset_size + parameters.subset_chunk_size - 1) / parameters.subset_chunk_size * parameters.subset_chunk_size;
+    }
+    bool report = subsets || parameters.precision_report; // the best individual is evaluated on all training data at the end
+    bool generalization = validation.num_data || test.num_data;
+    bool lineage = report || parameters.model_file || generalization || driver_run;
+    t_mapped_file resume_file = t_mapped_file();
+    t_snapshot_reader resume;
+    run.resume = NULL;
+    if (parameters.resume_file){
+        if (!open_snapshot(parameters, run, lineage, resume_file, resume))
+            return;
+        run.resume = &resume;
+    }
+    t_checkpoint_writer checkpoint;
+    run.checkpoint = NULL;
+    if (parameters.checkpoint_file){
+        start_checkpoint_writer(checkpoint, parameters.checkpoint_file);
+        run.checkpoint = &checkpoint;
+    }
+    t_telemetry telemetry;
+    run.telemetry = NULL;
+    int function[MaxOperators];
+    const char *function_names[MaxOperators];
+    int num_functions = list_functions(parameters.functions, function);
+    for (int f = 0; f < num_functions; f++)
+        function_names[f] = operator_names[function[f]];
+    if (parameters.telemetry_file){
+        if (start_telemetry(telemetry, parameters.telemetry_file, parameters.hardware_counters, NumPhases, phase_names,
+                            num_functions, function_names))
+            run.telemetry = &telemetry;
+        else
+            printf("Cannot write %s!\n", parameters.telemetry_file);
+    }
+
+    int num_islands = parameters.num_islands > 1 ? parameters.num_islands : 1;
+    run.current_pop = new t_tgp_population<t_value>*[num_islands];
+    run.elite_tracking = new t_elite_tracking*[num_islands];
+    run.barrier.num_threads = num_islands;
+    run.barrier.num_waiting = 0;
+    run.barrier.phase = 0;
+
+    run.lineage = NULL;
+    if (report){
+        run.full_fitness = new int[num_islands];
+        run.double_fitness = new int[num_islands];
+        run.num_changed = new int[num_islands];
+    }
+    if (generalization){
+        run.validation_fitness = new int[num_islands];
+        run.validation_generation = new int[num_islands];
+        run.test_fitness = new int[num_islands];
+    }
+    if (lineage){
+        run.lineage = new t_lineage;
+        allocate_lineage(*run.lineage, num_variables);
+    }
+    run.best_node = parameters.model_file || driver_run ? new int[num_islands] : NULL;
+    if (subsets){
+        run.num_chunks = (num_training_data + parameters.subset_chunk_size - 1) / parameters.subset_chunk_size;
+        run.chunk_errors = new int[run.num_chunks];
+        run.chunk_age = new int[run.num_chunks];
+        for (int c = 0; c < run.num_chunks; c++){
+            run.chunk_errors[c] = 0;
+            run.chunk_age[c] = 1;
+        }
+        allocate_training_data(run.active_data, run.active_target, parameters.subset_size, num_variables);
+        t_thread_pool threads;
+        start_thread_pool(threads, parameters.num_threads);
+        load_subset(parameters, run, 0, threads);
+        stop_thread_pool(threads);
+    }
+    t_value **columns = driver_run && driver_run->columns ? driver_run->columns : training_columns<t_value>(training_data);
+    if (!subsets){
+        run.active_data = columns;
+        run.active_target = target;
+        run.num_active_data = num_training_data;
+        if (!run.active_data){
+            allocate_columns(run.active_data, num_training_data, num_variables);
+            for (int j = 0; j < num_variables; j++)
+                convert_values(training_data[j], run.active_data[j], num_training_data);
+        }
+    }
+
+    run.class_target = run.class_size = NULL;
+    if (parameters.multiobjective)
+        init_class_targets(run);
+
+    start_gp_run(parameters, run, run.active_data, num_variables, subsets ? parameters.subset_size : num_training_data);
+    run.hashing = parameters.semantic_cache;
+    init_variable_fitness(run.variable_fitness, run.variable_hash, run.active_data, num_variables, run.num_active_data, run.active_target, num_classes);
+
+    int best = run_islands<t_classification<t_value> >(parameters, run);
+    if (driver_run){
+        compile_program(driver_run->program, *run.lineage, &run.best_node[best], 1);
+        driver_run->validation_fitness = validation.num_data ? run.validation_fitness[best] : -1;
+        driver_run->test_fitness = test.num_data ? run.test_fitness[best] : -1;
+    }
+    else if (num_islands == 1){
+        if (report)
+            print_full_fitness(parameters, run, 0);
+        print_generalization(run, 0);
+    }
+    else{
+        printf("best island = %d fitness (num incorrect classified) = %d\n", best, run.best_fitness[best]);
+        if (report){
+            printf("best island ");
+            print_full_fitness(parameters, run, best);
+        }
+        if (generalization)
+            printf("best island ");
+        print_generalization(run, best);
+    }
+    if (parameters.model_file)
+        save_best_program(parameters, run, best);
+    delete[] run.best_node;
+
+    stop_gp_run(parameters, run);
+    delete[] run.current_pop;
+    delete[] run.elite_tracking;
+    if (report){
+        delete[] run.full_fitness;
+        delete[] run.double_fitness;
+        delete[] run.num_changed;
+    }
+    if (generalization){
+        delete[] run.validation_fitness;
+        delete[] run.validation_generation;
+        delete[] run.test_fitness;
+    }
+    if (run.lineage){
+        delete_lineage(*run.lineage);
+        delete run.lineage;
+    }
+    if (subsets){
+        delete[] run.chunk_errors;
+        delete[] run.chunk_age;
+        delete_data(run.active_data, run.active_target);
+    }
+    else if (run.active_data != columns)
+        delete_columns(run.active_data);
+    delete[] run.class_target;
+    delete[] run.class_size;
+    if (run.telemetry)
+        stop_telemetry(telemetry);
+    if (run.checkpoint){
+        stop_checkpoint_writer(checkpoint);
+        if (checkpoint.failed)
+            printf("Cannot write %s!\n", parameters.checkpoint_file);
+        printf("checkpoints written = %d\n", checkpoint.num_written);
+    }
+    if (run.resume)
+        unmap_file(resume_file);
 }
 //---------------------------------------------------------------------------
-void fitness(t_tgp_chromosome &c, int num_training_data, int *target, int num_classes)
+template <typename t_value>
+t_value** shared_columns(const t_tgp_parameters &parameters, double **training_data, int num_training_data, int num_variables)
+// the training data converted once for all runs of a driver; NULL with subsets, which are loaded by each run
 {
-  c.fitness = 0;
-  for (int i = 0; i < num_training_data; i++){
-	  // classify it to the nearest class
-	double min = DBL_MAX;
-    int actual_class = -1;
-    for (int k = 0; k < num_classes; k++)
-      if (fabs(c.value[i] - k) < min){
-        min = fabs(c.value[i] - k);
-        actual_class = k;
-      }
-	// found a class for it, now see if it is equal to the real one
-    if (actual_class != target[i])
-      c.fitness++;
-  }
+    if (parameters.subset_size > 0)
+        return NULL;
+    t_value **columns = training_columns<t_value>(training_data);
+    if (!columns){
+        allocate_columns(columns, num_training_data, num_variables);
+        for (int j = 0; j < num_variables; j++)
+            convert_values(training_data[j], columns[j], num_training_data);
+    }
+    return columns;
 }
 //---------------------------------------------------------------------------
-void init_chromosome(t_tgp_chromosome &c, int num_variables, int num_training_data, double ** data)
+template <typename t_value>
+void delete_shared_columns(t_value **columns, double **training_data)
 {
-  int random_var = rand() % num_variables;
-    
-  for (int i = 0; i < num_training_data; i++)
-    c.value[i] = data[i][random_var];
+    if (columns && columns != training_columns<t_value>(training_data))
+        delete_columns(columns);
 }
 //---------------------------------------------------------------------------
-int sort_function(const void *a, const void *b)
+// one-vs-rest decomposition
+// the output of a single program is compared with every class, which becomes hard with many classes:
+// instead, each class has its own binary population, and the classes run concurrently. the training
+// data are read only, so all populations share them; only the binary targets belong to a class
+//---------------------------------------------------------------------------
+template <typename t_value>
+struct t_one_vs_rest{
+    t_tgp_parameters *parameters;  // of the whole run
+    double **training_data;
+    int *target;
+    int num_training_data, num_variables;
+    t_data_set validation, test;
+    t_value **columns;             // the training data as values; NULL with subsets, which are converted by each class
+    int threads_per_class;
+    t_driver_run<t_value> *class_run;
+};
+//---------------------------------------------------------------------------
+int* binary_targets(const int *target, int num_data, int c)
+// 1 for the data of class c, 0 for the others
 {
-  if (((t_tgp_chromosome *)a)->fitness > ((t_tgp_chromosome *)b)->fitness)
-    return 1;
-  else
-    if (((t_tgp_chromosome *)a)->fitness < ((t_tgp_chromosome *)b)->fitness)
-      return -1;
-    else
-    return 0;//!!!
+    int *binary = new int[num_data];
+    for (int i = 0; i < num_data; i++)
+        binary[i] = target[i] == c;
+    return binary;
 }
 //---------------------------------------------------------------------------
-void sort_by_fitness(t_tgp_chromosome *pop, int pop_size)
-// sort ascendingly the individuals in population
+template <typename t_value>
+void class_task(int c, void *context)
+// evolves the binary population of class c with its own threads, then evaluates the kept program on all training data
 {
-  qsort((void *)pop, pop_size, sizeof(pop[0]), sort_function);
+    t_one_vs_rest<t_value> &ovr = *(t_one_vs_rest<t_value>*)context;
+    t_driver_run<t_value> &cr = ovr.class_run[c];
+    t_tgp_parameters parameters = *ovr.parameters;
+    // each class has its own random numbers; a model is saved for all classes at the end
+    parameters.seed = ovr.parameters->seed + c * 0x85EBCA6Bu;
+    parameters.num_threads = ovr.threads_per_class;
+    parameters.model_file = NULL;
+    parameters.telemetry_file = NULL;
+    parameters.checkpoint_file = parameters.resume_file = NULL;
+    parameters.precision_report = false;
+    char label[32];
+    snprintf(label, sizeof(label), "class = %d ", c);
+    parameters.label = label;
+
+    cr.columns = ovr.columns;
+    cr.target = binary_targets(ovr.target, ovr.num_training_data, c);
+    cr.validation = ovr.validation;
+    cr.test = ovr.test;
+    if (cr.validation.num_data)
+        cr.validation.target = binary_targets(ovr.validation.target, ovr.validation.num_data, c);
+    if (cr.test.num_data)
+        cr.test.target = binary_targets(ovr.test.target, ovr.test.num_data, c);
+    start_tgp(parameters, ovr.training_data, cr.target, ovr.num_training_data, ovr.num_variables, 2, cr.validation, cr.test, &cr);
+
+    t_thread_pool threads;
+    start_thread_pool(threads, parameters.num_threads);
+    t_value **data = ovr.columns ? ovr.columns : training_columns<t_value>(ovr.training_data);
+    cr.fitness = program_errors(cr.program, data, ovr.training_data, ovr.num_variables, ovr.num_training_data, cr.target, 2, threads);
+    stop_thread_pool(threads);
+    delete[] cr.target;
+    if (cr.validation.num_data)
+        delete[] cr.validation.target;
+    if (cr.test.num_data)
+        delete[] cr.test.target;
 }
 //---------------------------------------------------------------------------
-void free_pop_memory(t_tgp_chromosome *&pop, int pop_size)
+template <typename t_value>
+int model_errors(const t_model &model, double **data, int *target, int num_data, int num_threads)
 {
-  for (int i = 0; i < pop_size; i++)
-    delete[] pop[i].value;
-  
-  delete[] pop;
+    int *predicted = new int[num_data];
+    predict<t_value>(model, data, num_data, predicted, num_threads);
+    int num_errors = 0;
+    for (int i = 0; i < num_data; i++)
+        num_errors += predicted[i] != target[i];
+    delete[] predicted;
+    return num_errors;
 }
 //---------------------------------------------------------------------------
-int tournament_selection(t_tgp_chromosome *pop, int pop_size, int tournament_size)
+template <typename t_value>
+void start_one_vs_rest(t_tgp_parameters &parameters, double **training_data, int *target, int num_training_data, int num_variables, int num_classes,
+                       const t_data_set &validation, const t_data_set &test)
 {
-    int r, p;
-    p = rand() % pop_size;
-    for (int i = 1; i < tournament_size; i++) {
-        r = rand() % pop_size;
-        p = pop[r].fitness < pop[p].fitness ? r : p;
+    t_one_vs_rest<t_value> ovr;
+    ovr.parameters = &parameters;
+    ovr.training_data = training_data;
+    ovr.target = target;
+    ovr.num_training_data = num_training_data;
+    ovr.num_variables = num_variables;
+    ovr.validation = validation;
+    ovr.test = test;
+    ovr.columns = shared_columns<t_value>(parameters, training_data, num_training_data, num_variables);
+    // the classes are taken by the threads of the pool as they finish, so fast classes do not wait for slow ones
+    int num_running = num_classes < parameters.num_threads ? num_classes : parameters.num_threads;
+    if (num_running < 1)
+        num_running = 1;
+    ovr.threads_per_class = parameters.num_threads / num_running > 1 ? parameters.num_threads / num_running : 1;
+    ovr.class_run = new t_driver_run<t_value>[num_classes];
+    printf("one-vs-rest = %d binary populations, %d at once with %d threads each\n", num_classes, num_running, ovr.threads_per_class);
+
+    t_thread_pool classes;
+    start_thread_pool(classes, num_running);
+    parallel_for(classes, 0, num_classes, class_task<t_value>, &ovr);
+    stop_thread_pool(classes);
+
+    t_model model;
+    model.program = new t_program[num_classes];
+    model.num_programs = num_classes;
+    model.combination = parameters.combination;
+    model.class_errors = new int[num_classes];
+    model.value_type = parameters.value_type;
+    model.num_variables = num_variables;
+    model.num_classes = num_classes;
+    int num_instructions = 0;
+    for (int c = 0; c < num_classes; c++){
+        t_driver_run<t_value> &cr = ovr.class_run[c];
+        printf("class = %d fitness (num incorrect classified) = %d", c, cr.fitness);
+        if (validation.num_data)
+            printf(" validation fitness = %d", cr.validation_fitness);
+        if (test.num_data)
+            printf(" test fitness = %d", cr.test_fitness);
+        printf("\n");
+        model.program[c] = cr.program;
+        model.class_errors[c] = cr.fitness;
+        num_instructions += cr.program.num_instructions;
     }
-    return p;
+
+    printf("one-vs-rest (%s) fitness (num incorrect classified) = %d\n", combination_keywords[parameters.combination],
+           model_errors<t_value>(model, training_data, target, num_training_data, parameters.num_threads));
+    if (validation.num_data)
+        printf("one-vs-rest validation fitness (num incorrect classified) = %d\n",
+               model_errors<t_value>(model, validation.data, validation.target, validation.num_data, parameters.num_threads));
+    if (test.num_data)
+        printf("one-vs-rest test fitness (num incorrect classified) = %d\n",
+               model_errors<t_value>(model, test.data, test.target, test.num_data, parameters.num_threads));
+    if (parameters.model_file){
+        if (save_model(parameters.model_file, model))
+            printf("model saved in %s (%d programs, %d instructions)\n", parameters.model_file, num_classes, num_instructions);
+        else
+            printf("Cannot write %s!\n", parameters.model_file);
+    }
+
+    delete_model(model);
+    delete[] ovr.class_run;
+    delete_shared_columns(ovr.columns, training_data);
 }
 //---------------------------------------------------------------------------
-void start_tgp(t_tgp_parameters &parameters, double **training_data, int *target, int num_training_data, int num_variables, int num_classes)
+// parameter sweeps
+// a sweep runs every combination of the values given in a spec file, each line being a key followed by its
+// values, e.g. "seed 0 1 2 3" or "pop_size 100 1000" (# starts a comment); a key which is not given keeps
+// the value of the command line. the data are read and converted once and shared read only by all runs;
+// the runs are independent, so they are taken by the threads of a pool as they finish, and the row of a
+// run is written in the summary as soon as it ends. the result of a run does not depend on the others
+//---------------------------------------------------------------------------
+#define SweepSeed 0
+#define SweepPopSize 1
+#define SweepNumGenerations 2
+#define SweepInsertionProbability 3
+#define SweepCrossoverProbability 4
+#define NumSweepKeys 5
+#define MaxSweepValues 256
+#define MaxSweepRuns 1000000
+
+const char *sweep_keys[NumSweepKeys] = { "seed", "pop_size", "num_generations", "insertion_probability", "crossover_probability" };
+//---------------------------------------------------------------------------
+struct t_sweep_spec{
+    double values[NumSweepKeys][MaxSweepValues];
+    int num_values[NumSweepKeys];
+    int num_runs;                // the product of the numbers of values; the seed changes fastest
+};
+//---------------------------------------------------------------------------
+bool read_sweep_spec(const char *filename, const t_tgp_parameters &parameters, t_sweep_spec &spec)
+// prints the error and returns false if the spec cannot be used
 {
-    t_tgp_chromosome* current_pop, *new_pop;
-    
-    alocate_population(current_pop, parameters.pop_size, num_training_data);
-    alocate_population(new_pop, parameters.pop_size, num_training_data);
-    for (int i = 0; i < parameters.pop_size; i++){
-        init_chromosome(current_pop[i], num_variables, num_training_data, training_data);
-        fitness(current_pop[i], num_training_data, target, num_classes);
+    FILE *f = fopen(filename, "r");
+    if (!f){
+        printf("Cannot find %s!\n", filename);
+        return false;
     }
-    
-    sort_by_fitness(current_pop, parameters.pop_size);
-    
-    for (int g = 1; g < parameters.num_generations; g++){
-        // elitism: copy best to the new population
-        copy_chromosome(new_pop[0], current_pop[0], num_training_data);
-        int new_pop_size = 1;
-        
-        if (g % 100 == 0)
-            printf("generation = %d fitness (num incorrect classified) = %d\n", g, current_pop[0].fitness);
-        while (new_pop_size < parameters.pop_size){
-            double p = rand() / (double)RAND_MAX;
-            
-            if (p < parameters.insertion_probability){  // insertion of a simple program (made from a single variable)
-                init_chromosome(new_pop[new_pop_size], num_variables, num_training_data, training_data);
-                fitness(new_pop[new_pop_size], num_training_data, target, num_classes);
-                new_pop_size++;
-            }
-            else{  // recombination of 2 programs
-                // first I have to choose an operator
-                int op = rand() % NumberOfOperators;
-                int p1, p2;
-                double ps;
-                switch (op){
-                    case 0: // +
-                        p1 = tournament_selection(current_pop, parameters.pop_size, 1);
-                        p2 = tournament_selection(current_pop, parameters.pop_size, 1);
-                        ps = rand() / (double) RAND_MAX;
-                        if (ps <= parameters.crossover_probability){
-                            
-                                for (int i = 0; i < num_training_data; i++)
-                                    new_pop[new_pop_size].value[i] = current_pop[p1].value[i] + current_pop[p2].value[i];
-                            
-                            
-                            fitness(new_pop[new_pop_size], num_training_data, target, num_classes);
-                            new_pop_size++;
-                        }
-                        else{
-                            // copy one of the parents to the new population
-                            copy_chromosome(new_pop[new_pop_size], current_pop[p1], num_training_data);
-                            new_pop_size++;
-                        }
-                        break;
-                        
-                    case 1: // -
-                        p1 = tournament_selection(current_pop, parameters.pop_size, 1);
-                        p2 = tournament_selection(current_pop, parameters.pop_size, 1);
-                        ps = rand() / (double) RAND_MAX;
-                        if (ps <= parameters.crossover_probability){
-                                for (int i = 0; i < num_training_data; i++)
-                                    new_pop[new_pop_size].value[i] = current_pop[p1].value[i] - current_pop[p2].value[i];
-                          
-                            fitness(new_pop[new_pop_size], num_training_data, target, num_classes);
-                            new_pop_size++;
-                        }
-                        else{
-                            // copy one of the parents to the new population
-                            copy_chromosome(new_pop[new_pop_size], current_pop[p1], num_training_data);
-                            new_pop_size++;
-                        }
-                        break;
-                    case 2: // *
-                        p1 = tournament_selection(current_pop, parameters.pop_size, 1);
-                        p2 = tournament_selection(current_pop, parameters.pop_size, 1);
-                        ps = rand() / (double) RAND_MAX;
-                        if (ps <= parameters.crossover_probability){
-                            
-                                for (int i = 0; i < num_training_data; i++)
-                                    new_pop[new_pop_size].value[i] = current_pop[p1].value[i] * current_pop[p2].value[i];
-                            
-                            fitness(new_pop[new_pop_size], num_training_data, target, num_classes);
-                            new_pop_size++;
-                        }
-                        else{
-                            // copy one of the parents to the new population
-                            copy_chromosome(new_pop[new_pop_size], current_pop[p1], num_training_data);
-                            new_pop_size++;
-                        }
-                        break;
-                    case 3: // /
-                        p1 = tournament_selection(current_pop, parameters.pop_size, 1);
-                        p2 = tournament_selection(current_pop, parameters.pop_size, 1);
-                        ps = rand() / (double) RAND_MAX;
-                        if (ps <= parameters.crossover_probability){
-                            
-                                for (int i = 0; i < num_training_data; i++)
-                                    new_pop[new_pop_size].value[i] = current_pop[p1].value[i] / current_pop[p2].value[i];
-                        
-                            fitness(new_pop[new_pop_size], num_training_data, target, num_classes);
-                            new_pop_size++;
-                        }
-                        else{
-                            // copy one of the parents to the new population
-                            copy_chromosome(new_pop[new_pop_size], current_pop[p1], num_training_data);
-                            new_pop_size++;
-                        }
-                        break;
-                    
-                }// switch
+    for (int k = 0; k < NumSweepKeys; k++)
+        spec.num_values[k] = 0;
+    char line[4096];
+    int line_number = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), f)){
+        line_number++;
+        char *comment = strchr(line, '#');
+        if (comment)
+            *comment = '\0';
+        char *word = strtok(line, " \t\r\n");
+        if (!word)
+            continue;
+        int k = 0;
+        while (k < NumSweepKeys && strcmp(word, sweep_keys[k]))
+            k++;
+        if (k == NumSweepKeys || spec.num_values[k]){
+            printf("%s line %d: %s key %s\n", filename, line_number, k == NumSweepKeys ? "unknown" : "repeated", word);
+            ok = false;
+            break;
+        }
+        while ((word = strtok(NULL, " \t\r\n")) != NULL){
+            char *end;
+            double value = strtod(word, &end);
+            bool integer = k == SweepSeed || k == SweepPopSize || k == SweepNumGenerations;
+            bool valid = *end == '\0' && spec.num_values[k] < MaxSweepValues &&
+                         (integer ? value == floor(value) && value >= (k == SweepSeed ? 0 : 1) && value <= (k == SweepSeed ? UINT_MAX : INT_MAX) :
+                                    value >= 0 && value <= 1);
+            if (!valid){
+                printf("%s line %d: bad value %s for %s\n", filename, line_number, word, sweep_keys[k]);
+                ok = false;
+                break;
             }
+            spec.values[k][spec.num_values[k]++] = value;
+        }
+        if (ok && !spec.num_values[k]){
+            printf("%s line %d: no value for %s\n", filename, line_number, sweep_keys[k]);
+            ok = false;
         }
-        
-        for (int k = 0; k < parameters.pop_size; k++)
-            copy_chromosome(current_pop[k], new_pop[k], num_training_data);
-        sort_by_fitness(current_pop, parameters.pop_size);
+    }
+    fclose(f);
+    if (!ok)
+        return false;
 
+    const double defaults[NumSweepKeys] = { (double)parameters.seed, (double)parameters.pop_size, (double)parameters.num_generations,
+                                            parameters.insertion_probability, parameters.crossover_probability };
+    double num_runs = 1;
+    for (int k = 0; k < NumSweepKeys; k++){
+        if (!spec.num_values[k])
+            spec.values[k][spec.num_values[k]++] = defaults[k];
+        num_runs *= spec.num_values[k];
+    }
+    if (num_runs > MaxSweepRuns){
+        printf("%s: too many runs (%.0f)\n", filename, num_runs);
+        return false;
+    }
+    spec.num_runs = (int)num_runs;
+    return true;
+}
+//---------------------------------------------------------------------------
+void sweep_run_parameters(const t_sweep_spec &spec, int run, t_tgp_parameters &parameters)
+// the parameters of a run of the sweep, given by its index
+{
+    double value[NumSweepKeys];
+    for (int k = 0; k < NumSweepKeys; k++){
+        value[k] = spec.values[k][run % spec.num_values[k]];
+        run /= spec.num_values[k];
     }
+    parameters.seed = (unsigned int)value[SweepSeed];
+    parameters.pop_size = (int)value[SweepPopSize];
+    parameters.num_generations = (int)value[SweepNumGenerations];
+    parameters.insertion_probability = value[SweepInsertionProbability];
+    parameters.crossover_probability = value[SweepCrossoverProbability];
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+struct t_sweep{
+    t_tgp_parameters *parameters;  // of the whole sweep
+    const t_sweep_spec *spec;
+    double **training_data;
+    int *target;
+    int num_training_data, num_variables, num_classes;
+    t_data_set validation, test;
+    t_value **columns;             // the training data as values; NULL with subsets, which are loaded by each run
+    int threads_per_run;
+
+    FILE *summary;
+    bool progress;                 // a line is printed when a run ends (if the summary is not on the standard output)
+    std::mutex mutex;              // for the summary and the progress lines
+    int num_finished;
+};
+//---------------------------------------------------------------------------
+template <typename t_value>
+void sweep_task(int k, void *context)
+// run k of the sweep, with its own threads; the kept program is evaluated on all training data
+{
+    t_sweep<t_value> &sweep = *(t_sweep<t_value>*)context;
+    t_tgp_parameters parameters = *sweep.parameters;
+    sweep_run_parameters(*sweep.spec, k, parameters);
+    parameters.num_threads = sweep.threads_per_run;
+    parameters.print_interval = 0;
+    parameters.precision_report = false;
+    char label[32];
+    snprintf(label, sizeof(label), "run = %d ", k);
+    parameters.label = label;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    t_driver_run<t_value> dr;
+    dr.columns = sweep.columns;
+    dr.target = sweep.target;
+    dr.validation = sweep.validation;
+    dr.test = sweep.test;
+    start_tgp(parameters, sweep.training_data, sweep.target, sweep.num_training_data, sweep.num_variables, sweep.num_classes,
+              sweep.validation, sweep.test, &dr);
+    t_thread_pool threads;
+    start_thread_pool(threads, parameters.num_threads);
+    t_value **data = sweep.columns ? sweep.columns : training_columns<t_value>(sweep.training_data);
+    dr.fitness = program_errors(dr.program, data, sweep.training_data, sweep.num_variables, sweep.num_training_data, sweep.target,
+                                sweep.num_classes, threads);
+    stop_thread_pool(threads);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::lock_guard<std::mutex> lock(sweep.mutex);
+    fprintf(sweep.summary, "%d,%u,%d,%d,%g,%g,%d,%d,%d,%d,%.3f\n", k, parameters.seed, parameters.pop_size, parameters.num_generations,
+            parameters.insertion_probability, parameters.crossover_probability, dr.fitness, dr.validation_fitness, dr.test_fitness,
+            dr.program.num_instructions, seconds);
+    fflush(sweep.summary);
+    sweep.num_finished++;
+    if (sweep.progress)
+        printf("run = %d finished (%d of %d) fitness (num incorrect classified) = %d in %.3f seconds\n", k, sweep.num_finished,
+               sweep.spec->num_runs, dr.fitness, seconds);
+    delete_program(dr.program);
 }
 //---------------------------------------------------------------------------
-bool get_next_field(char *start_sir, char list_separator, char* dest, int & size, int &skip_size)
+template <typename t_value>
+bool start_sweep(t_tgp_parameters &parameters, const t_sweep_spec &spec, const char *summary_file, double **training_data, int *target,
+                 int num_training_data, int num_variables, int num_classes, const t_data_set &validation, const t_data_set &test)
+// the summary has a header and one row per run, in CSV, in the order in which the runs end
 {
-	skip_size = 0;
-	while (start_sir[skip_size] && (start_sir[skip_size] != '\n') && (start_sir[skip_size] == list_separator))
-		skip_size++;// skip separator at the beginning
+    t_sweep<t_value> sweep;
+    sweep.summary = summary_file ? fopen(summary_file, "w") : stdout;
+    if (!sweep.summary){
+        printf("Cannot write %s!\n", summary_file);
+        return false;
+    }
+    sweep.parameters = &parameters;
+    sweep.spec = &spec;
+    sweep.training_data = training_data;
+    sweep.target = target;
+    sweep.num_training_data = num_training_data;
+    sweep.num_variables = num_variables;
+    sweep.num_classes = num_classes;
+    sweep.validation = validation;
+    sweep.test = test;
+    sweep.columns = shared_columns<t_value>(parameters, training_data, num_training_data, num_variables);
+    sweep.progress = summary_file != NULL;
+    sweep.num_finished = 0;
+    // as in one-vs-rest, the threads are shared between the runs executed at once
+    int num_running = spec.num_runs < parameters.num_threads ? spec.num_runs : parameters.num_threads;
+    if (num_running < 1)
+        num_running = 1;
+    sweep.threads_per_run = parameters.num_threads / num_running > 1 ? parameters.num_threads / num_running : 1;
+    printf("sweep = %d runs, %d at once with %d threads each\n", spec.num_runs, num_running, sweep.threads_per_run);
+    fflush(stdout);
+    fprintf(sweep.summary, "run,seed,pop_size,num_generations,insertion_probability,crossover_probability,"
+                           "fitness,validation_fitness,test_fitness,num_instructions,seconds\n");
 
-	size = 0;
-	while (start_sir[skip_size + size] && (start_sir[skip_size + size] != list_separator) && (start_sir[skip_size + size] != '\n')) // run until a find a separator or end of line or new line char
-		size++;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    t_thread_pool runs;
+    start_thread_pool(runs, num_running);
+    parallel_for(runs, 0, spec.num_runs, sweep_task<t_value>, &sweep);
+    stop_thread_pool(runs);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-	if (!size || !start_sir[skip_size + size])
-		return false;
-	strncpy(dest, start_sir + skip_size, size);
-	dest[size] = '\0';
-	return true;
+    bool ok = !ferror(sweep.summary);
+    if (summary_file){
+        ok = fclose(sweep.summary) == 0 && ok;
+        printf(ok ? "summary written in %s\n" : "Cannot write %s!\n", summary_file);
+    }
+    printf("sweep time = %.3f seconds\n", seconds);
+    delete_shared_columns(sweep.columns, training_data);
+    return ok;
+}
+//---------------------------------------------------------------------------
+// loading the training data
+// the file is memory mapped and split in one chunk per thread; each thread counts the rows of its chunk,
+// then, knowing where its first row goes, parses the numbers directly into the columns
+//---------------------------------------------------------------------------
+inline bool is_separator(char c, char list_separator)
+{
+	return c == list_separator || c == ' ' || c == '\t' || c == '\r';
+}
+//---------------------------------------------------------------------------
+const double exact_powers_of_10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+//---------------------------------------------------------------------------
+const char* parse_number(const char *p, const char *end, char list_separator, double &value)
+// locale independent; returns the position after the number or NULL if there is no number at p.
+// only decimal numbers are read: nan, inf and hexadecimal numbers are not, so the row that has one is
+// rejected (the fixed point conversion and the operators expect finite variables).
+// numbers with at most 19 significant digits and a small exponent are computed exactly with a single
+// multiplication or division (they are all exactly representable), giving the same result as strtod;
+// the others are passed to strtod
+{
+	const char *start = p;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+		negative = *p++ == '-';
+	uint64_t mantissa = 0;
+	int num_digits = 0, exponent = 0;
+	bool has_digits = false;
+	while (p < end && *p >= '0' && *p <= '9'){
+		has_digits = true;
+		if (num_digits < 19){
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa)
+				num_digits++;
+		}
+		else
+			exponent++;
+		p++;
+	}
+	if (p < end && *p == '.'){
+		p++;
+		while (p < end && *p >= '0' && *p <= '9'){
+			has_digits = true;
+			if (num_digits < 19){
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa)
+					num_digits++;
+				exponent--;
+			}
+			p++;
+		}
+	}
+	if (!has_digits)
+		return NULL;
+	if (p < end && (*p == 'e' || *p == 'E')){
+		const char *q = p + 1;
+		bool negative_exponent = false;
+		if (q < end && (*q == '-' || *q == '+'))
+			negative_exponent = *q++ == '-';
+		if (q < end && *q >= '0' && *q <= '9'){
+			int e = 0;
+			while (q < end && *q >= '0' && *q <= '9'){
+				if (e < 100000)
+					e = e * 10 + (*q - '0');
+				q++;
+			}
+			exponent += negative_exponent ? -e : e;
+			p = q;
+		}
+	}
+	if (num_digits < 19 && mantissa <= ((uint64_t)1 << 53) && exponent >= -22 && exponent <= 22){
+		value = exponent < 0 ? (double)mantissa / exact_powers_of_10[-exponent] : (double)mantissa * exact_powers_of_10[exponent];
+		if (negative)
+			value = -value;
+		return p;
+	}
+	// slow path: strtod on a copy of the token
+	char token[512];
+	size_t length = 0;
+	while (start + length < end && length < sizeof(token) - 1 && !is_separator(start[length], list_separator) && start[length] != '\n')
+		length++;
+	memcpy(token, start, length);
+	token[length] = '\0';
+	value = strtod(token, NULL);
+	return start + length;
+}
+//---------------------------------------------------------------------------
+int count_fields(const char *p, const char *end, char list_separator)
+// number of fields on the line starting at p
+{
+	int num_fields = 0;
+	while (p < end && *p != '\n'){
+		while (p < end && is_separator(*p, list_separator))
+			p++;
+		if (p == end || *p == '\n')
+			break;
+		num_fields++;
+		while (p < end && *p != '\n' && !is_separator(*p, list_separator))
+			p++;
+	}
+	return num_fields;
 }
-// ---------------------------------------------------------------------------
+//---------------------------------------------------------------------------
+struct t_data_chunk{
+	const char *start, *end;   // start is at the beginning of a line
+	int first_row, num_rows;
+	int bad_row;               // first row (of the chunk) with a wrong number of values; -1 if none
+};
+//---------------------------------------------------------------------------
+void count_rows(t_data_chunk *chunk, char list_separator)
+// rows are the lines with at least one field
+{
+	chunk->num_rows = 0;
+	for (const char *p = chunk->start; p < chunk->end; ){
+		const char *line_end = (const char*)memchr(p, '\n', chunk->end - p);
+		if (!line_end)
+			line_end = chunk->end;
+		for (const char *q = p; q < line_end; q++)
+			if (!is_separator(*q, list_separator)){
+				chunk->num_rows++;
+				break;
+			}
+		p = line_end + 1;
+	}
+}
+//---------------------------------------------------------------------------
+void parse_rows(t_data_chunk *chunk, char list_separator, double **data, int *target, int num_variables)
+{
+	chunk->bad_row = -1;
+	int row = chunk->first_row;
+	const char *p = chunk->start;
+	const char *end = chunk->end;
+	while (p < end){
+		int num_values = 0;
+		double value;
+		for (;;){
+			while (p < end && is_separator(*p, list_separator))
+				p++;
+			if (p == end || *p == '\n')
+				break;
+			const char *next = parse_number(p, end, list_separator, value);
+			if (!next){
+				// not a number: skip the field
+				num_values = num_variables + 2;
+				while (p < end && *p != '\n' && !is_separator(*p, list_separator))
+					p++;
+				continue;
+			}
+			p = next;
+			if (num_values < num_variables)
+				data[num_values][row] = value;
+			else
+				if (num_values == num_variables)
+					target[row] = (int)value;
+			num_values++;
+		}
+		if (num_values){
+			if (num_values != num_variables + 1 && chunk->bad_row < 0)
+				chunk->bad_row = row;
+			row++;
+		}
+		if (p < end)
+			p++; // skip '\n'
+	}
+}
+//---------------------------------------------------------------------------
 bool read_training_data(const char *filename, char list_separator, double **&data, int *&target, int &num_data, int &num_variables)
+// each row has the values of the variables followed by the class; values are separated by list_separator or by blanks
 {
-	FILE* f = fopen(filename, "r");
-	if (!f) {
-		num_data = 0;
+	num_data = 0;
+	num_variables = 0;
+	data = NULL;
+	target = NULL;
+
+	t_mapped_file mf;
+	if (!map_file(filename, mf))
+		return false;
+	const char *begin = mf.data, *end = mf.data + mf.size;
+
+	// the number of variables is given by the first row
+	const char *p = begin;
+	while (p < end && !count_fields(p, end, list_separator)){
+		p = (const char*)memchr(p, '\n', end - p);
+		p = p ? p + 1 : end;
+	}
+	num_variables = count_fields(p, end, list_separator) - 1;
+	if (num_variables < 1){
+		unmap_file(mf);
 		num_variables = 0;
 		return false;
 	}
 
-	char *buf = new char[10000];
-	char * start_buf = buf;
-	// count the number of training data and the number of variables
-	num_data = 0;
-	while (fgets(buf, 10000, f)) {
-		if (strlen(buf) > 1)
-			num_data++;
-		if (num_data == 1) {
-			num_variables = 0;
-
-			char tmp_str[10000];
-			int size;
-			int skip_size;
-			bool result = get_next_field(buf, list_separator, tmp_str, size, skip_size);
-			while (result) {
-				buf = buf + size + 1 + skip_size;
-				result = get_next_field(buf, list_separator, tmp_str, size, skip_size);
-				num_variables++;
-			}
-		}
-		buf = start_buf;
+	// chunks of at least 1 MB, each starting at the beginning of a line
+	int num_chunks = std::thread::hardware_concurrency();
+	if (num_chunks < 1)
+		num_chunks = 1;
+	if (mf.size / num_chunks < (1 << 20))
+		num_chunks = (int)(mf.size >> 20) + 1;
+	t_data_chunk *chunks = new t_data_chunk[num_chunks];
+	const char *chunk_start = begin;
+	for (int c = 0; c < num_chunks; c++){
+		const char *chunk_end = c == num_chunks - 1 ? end : begin + mf.size / num_chunks * (c + 1);
+		if (chunk_end < chunk_start)
+			chunk_end = chunk_start;
+		const char *eol = (const char*)memchr(chunk_end, '\n', end - chunk_end);
+		chunk_end = eol ? eol + 1 : end;
+		chunks[c].start = chunk_start;
+		chunks[c].end = chunk_end;
+		chunk_start = chunk_end;
 	}
-	delete[] start_buf;
-	num_variables--;
-	rewind(f);
 
-	allocate_training_data(data, target, num_data, num_variables);
+	std::thread *threads = new std::thread[num_chunks];
+	for (int c = 1; c < num_chunks; c++)
+		threads[c] = std::thread(count_rows, &chunks[c], list_separator);
+	count_rows(&chunks[0], list_separator);
+	for (int c = 1; c < num_chunks; c++)
+		threads[c].join();
 
-	for (int i = 0; i < num_data; i++) {
-		for (int j = 0; j < num_variables; j++)
-			fscanf(f, "%lf", &data[i][j]);
-		fscanf(f, "%d", &target[i]);
+	for (int c = 0; c < num_chunks; c++){
+		chunks[c].first_row = num_data;
+		num_data += chunks[c].num_rows;
 	}
-	fclose(f);
+	allocate_training_data(data, target, num_data, num_variables);
+
+	for (int c = 1; c < num_chunks; c++)
+		threads[c] = std::thread(parse_rows, &chunks[c], list_separator, data, target, num_variables);
+	parse_rows(&chunks[0], list_separator, data, target, num_variables);
+	for (int c = 1; c < num_chunks; c++)
+		threads[c].join();
 
+	int bad_row = -1;
+	for (int c = 0; c < num_chunks && bad_row < 0; c++)
+		bad_row = chunks[c].bad_row;
+	delete[] threads;
+	delete[] chunks;
+	unmap_file(mf);
+
+	if (bad_row >= 0 || !num_data){
+		if (bad_row >= 0)
+			printf("Row %d does not have %d finite decimal numbers!\n", bad_row + 1, num_variables + 1);
+		else
+			printf("%s has no data!\n", filename);
+		delete_data(data, target);
+		data = NULL;
+		target = NULL;
+		return false;
+	}
 	return true;
 }
 //---------------------------------------------------------------------------
-int main(void)
+void generate_multi_class_data(double **&data, int *&target, int num_data, int num_variables, int num_classes, unsigned int seed)
+// synthetic data: the variables are uniform in [0, 1); the class is given by the weighted mean of the
+// variables (weights 1, 1/2, 1/3 ...), cut into num_classes intervals of the same width
+{
+    allocate_training_data(data, target, num_data, num_variables);
+    double sum_weights = 0;
+    for (int j = 0; j < num_variables; j++)
+        sum_weights += 1.0 / (j + 1);
+    for (int i = 0; i < num_data; i++){
+        t_random r;
+        init_random(r, seed, -1, i);
+        double mean = 0;
+        for (int j = 0; j < num_variables; j++){
+            data[j][i] = random_double(r);
+            mean += data[j][i] / (j + 1);
+        }
+        int c = (int)(mean / sum_weights * num_classes);
+        target[i] = c < num_classes ? c : num_classes - 1;
+    }
+}
+//---------------------------------------------------------------------------
+bool write_training_data(const char *filename, double **data, int *target, int num_data, int num_variables)
+// in text format, as read by read_training_data
+{
+    FILE *f = fopen(filename, "w");
+    if (!f)
+        return false;
+    for (int i = 0; i < num_data; i++){
+        for (int j = 0; j < num_variables; j++)
+            fprintf(f, "%.6f ", data[j][i]);
+        fprintf(f, "%d\n", target[i]);
+    }
+    return fclose(f) == 0;
+}
+//---------------------------------------------------------------------------
+void close_data_set(t_data_set &set, t_mapped_file &mf, bool binary)
+{
+    if (binary)
+        close_binary_data(mf, set.data);
+    else
+        delete_data(set.data, set.target);
+    set.num_data = 0;
+}
+//---------------------------------------------------------------------------
+bool open_data_set(const char *filename, t_data_set &set, t_mapped_file &mf, bool &binary, int num_variables)
+// validation or test data, in text or binary format, with the variables of the training data
+{
+    int num_set_variables, num_classes;
+    binary = is_binary_data_file(filename);
+    if (binary ? !open_binary_data(filename, ElementDouble, mf, set.data, set.target, set.num_data, num_set_variables, num_classes) :
+                 !read_training_data(filename, ' ', set.data, set.target, set.num_data, num_set_variables)){
+        printf("Cannot read %s!\n", filename);
+        return false;
+    }
+    if (num_set_variables != num_variables || !set.num_data){
+        printf("%s has %d data and %d variables, the training data have %d variables!\n", filename, set.num_data, num_set_variables, num_variables);
+        close_data_set(set, mf, binary);
+        return false;
+    }
+    return true;
+}
+//---------------------------------------------------------------------------
+bool classify_data(const char *model_file, const char *output_file, double **data, int *target, int num_data, int num_variables, int num_threads)
+{
+    t_model model;
+    if (!load_model(model_file, model)){
+        printf("Cannot read model %s!\n", model_file);
+        return false;
+    }
+    if (model.num_variables != num_variables){
+        printf("The model needs %d variables, the data have %d!\n", model.num_variables, num_variables);
+        delete_model(model);
+        return false;
+    }
+
+    int *predicted = new int[num_data];
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    switch (model.value_type){
+        case ValueDouble:
+            predict<double>(model, data, num_data, predicted, num_threads);
+            break;
+        case ValueFloat:
+            predict<float>(model, data, num_data, predicted, num_threads);
+            break;
+        case ValueFixed:
+            warn_outside_fixed_range("input", data, num_data, num_variables);
+            predict<int16_t>(model, data, num_data, predicted, num_threads);
+            break;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int num_errors = 0;
+    for (int i = 0; i < num_data; i++)
+        num_errors += predicted[i] != target[i];
+    printf("num data = %d\n", num_data);
+    int num_instructions = 0;
+    for (int c = 0; c < model.num_programs; c++)
+        num_instructions += model.program[c].num_instructions;
+    if (model.class_errors)
+        printf("model = one-vs-rest (%s), %d programs, %d instructions, %s values\n", combination_keywords[model.combination],
+               model.num_programs, num_instructions, value_type_keywords[model.value_type]);
+    else
+        printf("model = %d instructions, %s values\n", num_instructions, value_type_keywords[model.value_type]);
+    printf("accuracy = %.4f%% (num incorrect classified = %d)\n", 100.0 * (num_data - num_errors) / num_data, num_errors);
+    printf("prediction time = %.3f s (%.1f million data per second)\n", seconds, num_data / seconds * 1e-6);
+
+    bool ok = true;
+    if (output_file){
+        FILE *f = fopen(output_file, "w");
+        ok = f != NULL;
+        if (ok){
+            for (int i = 0; i < num_data; i++)
+                fprintf(f, "%d\n", predicted[i]);
+            ok = fclose(f) == 0;
+        }
+        printf(ok ? "%s written\n" : "Cannot write %s!\n", output_file);
+    }
+    delete[] predicted;
+    delete_model(model);
+    return ok;
+}
+//---------------------------------------------------------------------------
+// benchmarks
+// each hot path is measured alone, for each type of values, then whole runs; the data come from
+// generate_multi_class_data
+//---------------------------------------------------------------------------
+
+template <typename t_value>
+struct t_benchmark_context{
+    t_tgp_parameters parameters;
+    double **training_data;
+    int *target;
+    int num_training_data, num_variables, num_classes;
+    t_value *a, *b, *result;     // operands of the kernels, converted from the first 2 variables
+    int op;
+};
+//---------------------------------------------------------------------------
+template <typename t_value>
+void benchmark_operator(void *context)
+{
+    t_benchmark_context<t_value> &bc = *(t_benchmark_context<t_value>*)context;
+    kernels<t_value>().apply_operator[bc.op](bc.a, bc.b, bc.result, bc.num_training_data);
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void benchmark_fitness(void *context)
+{
+    t_benchmark_context<t_value> &bc = *(t_benchmark_context<t_value>*)context;
+    t_tgp_chromosome<t_value> c;
+    c.value = bc.a;
+    bc.op = fitness(c, bc.num_training_data, bc.target, bc.num_classes); // kept, so that the call is not optimized away
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void benchmark_fused(void *context)
+// an offspring: operator and fitness in one pass, without cutoff
+{
+    t_benchmark_context<t_value> &bc = *(t_benchmark_context<t_value>*)context;
+    apply_operator_and_count_errors(0, bc.a, bc.b, bc.result, bc.num_training_data, bc.target, bc.num_classes, -1);
+}
+//---------------------------------------------------------------------------
+struct t_front_benchmark{
+    int *objectives, *front;
+    double *distance;
+    int num_points, num_objectives;
+};
+//---------------------------------------------------------------------------
+void benchmark_front_sort(void *context)
+// ranking of a multiobjective generation: the Pareto fronts, then the crowding distances
+{
+    t_front_benchmark &fb = *(t_front_benchmark*)context;
+    non_dominated_sort(fb.objectives, fb.num_points, fb.num_objectives, fb.front);
+    crowding_distance(fb.objectives, fb.front, fb.num_points, fb.num_objectives, fb.distance);
+}
+//---------------------------------------------------------------------------
+void benchmark_read(void *)
+{
+    double **data;
+    int *target, num_data, num_variables;
+    read_training_data(BenchmarkDataFile, ' ', data, target, num_data, num_variables);
+    delete_data(data, target);
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void benchmark_run(void *context)
+{
+    t_benchmark_context<t_value> &bc = *(t_benchmark_context<t_value>*)context;
+    t_data_set none = { NULL, NULL, 0 };
+    start_tgp<t_value>(bc.parameters, bc.training_data, bc.target, bc.num_training_data, bc.num_variables, bc.num_classes, none, none);
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void benchmark_kernels(t_benchmark_report &report, const char *value_type)
+// operators, fitness and both fused, on data of the size of the L1 cache, of the L2 cache and of the memory
+{
+    t_benchmark_context<t_value> bc;
+    char description[256];
+    int sizes[] = { 1024, 65536, 1 << 20 };
+    for (int i = 0; i < 3; i++){
+        bc.num_training_data = sizes[i];
+        bc.num_classes = 2;
+        generate_multi_class_data(bc.training_data, bc.target, sizes[i], 2, bc.num_classes, 0);
+        bc.a = (t_value*)allocate_aligned(sizes[i] * sizeof(t_value));
+        bc.b = (t_value*)allocate_aligned(sizes[i] * sizeof(t_value));
+        bc.result = (t_value*)allocate_aligned(sizes[i] * sizeof(t_value));
+        convert_values(bc.training_data[0], bc.a, sizes[i]);
+        convert_values(bc.training_data[1], bc.b, sizes[i]);
+        for (bc.op = 0; bc.op < t_arithmetic_operators::size; bc.op++){
+            snprintf(description, sizeof(description), "\"values\": \"%s\", \"n\": %d, \"operator\": \"%s\"", value_type, sizes[i], operator_names[bc.op]);
+            measure(report, "operator", description, benchmark_operator<t_value>, &bc, sizes[i], "values");
+        }
+        for (bc.num_classes = 2; bc.num_classes <= 10; bc.num_classes += 8){
+            snprintf(description, sizeof(description), "\"values\": \"%s\", \"n\": %d, \"classes\": %d", value_type, sizes[i], bc.num_classes);
+            measure(report, "fitness", description, benchmark_fitness<t_value>, &bc, sizes[i], "values");
+            measure(report, "operator_and_fitness", description, benchmark_fused<t_value>, &bc, sizes[i], "values");
+        }
+        free_aligned(bc.a);
+        free_aligned(bc.b);
+        free_aligned(bc.result);
+        delete_data(bc.training_data, bc.target);
+    }
+}
+//---------------------------------------------------------------------------
+template <typename t_value>
+void benchmark_runs(t_benchmark_report &report, t_tgp_parameters &parameters, const char *value_type, int num_sizes, const int *sizes, int num_pop_sizes, const int *pop_sizes, int num_class_counts, const int *class_counts)
+// whole runs on 8 variables; the number of generations keeps each run short
+{
+    t_benchmark_context<t_value> bc;
+    char description[256];
+    bc.parameters = parameters;
+    bc.parameters.print_interval = 0;
+    bc.parameters.telemetry_file = NULL;
+    bc.parameters.checkpoint_file = bc.parameters.resume_file = NULL;
+    bc.num_variables = 8;
+    for (int i = 0; i < num_sizes; i++)
+        for (int c = 0; c < num_class_counts; c++){
+            bc.num_training_data = sizes[i];
+            bc.num_classes = class_counts[c];
+            generate_multi_class_data(bc.training_data, bc.target, sizes[i], bc.num_variables, bc.num_classes, 0);
+            for (int p = 0; p < num_pop_sizes; p++){
+                bc.parameters.pop_size = pop_sizes[p];
+                bc.parameters.num_generations = benchmark_generations((double)pop_sizes[p] * sizes[i]);
+                snprintf(description, sizeof(description), "\"values\": \"%s\", \"n\": %d, \"classes\": %d, \"pop_size\": %d, \"num_generations\": %d",
+                         value_type, sizes[i], bc.num_classes, pop_sizes[p], bc.parameters.num_generations);
+                measure(report, "run", description, benchmark_run<t_value>, &bc, bc.parameters.num_generations, "generations");
+            }
+            delete_data(bc.training_data, bc.target);
+        }
+}
+//---------------------------------------------------------------------------
+void run_benchmarks(t_tgp_parameters &parameters, FILE *f, double min_seconds)
+// the populations are measured with random fitness; the runs are swept over the number of data, pop_size
+// and the number of classes (with double values), then over the types of values
+{
+    t_benchmark_report report;
+    char description[256];
+    begin_benchmark_report(report, f, min_seconds, "tgp_multi_class", kernels<double>().name, parameters.num_threads);
+
+    benchmark_kernels<double>(report, "double");
+    benchmark_kernels<float>(report, "float");
+    benchmark_kernels<int16_t>(report, "fixed");
+
+    benchmark_populations<double>(report, parameters.seed);
+
+    // 2 populations of pop_size individuals, with random errors on each class and a random depth
+    t_front_benchmark fb;
+    t_random r;
+    int num_points[] = { 2000, 40000 };
+    for (int i = 0; i < 2; i++)
+        for (fb.num_objectives = 3; fb.num_objectives <= 6; fb.num_objectives += 3){
+            fb.num_points = num_points[i];
+            fb.objectives = new int[fb.num_points * fb.num_objectives];
+            fb.front = new int[fb.num_points];
+            fb.distance = new double[fb.num_points];
+            init_random(r, parameters.seed, 0, 0);
+            for (int k = 0; k < fb.num_points * fb.num_objectives; k++)
+                fb.objectives[k] = random_int(r, k % fb.num_objectives == fb.num_objectives - 1 ? 64 : 1000);
+            snprintf(description, sizeof(description), "\"points\": %d, \"objectives\": %d", fb.num_points, fb.num_objectives);
+            measure(report, "non_dominated_sort", description, benchmark_front_sort, &fb, fb.num_points, "points");
+            delete[] fb.objectives;
+            delete[] fb.front;
+            delete[] fb.distance;
+        }
+
+    t_benchmark_context<double> bc;
+    generate_multi_class_data(bc.training_data, bc.target, 100000, 8, 2, 0);
+    if (write_training_data(BenchmarkDataFile, bc.training_data, bc.target, 100000, 8)){
+        measure(report, "read_training_data", "\"n\": 100000, \"variables\": 8", benchmark_read, NULL, 100000, "rows");
+        remove(BenchmarkDataFile);
+    }
+    delete_data(bc.training_data, bc.target);
+
+    int sizes[] = { 1000, 100000 };
+    int pop_sizes[] = { 100, 1000, 10000 };
+    int class_counts[] = { 2, 10 };
+    benchmark_runs<double>(report, parameters, "double", 2, sizes, 2, pop_sizes, 2, class_counts);
+    benchmark_runs<float>(report, parameters, "float", 1, sizes + 1, 1, pop_sizes, 1, class_counts);
+    benchmark_runs<int16_t>(report, parameters, "fixed", 1, sizes + 1, 1, pop_sizes, 1, class_counts);
+    end_benchmark_report(report);
+}
+//---------------------------------------------------------------------------
+int main(int argc, char *argv[])
+// usage: tgp_multi_class [-data file] [-classes n] [-convert binary_file] [-subset n] [-subset_chunk n]
+//                        [-subset_interval n] [-dynamic_subset] [-full_evaluation n] [-values type] [-precision_report]
+//                        [-functions list]
+//                        [-save_model file] [-predict model_file [-output file]]
+//                        [-validation file] [-test file] [-validation_interval n] [-patience n] [-target_fitness n]
+//                        [-telemetry file [-hardware_counters]] [-semantic_cache] [-reject_duplicates]
+//                        [-one_vs_rest [-combine argmax|confidence]] [-multiobjective] [-in_place]
+//                        [-islands n [-migration_interval n] [-migration_size n]]
+//                        [-checkpoint file [-checkpoint_interval n]] [-resume file]
+//                        [-sweep spec_file [-sweep_output file]]
+//                        [-benchmark [-benchmark_output file] [-benchmark_time seconds]]
+//   -data             training data, in text format (see above) or in the binary format written by -convert
+//   -classes          number of classes (a binary file knows its number of classes)
+//   -convert          writes the training data in binary format and exits
+//   -subset           the individuals are evaluated on a subset of n training data, made of chunks of
+//                     -subset_chunk consecutive data and changed every -subset_interval generations;
+//                     with a binary file, only the subset needs to fit in memory
+//   -dynamic_subset   the difficult chunks and the chunks not used for a long time are chosen first
+//   -full_evaluation  the best individual is evaluated on all training data every n generations (a multiple
+//                     of -subset_interval; 0, the default, means only at the end)
+//   -values           type of the values of the programs: double, float or fixed (16 bit fixed point, in
+//                     -128 .. 128: the data outside are saturated, with a warning)
+//   -precision_report at the end, the best individual is evaluated with double values too, limited after each
+//                     operation to the range of the values of the run (saturated for fixed point)
+//   -functions        the operators, separated by commas (add,sub,mul,div by default): add, sub, mul, div, pdiv
+//                     (protected division), sqrt, log, exp, sin, abs, min, max, if (if(a, b) = a > 0 ? b : 0)
+//   -save_model       at the end, the program of the best individual is saved in file
+//   -predict          classifies the data of -data with a saved model and exits; the accuracy is computed
+//                     with the classes of the data file
+//   -output           with -predict, the predicted classes are written in file, one per line
+//   -validation       validation data (text or binary); the best individual is evaluated on them every
+//                     -validation_interval generations, and the best one on them is kept
+//   -test             test data (text or binary); the kept program is evaluated on them at the end
+//   -patience         the run stops when the best fitness (on the validation data if any) has not improved
+//                     for n generations
+//   -target_fitness   the run stops when the best training fitness is n or less
+//   -telemetry        writes the metrics of each generation of each island, in JSON lines or, if the name
+//                     ends with .csv, in CSV: time of each phase, fitness distribution, operator success
+//   -hardware_counters  adds the cycles, instructions and cache misses of each generation (Linux only)
+//   -semantic_cache   offspring with the same values as a program already evaluated are not evaluated again
+//   -reject_duplicates  offspring whose values are already in the population are built again (changes the results)
+//   -one_vs_rest      a binary population learns each class against the others, all classes concurrently;
+//                     the data are classified by combining their programs (-telemetry and -precision_report are ignored)
+//   -combine          argmax: the class whose program gives the largest value (default); confidence: among the
+//                     programs which claim the data, the one with the fewest training errors, else argmax
+//   -multiobjective   minimizes the errors on each class and the depth of the programs, with Pareto fronts;
+//                     the first front of the final population is printed
+//   -in_place         steady state in a single population: each offspring replaces the worse of 2 individuals
+//                     at once; half the memory, but with several threads the results depend on their timing
+//   -islands          number of populations (1 to 256), evolved concurrently; each island sends its best
+//                     individuals to the next one (in a ring) every -migration_interval generations (10 by default)
+//   -migration_size   number of individuals sent by an island at each migration (1 by default)
+//   -checkpoint       every -checkpoint_interval generations (1000 by default), the state of the run is
+//                     written in file, in the background
+//   -resume           continues the run saved in file by -checkpoint; the other options must be the same
+//                     as for the interrupted run (a single population, without -one_vs_rest)
+//   -sweep            runs every combination of the values of seed, pop_size, num_generations, insertion_probability
+//                     and crossover_probability given in spec_file (one line per key: the key, then its values),
+//                     concurrently on the same data, and writes the results and time of each run in CSV (on the
+//                     standard output or in -sweep_output); without -one_vs_rest, -save_model, -telemetry and -checkpoint
+//   -benchmark        checks the hash of values (negated values must not have the same hash), measures the hot
+//                     paths and whole runs on generated data, writes the results in JSON (on the standard output
+//                     or in -benchmark_output) and exits
+//   -benchmark_time   minimal duration of each measure (0.2 seconds by default)
 {
 
     t_tgp_parameters params;
@@ -349,31 +3948,316 @@ int main(void)
     params.num_generations = 100000;					// the number of generations
     params.insertion_probability = 0.1;              // insertion probability
     params.crossover_probability = 0.9;             // crossover probability
+    params.functions = DefaultFunctions;            // + - * /
+    params.max_errors = -1;                         // no cutoff for early abort of offspring evaluation
+    params.abort_above_worst = false;               // evaluate offspring completely, even if worse than the whole population
+    params.seed = 0;                                // seed of the random numbers
+    params.num_threads = std::thread::hardware_concurrency(); // the result does not depend on it
+    params.print_interval = 100;                    // the best fitness is printed every 100 generations
+    params.num_islands = 1;                         // a single population
+    params.migration_interval = 10;                 // migration every 10 generations (if there are several islands)
+    params.num_migrants = 1;                        // the best individual of an island is sent to its neighbours
+    params.migration_topology = MigrationRing;
+    params.subset_size = 0;                         // all training data are used
+    params.subset_chunk_size = 4096;                // the subset is read in chunks of 4096 data
+    params.subset_interval = 100;                   // a new subset every 100 generations
+    params.subset_selection = SubsetRandom;
+    params.full_evaluation_interval = 0;            // the best individual is evaluated on all data only at the end
+    params.value_type = ValueDouble;
+    params.precision_report = false;
+    params.model_file = NULL;                       // no model is saved
+    params.validation_interval = 10;                // the best individual is validated every 10 generations (if it changed)
+    params.patience = 0;                            // no early stop without improvement
+    params.target_fitness = -1;                     // no early stop on the training fitness
+    params.telemetry_file = NULL;                   // no telemetry
+    params.hardware_counters = false;
+    params.semantic_cache = false;
+    params.reject_duplicates = false;
+    params.one_vs_rest = false;                     // a single population learns all classes
+    params.combination = OvrArgmax;
+    params.label = NULL;
+    params.checkpoint_file = NULL;                  // no checkpoints
+    params.checkpoint_interval = 1000;              // a checkpoint every 1000 generations (with -checkpoint)
+    params.resume_file = NULL;
+    params.multiobjective = false;                  // the total errors are minimized
+    params.in_place = false;                        // generational: a new population is built from the current one
     
+    const char *data_file = "datasets//cancer1.txt";
+    const char *convert_file = NULL;
+    const char *predict_file = NULL;
+    const char *output_file = NULL;
+    const char *validation_file = NULL;
+    const char *test_file = NULL;
+    bool benchmark = false;
+    const char *benchmark_file = NULL;
+    double benchmark_seconds = 0.2;
+    const char *sweep_file = NULL;
+    const char *sweep_output = NULL;
+    int num_classes = 2; // please specify this for each problem !
+    for (int i = 1; i < argc; i++){
+        if (!strcmp(argv[i], "-data") && i + 1 < argc)
+            data_file = argv[++i];
+        else if (!strcmp(argv[i], "-classes") && i + 1 < argc)
+            num_classes = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-convert") && i + 1 < argc)
+            convert_file = argv[++i];
+        else if (!strcmp(argv[i], "-subset") && i + 1 < argc)
+            params.subset_size = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-subset_chunk") && i + 1 < argc)
+            params.subset_chunk_size = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-subset_interval") && i + 1 < argc)
+            params.subset_interval = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-dynamic_subset"))
+            params.subset_selection = SubsetDynamic;
+        else if (!strcmp(argv[i], "-full_evaluation") && i + 1 < argc){
+            if (!parse_int_option("-full_evaluation", argv[++i], 0, INT_MAX, params.full_evaluation_interval))
+                return 1;
+        }
+        else if (!strcmp(argv[i], "-values") && i + 1 < argc){
+            i++;
+            if (!strcmp(argv[i], "double"))
+                params.value_type = ValueDouble;
+            else if (!strcmp(argv[i], "float"))
+                params.value_type = ValueFloat;
+            else if (!strcmp(argv[i], "fixed"))
+                params.value_type = ValueFixed;
+            else{
+                printf("Unknown type of values %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-precision_report"))
+            params.precision_report = true;
+        else if (!strcmp(argv[i], "-functions") && i + 1 < argc){
+            if (!parse_functions(argv[++i], params.functions))
+                return 1;
+        }
+        else if (!strcmp(argv[i], "-save_model") && i + 1 < argc)
+            params.model_file = argv[++i];
+        else if (!strcmp(argv[i], "-telemetry") && i + 1 < argc)
+            params.telemetry_file = argv[++i];
+        else if (!strcmp(argv[i], "-hardware_counters"))
+            params.hardware_counters = true;
+        else if (!strcmp(argv[i], "-semantic_cache"))
+            params.semantic_cache = true;
+        else if (!strcmp(argv[i], "-reject_duplicates"))
+            params.semantic_cache = params.reject_duplicates = true;
+        else if (!strcmp(argv[i], "-one_vs_rest"))
+            params.one_vs_rest = true;
+        else if (!strcmp(argv[i], "-multiobjective"))
+            params.multiobjective = true;
+        else if (!strcmp(argv[i], "-in_place"))
+            params.in_place = true;
+        else if (!strcmp(argv[i], "-islands") && i + 1 < argc){
+            if (!parse_int_option("-islands", argv[++i], 1, MaxIslands, params.num_islands))
+                return 1;
+        }
+        else if (!strcmp(argv[i], "-migration_interval") && i + 1 < argc){
+            if (!parse_int_option("-migration_interval", argv[++i], 1, INT_MAX, params.migration_interval))
+                return 1;
+        }
+        else if (!strcmp(argv[i], "-migration_size") && i + 1 < argc){
+            if (!parse_int_option("-migration_size", argv[++i], 1, params.pop_size, params.num_migrants))
+                return 1;
+        }
+        else if (!strcmp(argv[i], "-combine") && i + 1 < argc){
+            i++;
+            if (!strcmp(argv[i], "argmax"))
+                params.combination = OvrArgmax;
+            else if (!strcmp(argv[i], "confidence"))
+                params.combination = OvrConfidence;
+            else{
+                printf("Unknown combination %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[i], "-checkpoint") && i + 1 < argc)
+            params.checkpoint_file = argv[++i];
+        else if (!strcmp(argv[i], "-checkpoint_interval") && i + 1 < argc)
+            params.checkpoint_interval = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-resume") && i + 1 < argc)
+            params.resume_file = argv[++i];
+        else if (!strcmp(argv[i], "-predict") && i + 1 < argc)
+            predict_file = argv[++i];
+        else if (!strcmp(argv[i], "-output") && i + 1 < argc)
+            output_file = argv[++i];
+        else if (!strcmp(argv[i], "-validation") && i + 1 < argc)
+            validation_file = argv[++i];
+        else if (!strcmp(argv[i], "-test") && i + 1 < argc)
+            test_file = argv[++i];
+        else if (!strcmp(argv[i], "-validation_interval") && i + 1 < argc)
+            params.validation_interval = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-patience") && i + 1 < argc)
+            params.patience = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-target_fitness") && i + 1 < argc)
+            params.target_fitness = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-sweep") && i + 1 < argc)
+            sweep_file = argv[++i];
+        else if (!strcmp(argv[i], "-sweep_output") && i + 1 < argc)
+            sweep_output = argv[++i];
+        else if (!strcmp(argv[i], "-benchmark"))
+            benchmark = true;
+        else if (!strcmp(argv[i], "-benchmark_output") && i + 1 < argc)
+            benchmark_file = argv[++i];
+        else if (!strcmp(argv[i], "-benchmark_time") && i + 1 < argc)
+            benchmark_seconds = atof(argv[++i]);
+        else{
+            printf("Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (params.subset_chunk_size < 1 || params.subset_interval < 1 || params.validation_interval < 1){
+        printf("-subset_chunk, -subset_interval and -validation_interval must be positive\n");
+        return 1;
+    }
+    if (params.full_evaluation_interval % params.subset_interval){
+        // the full evaluation happens when the subset changes (see change_subset)
+        printf("-full_evaluation (%d) must be a multiple of -subset_interval (%d)\n", params.full_evaluation_interval, params.subset_interval);
+        return 1;
+    }
+    if ((params.checkpoint_file || params.resume_file) && (params.num_islands > 1 || params.one_vs_rest || params.checkpoint_interval < 1)){
+        printf("-checkpoint and -resume need a single population and a positive -checkpoint_interval\n");
+        return 1;
+    }
+    if (params.multiobjective && (params.num_islands > 1 || params.checkpoint_file || params.resume_file)){
+        printf("-multiobjective needs a single population, without -checkpoint and -resume\n");
+        return 1;
+    }
+    if (params.multiobjective && params.in_place){
+        printf("-multiobjective and -in_place cannot be used together\n");
+        return 1;
+    }
+    t_sweep_spec sweep_spec;
+    if (sweep_file){
+        if (params.one_vs_rest || params.model_file || params.telemetry_file || params.checkpoint_file || params.resume_file){
+            printf("-sweep cannot be used with -one_vs_rest, -save_model, -telemetry, -checkpoint or -resume\n");
+            return 1;
+        }
+        if (!read_sweep_spec(sweep_file, params, sweep_spec))
+            return 1;
+    }
+
+    if (benchmark){
+        if (!check_value_hash()){
+            printf("The hash of values confuses different values!\n");
+            return 1;
+        }
+        FILE *f = benchmark_file ? fopen(benchmark_file, "w") : stdout;
+        if (!f){
+            printf("Cannot write %s!\n", benchmark_file);
+            return 1;
+        }
+        run_benchmarks(params, f, benchmark_seconds);
+        if (benchmark_file)
+            fclose(f);
+        return 0;
+    }
 
     int num_training_data, num_variables;
     double** training_data;
     int *target;
+    t_mapped_file binary_file;
+    bool binary = is_binary_data_file(data_file);
     
-    if (!read_training_data("datasets//cancer1.txt", ' ', training_data, target, num_training_data, num_variables)) {
+    if (binary ? !open_binary_data(data_file, ElementDouble, binary_file, training_data, target, num_training_data, num_variables, num_classes) :
+                 !read_training_data(data_file, ' ', training_data, target, num_training_data, num_variables)) {
         printf("Cannot find input file! Please specify the correct (full) path!");
         getchar();
         return 1;
     }
     
-    int num_classes = 2; // please specify this for each problem !
+    if (convert_file){
+        if (!binary){
+            // a text file does not know its number of classes: they are 0 .. the largest class
+            num_classes = 0;
+            for (int i = 0; i < num_training_data; i++)
+                if (target[i] >= num_classes)
+                    num_classes = target[i] + 1;
+        }
+        bool ok = write_binary_data(convert_file, ElementDouble, training_data, target, num_training_data, num_variables, num_classes);
+        printf(ok ? "%s written\n" : "Cannot write %s!\n", convert_file);
+        if (binary)
+            close_binary_data(binary_file, training_data);
+        else
+            delete_data(training_data, target);
+        return ok ? 0 : 1;
+    }
+
+    if (predict_file){
+        bool ok = classify_data(predict_file, output_file, training_data, target, num_training_data, num_variables, params.num_threads);
+        if (binary)
+            close_binary_data(binary_file, training_data);
+        else
+            delete_data(training_data, target);
+        return ok ? 0 : 1;
+    }
+    
+    t_data_set validation = { NULL, NULL, 0 }, test = { NULL, NULL, 0 };
+    t_mapped_file validation_mf, test_mf;
+    bool validation_binary = false, test_binary = false;
+    if ((validation_file && !open_data_set(validation_file, validation, validation_mf, validation_binary, num_variables)) ||
+        (test_file && !open_data_set(test_file, test, test_mf, test_binary, num_variables))){
+        if (validation.num_data)
+            close_data_set(validation, validation_mf, validation_binary);
+        if (binary)
+            close_binary_data(binary_file, training_data);
+        else
+            delete_data(training_data, target);
+        return 1;
+    }
     
     printf("num training data = %d\n", num_training_data);
+    if (validation.num_data)
+        printf("num validation data = %d\n", validation.num_data);
+    if (test.num_data)
+        printf("num test data = %d\n", test.num_data);
     printf("num variables = %d\n", num_variables);
+    bool ok = true;
+    switch (params.value_type){
+        case ValueDouble:
+            printf("kernels = %s\n", kernels<double>().name);
+            if (sweep_file)
+                ok = start_sweep<double>(params, sweep_spec, sweep_output, training_data, target, num_training_data, num_variables, num_classes, validation, test);
+            else if (params.one_vs_rest)
+                start_one_vs_rest<double>(params, training_data, target, num_training_data, num_variables, num_classes, validation, test);
+            else
+                start_tgp<double>( params, training_data, target, num_training_data, num_variables, num_classes, validation, test);
+            break;
+        case ValueFloat:
+            printf("kernels = %s\nvalues = float\n", kernels<float>().name);
+            if (sweep_file)
+                ok = start_sweep<float>(params, sweep_spec, sweep_output, training_data, target, num_training_data, num_variables, num_classes, validation, test);
+            else if (params.one_vs_rest)
+                start_one_vs_rest<float>(params, training_data, target, num_training_data, num_variables, num_classes, validation, test);
+            else
+                start_tgp<float>( params, training_data, target, num_training_data, num_variables, num_classes, validation, test);
+            break;
+        case ValueFixed:
+            printf("kernels = %s\nvalues = fixed point\n", kernels<int16_t>().name);
+            warn_outside_fixed_range("training", training_data, num_training_data, num_variables);
+            warn_outside_fixed_range("validation", validation.data, validation.num_data, num_variables);
+            warn_outside_fixed_range("test", test.data, test.num_data, num_variables);
+            if (sweep_file)
+                ok = start_sweep<int16_t>(params, sweep_spec, sweep_output, training_data, target, num_training_data, num_variables, num_classes, validation, test);
+            else if (params.one_vs_rest)
+                start_one_vs_rest<int16_t>(params, training_data, target, num_training_data, num_variables, num_classes, validation, test);
+            else
+                start_tgp<int16_t>( params, training_data, target, num_training_data, num_variables, num_classes, validation, test);
+            break;
+    }
     
-    srand(0);
-    start_tgp( params, training_data, target, num_training_data, num_variables, num_classes);
-    
-    delete_data(training_data, target, num_training_data);
+    if (validation.num_data)
+        close_data_set(validation, validation_mf, validation_binary);
+    if (test.num_data)
+        close_data_set(test, test_mf, test_binary);
+    if (binary)
+        close_binary_data(binary_file, training_data);
+    else
+        delete_data(training_data, target);
     printf("Press enter ...");
     getchar();
 
 
-  return 0;
+  return ok ? 0 : 1;
 }
 //---------------------------------------------------------------------------
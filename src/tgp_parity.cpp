@@ -41,283 +41,542 @@
 #include <math.h>
 #include <string.h>
 #include <float.h>
+#include <stdint.h>
+#include <limits.h>
 
-#define NumberOfOperators 4
+#include <algorithm>
 
-// AND -1
-// OR -2
-// NAND -3
-// NOR -4
+#include "tgp_engine.h"
+
+// values are bit-packed: bit (k % 64) of word (k / 64) holds the value for the kth fitness case
+#define BitsPerWord 64
+#define MaxParityOrder 30        // -parity: 2^30 fitness cases, 128 MB per variable
+
+// the phases of the GP loop (see tgp_engine.h); there is no lineage
+#define NumPhases 5
+const char *const phase_names[NumPhases] = { "selection", "operators", "fitness", "copy", "migration" };
 //---------------------------------------------------------------------------
-struct t_tgp_chromosome{
-    char *value;  // value of the current program for kth data (training, validation or test)
-    
-    int fitness;           //num incorrect classified
-} ;
+int get_num_words(int num_training_data)
+{
+    return (num_training_data + BitsPerWord - 1) / BitsPerWord;
+}
+//---------------------------------------------------------------------------
+uint64_t last_word_mask(int num_training_data)
+// the unused bits of the last word are garbage after NAND/NOR, so they are masked out when counting
+{
+    int used_bits = num_training_data % BitsPerWord;
+    return used_bits ? (((uint64_t)1 << used_bits) - 1) : ~(uint64_t)0;
+}
+//---------------------------------------------------------------------------
+// the function set: AND, OR, NAND and NOR, on 64 fitness cases at once
+//---------------------------------------------------------------------------
+struct t_and{
+    static uint64_t apply(uint64_t a, uint64_t b) { return a & b; }
+#if TGP_X86_SIMD
+    TGP_TARGET_AVX2 static t_avx2_uint64 apply(t_avx2_uint64 a, t_avx2_uint64 b) { t_avx2_uint64 r = { _mm256_and_si256(a.v, b.v) }; return r; }
+#endif
+#if TGP_AVX512
+    TGP_TARGET_AVX512 static t_avx512_uint64 apply(t_avx512_uint64 a, t_avx512_uint64 b) { t_avx512_uint64 r = { _mm512_and_si512(a.v, b.v) }; return r; }
+#endif
+};
 //---------------------------------------------------------------------------
-struct t_tgp_parameters{
-    int num_generations;
-    int pop_size;                // population size
-    double insertion_probability, crossover_probability;
+struct t_or{
+    static uint64_t apply(uint64_t a, uint64_t b) { return a | b; }
+#if TGP_X86_SIMD
+    TGP_TARGET_AVX2 static t_avx2_uint64 apply(t_avx2_uint64 a, t_avx2_uint64 b) { t_avx2_uint64 r = { _mm256_or_si256(a.v, b.v) }; return r; }
+#endif
+#if TGP_AVX512
+    TGP_TARGET_AVX512 static t_avx512_uint64 apply(t_avx512_uint64 a, t_avx512_uint64 b) { t_avx512_uint64 r = { _mm512_or_si512(a.v, b.v) }; return r; }
+#endif
 };
 //---------------------------------------------------------------------------
-void allocate_training_data(char **&data, char *&target, int num_training_data, int num_variables)
+struct t_nand{
+    static uint64_t apply(uint64_t a, uint64_t b) { return ~(a & b); }
+#if TGP_X86_SIMD
+    TGP_TARGET_AVX2 static t_avx2_uint64 apply(t_avx2_uint64 a, t_avx2_uint64 b) { t_avx2_uint64 r = { _mm256_xor_si256(_mm256_and_si256(a.v, b.v), _mm256_set1_epi64x(-1)) }; return r; }
+#endif
+#if TGP_AVX512
+    TGP_TARGET_AVX512 static t_avx512_uint64 apply(t_avx512_uint64 a, t_avx512_uint64 b) { t_avx512_uint64 r = { _mm512_xor_si512(_mm512_and_si512(a.v, b.v), _mm512_set1_epi64(-1)) }; return r; }
+#endif
+};
+//---------------------------------------------------------------------------
+struct t_nor{
+    static uint64_t apply(uint64_t a, uint64_t b) { return ~(a | b); }
+#if TGP_X86_SIMD
+    TGP_TARGET_AVX2 static t_avx2_uint64 apply(t_avx2_uint64 a, t_avx2_uint64 b) { t_avx2_uint64 r = { _mm256_xor_si256(_mm256_or_si256(a.v, b.v), _mm256_set1_epi64x(-1)) }; return r; }
+#endif
+#if TGP_AVX512
+    TGP_TARGET_AVX512 static t_avx512_uint64 apply(t_avx512_uint64 a, t_avx512_uint64 b) { t_avx512_uint64 r = { _mm512_xor_si512(_mm512_or_si512(a.v, b.v), _mm512_set1_epi64(-1)) }; return r; }
+#endif
+};
+
+typedef t_operator_list<t_and, t_or, t_nand, t_nor> t_boolean_operators;
+const char *const operator_names[] = { "and", "or", "nand", "nor" };
+//---------------------------------------------------------------------------
+struct t_parity_fitness{
+    // number of fitness cases where the program output differs from the target: popcount(value XOR target)
+    // num_data is the number of fitness cases (bits), not of words
+    typedef uint64_t t_target;
+    static int count_errors_scalar(const uint64_t *value, const uint64_t *target, int num_data, int num_classes);
+#if TGP_X86_SIMD
+    // AVX2 and AVX-512F have no population count: the words are counted one by one
+    static int count_errors_avx2(const uint64_t *value, const uint64_t *target, int num_data, int num_classes) { return count_errors_scalar(value, target, num_data, num_classes); }
+    static int count_errors_avx512(const uint64_t *value, const uint64_t *target, int num_data, int num_classes) { return count_errors_scalar(value, target, num_data, num_classes); }
+#endif
+};
+//---------------------------------------------------------------------------
+int t_parity_fitness::count_errors_scalar(const uint64_t *value, const uint64_t *target, int num_data, int)
+{
+    int num_words = get_num_words(num_data);
+    int num_errors = 0;
+    for (int i = 0; i < num_words - 1; i++)
+        num_errors += popcount64(value[i] ^ target[i]);
+    num_errors += popcount64((value[num_words - 1] ^ target[num_words - 1]) & last_word_mask(num_data));
+    return num_errors;
+}
+//---------------------------------------------------------------------------
+void allocate_training_data(uint64_t **&data, uint64_t *&target, int num_training_data, int num_variables)
+// data is stored by columns: data[j] holds the packed values of variable j for all fitness cases
+// all columns are in a single aligned block
 {
-    target = new char[num_training_data];
-    data = new char*[num_training_data];
-    for (int i = 0; i < num_training_data; i++)
-        data[i] = new char[num_variables];
+    int num_words = get_num_words(num_training_data);
+    int stride = get_stride<uint64_t>(num_words);
+    target = new uint64_t[num_words];
+    memset(target, 0, num_words * sizeof(uint64_t));
+    data = new uint64_t*[num_variables + 1]; // data[0] holds the block even if there are no variables
+    data[0] = (uint64_t*)allocate_aligned((size_t)num_variables * stride * sizeof(uint64_t));
+    memset(data[0], 0, (size_t)num_variables * stride * sizeof(uint64_t));
+    for (int j = 1; j < num_variables; j++)
+        data[j] = data[0] + (size_t)j * stride;
 }
 //---------------------------------------------------------------------------
-void delete_data(char **&data, char *&target, int num_training_data)
+void delete_data(uint64_t **&data, uint64_t *&target)
 {
     if (data)
-        for (int i = 0; i < num_training_data; i++)
-            delete[] data[i];
+        free_aligned(data[0]);
     delete[] data;
     delete[] target;
 }
 //---------------------------------------------------------------------------
-void alocate_population(t_tgp_chromosome *&pop, int pop_size, int num_training_data)
-{
-    pop = new t_tgp_chromosome[pop_size];
-    
-    for (int i = 0; i < pop_size; i++)
-        pop[i].value = new char[num_training_data];
-}
+struct t_tgp_run : t_gp_run<uint64_t>{
+    // the data shared by all islands
+    uint64_t **training_data;
+    uint64_t *target;
+    int num_training_data, num_words;
+};
 //---------------------------------------------------------------------------
-void copy_chromosome(t_tgp_chromosome& dest, t_tgp_chromosome& source, int num_training_data)
-{
-    for (int i = 0; i < num_training_data; i++)
-        dest.value[i] = source.value[i];
-    dest.fitness = source.fitness;
-}
+struct t_parity_problem : t_gp_problem{
+    // the even parity problem for the GP loop of tgp_engine.h
+    typedef uint64_t t_value;
+    typedef uint64_t t_target;
+    typedef t_gp_parameters t_parameters;
+    typedef t_tgp_run t_run;
+
+    static const t_kernels<uint64_t, uint64_t>& kernels(void);
+    static bool commutative(int) { return true; }    // the 4 operators are commutative
+    static int evaluate(t_generation<t_parity_problem> &gen, int op, const uint64_t *a, const uint64_t *b, uint64_t *result, uint64_t *hash,
+                        t_phase_clock &clock);
+    static int begin_island(t_island<t_parity_problem> &island);
+    static void print_generation(t_island<t_parity_problem> &island, int generation);
+};
 //---------------------------------------------------------------------------
-void fitness(t_tgp_chromosome &c, int num_training_data, char **training_data, char *target)
+const t_kernels<uint64_t, uint64_t>& t_parity_problem::kernels(void)
 {
-    c.fitness = 0;
-    for (int i = 0; i < num_training_data; i++)
-        if (abs(c.value[i] - target[i])){
-            c.fitness++;
-    }
+    static t_kernels<uint64_t, uint64_t> selected = select_kernels<t_boolean_operators, t_parity_fitness, uint64_t>();
+    return selected;
 }
 //---------------------------------------------------------------------------
-void init_chromosome(t_tgp_chromosome &c, int num_variables, int num_training_data, char ** data)
+int fitness(t_tgp_chromosome<uint64_t> &c, int num_training_data, uint64_t *target)
 {
-    int random_var = rand() % num_variables;
-    
-    for (int i = 0; i < num_training_data; i++)
-        c.value[i] = data[i][random_var];
+    return t_parity_problem::kernels().count_errors(c.value, target, num_training_data, 2);
 }
 //---------------------------------------------------------------------------
-int sort_function(const void *a, const void *b)
+int t_parity_problem::evaluate(t_generation<t_parity_problem> &gen, int op, const uint64_t *a, const uint64_t *b, uint64_t *result, uint64_t *hash,
+                               t_phase_clock &clock)
+// the operator on whole words, then the errors: there is no cutoff
 {
-    if (((t_tgp_chromosome *)a)->fitness > ((t_tgp_chromosome *)b)->fitness)
-        return 1;
-    else
-        if (((t_tgp_chromosome *)a)->fitness < ((t_tgp_chromosome *)b)->fitness)
-            return -1;
-        else
-            return 0;//!!!
+    kernels().apply_operator[op](a, b, result, gen.num_values);
+    end_phase(clock, PhaseOperators);
+    int num_errors = kernels().count_errors(result, gen.target, gen.num_data, 2);
+    if (hash)
+        *hash = hash_values(kernels(), result, (size_t)gen.num_values * sizeof(uint64_t), gen.last_mask);
+    return num_errors;
 }
 //---------------------------------------------------------------------------
-void sort_by_fitness(t_tgp_chromosome *pop, int pop_size)
-// sort ascendingly the individuals in population
+int t_parity_problem::begin_island(t_island<t_parity_problem> &island)
 {
-    qsort((void *)pop, pop_size, sizeof(pop[0]), sort_function);
+    t_generation<t_parity_problem> &gen = island.gen;
+    t_tgp_run &run = *island.run;
+    gen.target = run.target;
+    gen.num_data = run.num_training_data;
+    gen.num_values = run.num_words;
+    gen.last_mask = last_word_mask(run.num_training_data);
+    init_population(island);
+    return 0;
 }
 //---------------------------------------------------------------------------
-void free_pop_memory(t_tgp_chromosome *&pop, int pop_size)
+void t_parity_problem::print_generation(t_island<t_parity_problem> &island, int generation)
 {
-    for (int i = 0; i < pop_size; i++)
-        delete[] pop[i].value;
-    
-    delete[] pop;
+    if (island.parameters->num_islands > 1)
+        printf("island = %d ", island.index);
+    printf("%d %d\n", generation, island.current_pop.fitness[island.current_pop.best]);
 }
 //---------------------------------------------------------------------------
-int tournament_selection(t_tgp_chromosome *pop, int pop_size, int tournament_size)
+void init_variable_fitness(int *variable_fitness, uint64_t *variable_hash, uint64_t **data, int num_variables, int num_training_data, uint64_t *target)
+// an inserted program is a single variable: its fitness and its hash are computed once
 {
-    int r, p;
-    p = rand() % pop_size;
-    for (int i = 1; i < tournament_size; i++) {
-        r = rand() % pop_size;
-        p = pop[r].fitness < pop[p].fitness ? r : p;
+    for (int j = 0; j < num_variables; j++){
+        t_tgp_chromosome<uint64_t> c;
+        c.value = data[j];
+        variable_fitness[j] = fitness(c, num_training_data, target);
+        variable_hash[j] = hash_values(t_parity_problem::kernels(), data[j], get_num_words(num_training_data) * sizeof(uint64_t), last_word_mask(num_training_data));
     }
-    return p;
 }
 //---------------------------------------------------------------------------
-void start_steady_state_tgp(t_tgp_parameters &parameters, char **training_data, char *target, int num_training_data, int num_variables)
+void start_steady_state_tgp(t_gp_parameters &parameters, uint64_t **training_data, uint64_t *target, int num_training_data, int num_variables)
 {
-    t_tgp_chromosome* current_pop, *new_pop;
-    
-    alocate_population(current_pop, parameters.pop_size, num_training_data);
-    alocate_population(new_pop, parameters.pop_size, num_training_data);
-    for (int i = 0; i < parameters.pop_size; i++){
-        init_chromosome(current_pop[i], num_variables, num_training_data, training_data);
-        fitness(current_pop[i], num_training_data, training_data, target);
-    }
-    
-    sort_by_fitness(current_pop, parameters.pop_size);
-    
-    for (int g = 1; g < parameters.num_generations; g++){
-        // elitism: copy best to the new population
-        copy_chromosome(new_pop[0], current_pop[0], num_training_data);
-        int new_pop_size = 1;
-        
-        if (g % 100 == 0)
-            printf("%d %d\n", g, current_pop[0].fitness);
-        while (new_pop_size < parameters.pop_size){
-            double p = rand() / (double)RAND_MAX;
-            
-            if (p < parameters.insertion_probability){  // insertion of a simple program (made from a single variable)
-                init_chromosome(new_pop[new_pop_size], num_variables, num_training_data, training_data);
-                fitness(new_pop[new_pop_size], num_training_data, training_data, target);
-                new_pop_size++;
-            }
-            else{  // recombination of 2 programs
-                // first I have to choose an operator
-                int op = rand() % NumberOfOperators;
-                int p1, p2;
-                double ps;
-                switch (op){
-                    case 0: // and
-                        p1 = tournament_selection(current_pop, parameters.pop_size, 1);
-                        p2 = tournament_selection(current_pop, parameters.pop_size, 1);
-                        ps = rand() / (double) RAND_MAX;
-                        if (ps <= parameters.crossover_probability){
-                            
-                            for (int i = 0; i < num_training_data; i++)
-                                new_pop[new_pop_size].value[i] = current_pop[p1].value[i] & current_pop[p2].value[i];
-                            
-                            
-                            fitness(new_pop[new_pop_size], num_training_data, training_data, target);
-                            new_pop_size++;
-                        }
-                        else{
-                            // copy one of the parents to the new population
-                            copy_chromosome(new_pop[new_pop_size], current_pop[p1], num_training_data);
-                            new_pop_size++;
-                        }
-                        break;
-                        
-                    case 1: // or
-                        p1 = tournament_selection(current_pop, parameters.pop_size, 1);
-                        p2 = tournament_selection(current_pop, parameters.pop_size, 1);
-                        ps = rand() / (double) RAND_MAX;
-                        if (ps <= parameters.crossover_probability){
-                            for (int i = 0; i < num_training_data; i++)
-                                new_pop[new_pop_size].value[i] = current_pop[p1].value[i] | current_pop[p2].value[i];
-                            
-                            fitness(new_pop[new_pop_size], num_training_data, training_data, target);
-                            new_pop_size++;
-                        }
-                        else{
-                            // copy one of the parents to the new population
-                            copy_chromosome(new_pop[new_pop_size], current_pop[p1], num_training_data);
-                            new_pop_size++;
-                        }
-                        break;
-                    case 2: // nand
-                        p1 = tournament_selection(current_pop, parameters.pop_size, 1);
-                        p2 = tournament_selection(current_pop, parameters.pop_size, 1);
-                        ps = rand() / (double) RAND_MAX;
-                        if (ps <= parameters.crossover_probability){
-                            
-                            for (int i = 0; i < num_training_data; i++)
-                                new_pop[new_pop_size].value[i] = !(current_pop[p1].value[i] & current_pop[p2].value[i]);
-                            
-                            fitness(new_pop[new_pop_size], num_training_data, training_data, target);
-                            new_pop_size++;
-                        }
-                        else{
-                            // copy one of the parents to the new population
-                            copy_chromosome(new_pop[new_pop_size], current_pop[p1], num_training_data);
-                            new_pop_size++;
-                        }
-                        break;
-                    case 3: // nor
-                        p1 = tournament_selection(current_pop, parameters.pop_size, 1);
-                        p2 = tournament_selection(current_pop, parameters.pop_size, 1);
-                        ps = rand() / (double) RAND_MAX;
-                        if (ps <= parameters.crossover_probability){
-                            
-                            for (int i = 0; i < num_training_data; i++)
-                                new_pop[new_pop_size].value[i] = !(current_pop[p1].value[i] | current_pop[p2].value[i]);
-                            
-                            fitness(new_pop[new_pop_size], num_training_data, training_data, target);
-                            new_pop_size++;
-                        }
-                        else{
-                            // copy one of the parents to the new population
-                            copy_chromosome(new_pop[new_pop_size], current_pop[p1], num_training_data);
-                            new_pop_size++;
-                        }
-                        break;
-                        
-                }// switch
-            }
-        }
-        
-        for (int k = 0; k < parameters.pop_size; k++)
-            copy_chromosome(current_pop[k], new_pop[k], num_training_data);
-        sort_by_fitness(current_pop, parameters.pop_size);
-        
+    t_tgp_run run;
+    t_telemetry telemetry;
+    run.telemetry = NULL;
+    if (parameters.telemetry_file){
+        if (start_telemetry(telemetry, parameters.telemetry_file, parameters.hardware_counters, NumPhases, phase_names,
+                            t_boolean_operators::size, operator_names))
+            run.telemetry = &telemetry;
+        else
+            printf("Cannot write %s!\n", parameters.telemetry_file);
     }
+    run.training_data = training_data;
+    run.target = target;
+    run.num_training_data = num_training_data;
+    run.num_words = get_num_words(num_training_data);
+    run.lineage = NULL;
+
+    start_gp_run(parameters, run, training_data, num_variables, run.num_words);
+    init_variable_fitness(run.variable_fitness, run.variable_hash, training_data, num_variables, num_training_data, target);
+
+    int best = run_islands<t_parity_problem>(parameters, run);
+    if (parameters.num_islands > 1)
+        printf("best island = %d fitness = %d\n", best, run.best_fitness[best]);
+
+    stop_gp_run(parameters, run);
+    if (run.telemetry)
+        stop_telemetry(telemetry);
 }
 //---------------------------------------------------------------------------
-bool read_training_data(const char *filename, char **&training_data, char *&target, int &num_training_data, int &num_variables)
+bool read_training_data(const char *filename, uint64_t **&training_data, uint64_t *&target, int &num_training_data, int &num_variables)
 {
     FILE* f = fopen(filename, "r");
     if (!f)
         return false;
     
-    fscanf(f, "%d%d", &num_training_data, &num_variables);
+    if (fscanf(f, "%d%d", &num_training_data, &num_variables) != 2 || num_training_data < 1 || num_variables < 1){
+        // the fitness reads the last word of the values: there must be at least a fitness case
+        printf("%s has no data!\n", filename);
+        fclose(f);
+        return false;
+    }
     
     allocate_training_data(training_data, target, num_training_data, num_variables);
     
     int v;
     for (int i = 0; i < num_training_data; i++) {
+        uint64_t bit = (uint64_t)1 << (i % BitsPerWord);
         for (int j = 0; j < num_variables; j++){
             
             fscanf(f, "%d", &v);
-            training_data[i][j] = v;
+            if (v)
+                training_data[j][i / BitsPerWord] |= bit;
         }
         fscanf(f, "%d", &v);
-        target[i] = v;
+        if (v)
+            target[i / BitsPerWord] |= bit;
     }
     fclose(f);
     return true;
 }
 //---------------------------------------------------------------------------
-int main(void)
+void generate_even_parity(int order, uint64_t **&training_data, uint64_t *&target, int &num_training_data, int &num_variables)
+// all the fitness cases of the even parity problem of the given order, in the order of the data files:
+// variable 0 is the most significant bit of the case; the target is 1 if the number of ones is even
+// the words are written whole (bit-slicing): the 6 lowest bits of a case are its position in the word,
+// so the variables of these bits repeat the same pattern in every word and the others are constant in a
+// word; the parity is the pattern of the position, inverted when the number of ones of the word index is odd
+{
+    num_training_data = 1 << order;
+    num_variables = order;
+    allocate_training_data(training_data, target, num_training_data, num_variables);
+    uint64_t position_bit[6], even_position = 0;
+    for (int b = 0; b < 6; b++)
+        position_bit[b] = 0;
+    for (int i = 0; i < BitsPerWord; i++){
+        for (int b = 0; b < 6; b++)
+            if ((i >> b) & 1)
+                position_bit[b] |= (uint64_t)1 << i;
+        if (popcount32(i) % 2 == 0)
+            even_position |= (uint64_t)1 << i;
+    }
+    int num_words = get_num_words(num_training_data);
+    uint64_t mask = last_word_mask(num_training_data); // the unused bits stay 0 for orders below 6
+    for (int w = 0; w < num_words; w++){
+        uint64_t used = w == num_words - 1 ? mask : ~(uint64_t)0;
+        for (int j = 0; j < num_variables; j++){
+            int b = num_variables - 1 - j;
+            training_data[j][w] = (b < 6 ? position_bit[b] : ((w >> (b - 6)) & 1 ? ~(uint64_t)0 : 0)) & used;
+        }
+        target[w] = (popcount32(w) % 2 ? ~even_position : even_position) & used;
+    }
+}
+//---------------------------------------------------------------------------
+bool write_training_data(const char *filename, uint64_t **training_data, uint64_t *target, int num_training_data, int num_variables)
+// in text format, as read by read_training_data
+{
+    FILE *f = fopen(filename, "w");
+    if (!f)
+        return false;
+    fprintf(f, "%d %d\n", num_training_data, num_variables);
+    for (int i = 0; i < num_training_data; i++){
+        for (int j = 0; j < num_variables; j++)
+            fprintf(f, "%d ", (int)((training_data[j][i / BitsPerWord] >> (i % BitsPerWord)) & 1));
+        fprintf(f, "%d\n", (int)((target[i / BitsPerWord] >> (i % BitsPerWord)) & 1));
+    }
+    return fclose(f) == 0;
+}
+//---------------------------------------------------------------------------
+// benchmarks
+// each hot path is measured alone, then whole runs; the data come from generate_even_parity
+//---------------------------------------------------------------------------
+struct t_benchmark_context{
+    t_gp_parameters parameters;
+    uint64_t **training_data;
+    uint64_t *target;
+    int num_training_data, num_variables;
+    uint64_t *result;
+    int op;
+};
+//---------------------------------------------------------------------------
+void benchmark_operator(void *context)
+{
+    t_benchmark_context &bc = *(t_benchmark_context*)context;
+    t_parity_problem::kernels().apply_operator[bc.op](bc.training_data[0], bc.training_data[1], bc.result, get_num_words(bc.num_training_data));
+}
+//---------------------------------------------------------------------------
+void benchmark_fitness(void *context)
+{
+    t_benchmark_context &bc = *(t_benchmark_context*)context;
+    t_tgp_chromosome<uint64_t> c;
+    c.value = bc.training_data[0];
+    c.buffer = -1;
+    bc.op = fitness(c, bc.num_training_data, bc.target); // kept, so that the call is not optimized away
+}
+//---------------------------------------------------------------------------
+void benchmark_read(void *)
+{
+    uint64_t **data, *target;
+    int num_training_data, num_variables;
+    read_training_data(BenchmarkDataFile, data, target, num_training_data, num_variables);
+    delete_data(data, target);
+}
+//---------------------------------------------------------------------------
+void benchmark_run(void *context)
+{
+    t_benchmark_context &bc = *(t_benchmark_context*)context;
+    start_steady_state_tgp(bc.parameters, bc.training_data, bc.target, bc.num_training_data, bc.num_variables);
+}
+//---------------------------------------------------------------------------
+void run_benchmarks(t_gp_parameters &parameters, FILE *f, double min_seconds)
+// the populations are measured with random fitness; the runs are swept over the parity order and pop_size
+{
+    t_benchmark_report report;
+    t_benchmark_context bc;
+    char description[256];
+    begin_benchmark_report(report, f, min_seconds, "tgp_parity", t_parity_problem::kernels().name, parameters.num_threads);
+    bc.parameters = parameters;
+    bc.parameters.print_interval = 0;
+    bc.parameters.telemetry_file = NULL;
+
+    int orders[] = { 10, 16, 20 };
+    for (int i = 0; i < 3; i++){
+        generate_even_parity(orders[i], bc.training_data, bc.target, bc.num_training_data, bc.num_variables);
+        bc.result = (uint64_t*)allocate_aligned(get_num_words(bc.num_training_data) * sizeof(uint64_t));
+        for (bc.op = 0; bc.op < t_boolean_operators::size; bc.op++){
+            snprintf(description, sizeof(description), "\"order\": %d, \"operator\": \"%s\"", orders[i], operator_names[bc.op]);
+            measure(report, "operator", description, benchmark_operator, &bc, bc.num_training_data, "cases");
+        }
+        snprintf(description, sizeof(description), "\"order\": %d", orders[i]);
+        measure(report, "fitness", description, benchmark_fitness, &bc, bc.num_training_data, "cases");
+        free_aligned(bc.result);
+        delete_data(bc.training_data, bc.target);
+    }
+
+    benchmark_populations<uint64_t>(report, parameters.seed);
+
+    generate_even_parity(16, bc.training_data, bc.target, bc.num_training_data, bc.num_variables);
+    if (write_training_data(BenchmarkDataFile, bc.training_data, bc.target, bc.num_training_data, bc.num_variables)){
+        measure(report, "read_training_data", "\"order\": 16", benchmark_read, &bc, bc.num_training_data, "rows");
+        remove(BenchmarkDataFile);
+    }
+    delete_data(bc.training_data, bc.target);
+
+    // whole runs
+    int run_orders[] = { 8, 12, 16, 20 };
+    int pop_sizes[] = { 100, 1000 };
+    for (int i = 0; i < 4; i++){
+        generate_even_parity(run_orders[i], bc.training_data, bc.target, bc.num_training_data, bc.num_variables);
+        for (int p = 0; p < 2; p++){
+            bc.parameters.pop_size = pop_sizes[p];
+            bc.parameters.num_generations = benchmark_generations((double)pop_sizes[p] * get_num_words(bc.num_training_data));
+            snprintf(description, sizeof(description), "\"order\": %d, \"pop_size\": %d, \"num_generations\": %d",
+                     run_orders[i], pop_sizes[p], bc.parameters.num_generations);
+            measure(report, "run", description, benchmark_run, &bc, bc.parameters.num_generations, "generations");
+        }
+        delete_data(bc.training_data, bc.target);
+    }
+    end_benchmark_report(report);
+}
+//---------------------------------------------------------------------------
+int main(int argc, char *argv[])
+// usage: tgp_parity [-data file | -parity order] [-convert binary_file] [-telemetry file [-hardware_counters]]
+//                   [-semantic_cache] [-reject_duplicates] [-in_place]
+//                   [-islands n [-migration_interval n] [-migration_size n]]
+//                   [-benchmark [-benchmark_output file] [-benchmark_time seconds]]
+//   -data             training data, in text format (see above) or in the binary format written by -convert
+//   -parity           generates the even parity problem of the given order (1 to 30) instead of reading a file
+//   -telemetry        writes the metrics of each generation of each island, in JSON lines or, if the name
+//                     ends with .csv, in CSV: time of each phase, fitness distribution, operator success
+//   -hardware_counters  adds the cycles, instructions and cache misses of each generation (Linux only)
+//   -semantic_cache   offspring with the same values as a program already evaluated are not evaluated again
+//   -reject_duplicates  offspring whose values are already in the population are built again (changes the results)
+//   -in_place         steady state in a single population: each offspring replaces the worse of 2 individuals
+//                     at once (half the memory; with several threads, the results depend on their timing)
+//   -islands          number of populations (1 to 256), evolved concurrently; each island sends its best
+//                     individuals to the next one (in a ring) every -migration_interval generations (10 by default)
+//   -migration_size   number of individuals sent by an island at each migration (1 by default)
+//   -convert          writes the training data in binary format and exits
+//   -benchmark        checks the hash of values (negated values must not have the same hash), measures the hot
+//                     paths and whole runs on generated data, writes the results in JSON (on the standard output
+//                     or in -benchmark_output) and exits
+//   -benchmark_time   minimal duration of each measure (0.2 seconds by default)
 {
     
-    t_tgp_parameters params;
+    t_gp_parameters params;
     
     params.pop_size = 100;						    // the number of individuals in population
     params.num_generations = 10000;					// the number of generations
     params.insertion_probability = 0.1;              // insertion probability
     params.crossover_probability = 0.9;             // crossover probability
+    params.seed = 0;                                // seed of the random numbers
+    params.num_threads = std::thread::hardware_concurrency(); // the result does not depend on it
+    params.print_interval = 100;                    // the best fitness is printed every 100 generations
+    params.num_islands = 1;                         // a single population
+    params.migration_interval = 10;                 // migration every 10 generations (if there are several islands)
+    params.num_migrants = 1;                        // the best individual of an island is sent to its neighbours
+    params.migration_topology = MigrationRing;
+    params.telemetry_file = NULL;                   // no telemetry
+    params.hardware_counters = false;
+    params.semantic_cache = false;
+    params.reject_duplicates = false;
+    params.in_place = false;                        // generational: a new population is built from the current one
     
+    const char *data_file = "dataset//even_5_parity.txt";
+    int parity_order = 0;                           // read from data_file
+    const char *convert_file = NULL;
+    bool benchmark = false;
+    const char *benchmark_file = NULL;
+    double benchmark_seconds = 0.2;
+    for (int i = 1; i < argc; i++){
+        if (!strcmp(argv[i], "-data") && i + 1 < argc)
+            data_file = argv[++i];
+        else if (!strcmp(argv[i], "-parity") && i + 1 < argc){
+            if (!parse_int_option("-parity", argv[++i], 1, MaxParityOrder, parity_order))
+                return 1;
+        }
+        else if (!strcmp(argv[i], "-convert") && i + 1 < argc)
+            convert_file = argv[++i];
+        else if (!strcmp(argv[i], "-telemetry") && i + 1 < argc)
+            params.telemetry_file = argv[++i];
+        else if (!strcmp(argv[i], "-hardware_counters"))
+            params.hardware_counters = true;
+        else if (!strcmp(argv[i], "-semantic_cache"))
+            params.semantic_cache = true;
+        else if (!strcmp(argv[i], "-reject_duplicates"))
+            params.semantic_cache = params.reject_duplicates = true;
+        else if (!strcmp(argv[i], "-in_place"))
+            params.in_place = true;
+        else if (!strcmp(argv[i], "-islands") && i + 1 < argc){
+            if (!parse_int_option("-islands", argv[++i], 1, MaxIslands, params.num_islands))
+                return 1;
+        }
+        else if (!strcmp(argv[i], "-migration_interval") && i + 1 < argc){
+            if (!parse_int_option("-migration_interval", argv[++i], 1, INT_MAX, params.migration_interval))
+                return 1;
+        }
+        else if (!strcmp(argv[i], "-migration_size") && i + 1 < argc){
+            if (!parse_int_option("-migration_size", argv[++i], 1, params.pop_size, params.num_migrants))
+                return 1;
+        }
+        else if (!strcmp(argv[i], "-benchmark"))
+            benchmark = true;
+        else if (!strcmp(argv[i], "-benchmark_output") && i + 1 < argc)
+            benchmark_file = argv[++i];
+        else if (!strcmp(argv[i], "-benchmark_time") && i + 1 < argc)
+            benchmark_seconds = atof(argv[++i]);
+        else{
+            printf("Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (benchmark){
+        if (!check_value_hash()){
+            printf("The hash of values confuses different values!\n");
+            return 1;
+        }
+        FILE *f = benchmark_file ? fopen(benchmark_file, "w") : stdout;
+        if (!f){
+            printf("Cannot write %s!\n", benchmark_file);
+            return 1;
+        }
+        run_benchmarks(params, f, benchmark_seconds);
+        if (benchmark_file)
+            fclose(f);
+        return 0;
+    }
     
-    int num_training_data, num_variables;
-    char** training_data;
-    char *target;
+    int num_training_data, num_variables, num_classes; // the targets are bits: the number of classes of a binary file is 2
+    uint64_t** training_data;
+    uint64_t *target;
+    t_mapped_file binary_file;
+    bool binary = !parity_order && is_binary_data_file(data_file);
     
-    if (!read_training_data("dataset//even_5_parity.txt", training_data, target, num_training_data, num_variables)) {
+    if (parity_order)
+        generate_even_parity(parity_order, training_data, target, num_training_data, num_variables);
+    else if (binary ? !open_binary_data(data_file, ElementBit, binary_file, training_data, target, num_training_data, num_variables, num_classes) :
+                      !read_training_data(data_file, training_data, target, num_training_data, num_variables)) {
         printf("Cannot find input file! Please specify the correct (full) path!");
         getchar();
         return 1;
     }
     
+    if (convert_file){
+        bool ok = write_binary_data(convert_file, ElementBit, training_data, target, num_training_data, num_variables, 2);
+        printf(ok ? "%s written\n" : "Cannot write %s!\n", convert_file);
+        if (binary)
+            close_binary_data(binary_file, training_data);
+        else
+            delete_data(training_data, target);
+        return ok ? 0 : 1;
+    }
+    
     
     printf("num training data = %d\n", num_training_data);
     printf("num variables = %d\n", num_variables);
     
-    srand(0);
     start_steady_state_tgp( params, training_data, target, num_training_data, num_variables);
     
-    delete_data(training_data, target, num_training_data);
+    if (binary)
+        close_binary_data(binary_file, training_data);
+    else
+        delete_data(training_data, target);
     printf("Press enter ...");
     getchar();
     